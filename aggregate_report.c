@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <string.h>
+#include "aggregate_report.h"
+
+int aggregate_report_init(AggregateReport* report, AggregateStore* store, OutputSink* out,
+                          uint64_t interval_ms) {
+    memset(report, 0, sizeof(*report));
+    report->due = calloc(store->max_devices, sizeof(AggregateDue));
+    if (!report->due) {
+        return -1;
+    }
+    report->store = store;
+    report->out = out;
+    report->interval_ms = interval_ms;
+    return 0;
+}
+
+void aggregate_report_free(AggregateReport* report) {
+    free(report->due);
+    memset(report, 0, sizeof(*report));
+}
+
+// Writes one record with every type the store holds for the device.
+static void write_device(AggregateReport* report, int32_t id, uint64_t time_ms) {
+    AggregateDue* d = &report->due[id];
+    AggregateStats stats[OREGON_READING_TYPE_COUNT];
+    int n = 0;
+    for (int type = 0; type < OREGON_READING_TYPE_COUNT; type++) {
+        n += aggregate_store_get(report->store, id, (OregonReadingType)type, &stats[n]);
+    }
+    if (n > 0) {
+        output_sink_aggregates(report->out, d->name, time_ms, stats, n);
+        report->records++;
+    }
+    d->pending = false;
+}
+
+// First multiple of the interval after `now`.
+static uint64_t next_interval(const AggregateReport* report, uint64_t now) {
+    return (now / report->interval_ms + 1) * report->interval_ms;
+}
+
+void aggregate_report_add(AggregateReport* report, int32_t id, const char* name, uint64_t now,
+                          const OregonReading* readings, int count) {
+    AggregateStore* store = report->store;
+    aggregate_store_add(store, id, readings, count);
+    if (id < 0 || (uint32_t)id >= store->max_devices) {
+        return;
+    }
+
+    AggregateDue* d = &report->due[id];
+    if (!d->name[0]) {
+        strncpy(d->name, name, DEVICE_NAME_MAX - 1);
+    }
+    d->last_ms = now;
+    d->pending = true;
+
+    if (report->interval_ms == 0) {
+        // Only the types of this message can have just completed a window
+        AggregateStats stats[OREGON_MAX_READINGS];
+        int n = 0;
+        for (int i = 0; i < count && i < OREGON_MAX_READINGS; i++) {
+            if (readings[i].unit != OREGON_UNIT_NONE &&
+                aggregate_store_get(store, id, (OregonReadingType)readings[i].type, &stats[n]) &&
+                stats[n].total % store->window == 0) {
+                n++;
+            }
+        }
+        if (n > 0) {
+            output_sink_aggregates(report->out, d->name, now, stats, n);
+            report->records++;
+        }
+        return;
+    }
+
+    // A device's first message starts its interval; it is not due before
+    if (d->next_ms == 0) {
+        d->next_ms = next_interval(report, now);
+    } else if (now >= d->next_ms) {
+        write_device(report, id, now);
+        d->next_ms = next_interval(report, now);
+    }
+}
+
+void aggregate_report_flush(AggregateReport* report, int32_t id) {
+    if (report->interval_ms == 0) {
+        return;
+    }
+    uint32_t first = id < 0 ? 0 : (uint32_t)id;
+    uint32_t end = id < 0 ? report->store->max_devices : first + 1;
+    for (uint32_t i = first; i < end && i < report->store->max_devices; i++) {
+        if (report->due[i].pending) {
+            write_device(report, (int32_t)i, report->due[i].last_ms);
+        }
+    }
+}
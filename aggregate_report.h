@@ -0,0 +1,54 @@
+#ifndef AGGREGATE_REPORT_H
+#define AGGREGATE_REPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "oregon_parser.h"
+#include "aggregate_store.h"
+#include "device_registry.h"
+#include "output_sink.h"
+
+// When a device's aggregate record is due.
+typedef struct {
+    uint64_t next_ms;           // Interval mode: first message time past the current interval
+    uint64_t last_ms;           // Time of the latest message
+    bool pending;               // Values were added since the last record
+    char name[DEVICE_NAME_MAX]; // Empty until the device's first message
+} AggregateDue;
+
+// Feeds an AggregateStore and writes its statistics to an OutputSink as
+// aggregate records, so they can stand in for (or go along with) the raw
+// readings. With an interval, a device's record covering every type it has
+// is written by its first message at or past each multiple of the interval
+// in message time. With interval 0, a type's statistics are written each
+// time its window has filled with new values, i.e. once per window.
+// Devices are identified by their DeviceRegistry id (or any dense index)
+// below the store's max_devices; others are only counted by the store.
+// The bookkeeping is sized at init and never allocates afterwards.
+// Not thread-safe; use it from the thread that writes the sink.
+typedef struct {
+    AggregateStore* store;
+    OutputSink* out;
+    uint64_t interval_ms;       // 0 writes once per window
+    AggregateDue* due;          // store->max_devices
+    unsigned long records;
+} AggregateReport;
+
+// Returns 0 on success, -1 if allocation fails.
+int aggregate_report_init(AggregateReport* report, AggregateStore* store, OutputSink* out,
+                          uint64_t interval_ms);
+void aggregate_report_free(AggregateReport* report);
+
+// Adds the readings of one message from device `id` named `name`, received
+// at time `now`, to the store and writes whatever records fall due.
+void aggregate_report_add(AggregateReport* report, int32_t id, const char* name, uint64_t now,
+                          const OregonReading* readings, int count);
+
+// Interval mode: writes the record of device `id`, or of every device if id
+// is negative, that has values not yet reported, stamped with its latest
+// message time. For the end of input, so the last partial interval is not
+// lost. No-op once per window.
+void aggregate_report_flush(AggregateReport* report, int32_t id);
+
+#endif // AGGREGATE_REPORT_H
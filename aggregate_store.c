@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <string.h>
+#include "aggregate_store.h"
+
+int aggregate_store_init(AggregateStore* store, uint32_t window, double alpha, uint32_t max_devices,
+                         uint32_t max_series) {
+    memset(store, 0, sizeof(*store));
+    if (window == 0 || !(alpha > 0.0 && alpha <= 1.0) || max_devices == 0 || max_series == 0) {
+        return -1;
+    }
+
+    size_t slots = (size_t)max_series * window;
+    store->series_of = calloc((size_t)max_devices * OREGON_READING_TYPE_COUNT, sizeof(uint32_t));
+    store->series = calloc(max_series, sizeof(AggregateSeries));
+    store->values = malloc(slots * sizeof(int32_t));
+    store->min_queue = malloc(slots * sizeof(uint64_t));
+    store->max_queue = malloc(slots * sizeof(uint64_t));
+    if (!store->series_of || !store->series || !store->values || !store->min_queue || !store->max_queue) {
+        aggregate_store_free(store);
+        return -1;
+    }
+    store->window = window;
+    store->alpha = alpha;
+    store->max_devices = max_devices;
+    store->max_series = max_series;
+    return 0;
+}
+
+void aggregate_store_free(AggregateStore* store) {
+    free(store->series_of);
+    free(store->series);
+    free(store->values);
+    free(store->min_queue);
+    free(store->max_queue);
+    memset(store, 0, sizeof(*store));
+}
+
+// Pushes one value. Each queue holds the sequence numbers of the window's
+// values in order, keeping only those that could still become the minimum
+// (maximum): any older value that is not smaller (larger) is dropped from
+// the back first. The front is then the window's minimum (maximum).
+static void push_value(const AggregateStore* store, uint32_t index, int32_t value) {
+    AggregateSeries* s = &store->series[index];
+    uint32_t w = store->window;
+    int32_t* values = store->values + (size_t)index * w;
+    uint64_t* min_q = store->min_queue + (size_t)index * w;
+    uint64_t* max_q = store->max_queue + (size_t)index * w;
+    uint64_t seq = s->seq;
+
+    // The slot of seq is the oldest value's; expire it everywhere first
+    if (seq >= w) {
+        s->sum -= values[seq % w];
+        if (min_q[s->min_head % w] + w <= seq) {
+            s->min_head++;
+        }
+        if (max_q[s->max_head % w] + w <= seq) {
+            s->max_head++;
+        }
+    }
+    values[seq % w] = value;
+    s->sum += value;
+
+    while (s->min_tail > s->min_head && values[min_q[(s->min_tail - 1) % w] % w] >= value) {
+        s->min_tail--;
+    }
+    min_q[s->min_tail++ % w] = seq;
+    while (s->max_tail > s->max_head && values[max_q[(s->max_tail - 1) % w] % w] <= value) {
+        s->max_tail--;
+    }
+    max_q[s->max_tail++ % w] = seq;
+
+    s->ewma = seq == 0 ? value : s->ewma + store->alpha * (value - s->ewma);
+    s->seq = seq + 1;
+}
+
+void aggregate_store_add(AggregateStore* store, int32_t id, const OregonReading* readings, int count) {
+    for (int i = 0; i < count; i++) {
+        const OregonReading* r = &readings[i];
+        if (r->unit == OREGON_UNIT_NONE) {
+            continue;
+        }
+        if (id < 0 || (uint32_t)id >= store->max_devices || r->type >= OREGON_READING_TYPE_COUNT) {
+            store->dropped++;
+            continue;
+        }
+
+        uint32_t* slot = &store->series_of[(size_t)id * OREGON_READING_TYPE_COUNT + r->type];
+        if (!*slot) {
+            if (store->num_series == store->max_series) {
+                store->dropped++;
+                continue;
+            }
+            *slot = ++store->num_series;
+        }
+        store->series[*slot - 1].unit = r->unit;
+        push_value(store, *slot - 1, r->value);
+    }
+}
+
+bool aggregate_store_get(const AggregateStore* store, int32_t id, OregonReadingType type,
+                         AggregateStats* stats) {
+    if (id < 0 || (uint32_t)id >= store->max_devices || (unsigned)type >= OREGON_READING_TYPE_COUNT) {
+        return false;
+    }
+    uint32_t slot = store->series_of[(size_t)id * OREGON_READING_TYPE_COUNT + type];
+    if (!slot) {
+        return false;
+    }
+
+    uint32_t index = slot - 1;
+    const AggregateSeries* s = &store->series[index];
+    uint32_t w = store->window;
+    const int32_t* values = store->values + (size_t)index * w;
+
+    stats->type = (uint8_t)type;
+    stats->unit = s->unit;
+    stats->total = s->seq;
+    stats->count = s->seq < w ? (uint32_t)s->seq : w;
+    stats->last = values[(s->seq - 1) % w];
+    stats->min = values[store->min_queue[(size_t)index * w + s->min_head % w] % w];
+    stats->max = values[store->max_queue[(size_t)index * w + s->max_head % w] % w];
+    stats->mean = (double)s->sum / stats->count;
+    stats->ewma = s->ewma;
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef AGGREGATE_STORE_H
+#define AGGREGATE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "oregon_parser.h"
+
+// Rolling statistics of one reading type of one device. Values are in
+// 1/OREGON_VALUE_SCALE units, like OregonReading.value.
+typedef struct {
+    uint8_t type;               // OregonReadingType
+    uint8_t unit;               // OregonUnit of the values
+    uint32_t count;             // Values in the window, at most the window size
+    uint64_t total;             // Values seen since the series started
+    int32_t last;
+    int32_t min;                // Over the window
+    int32_t max;
+    double mean;
+    double ewma;                // Over all values, weighted by the store's alpha
+} AggregateStats;
+
+// Ring buffer and running state of one series.
+typedef struct {
+    uint64_t seq;               // Number of values pushed so far
+    int64_t sum;                // Of the values in the window
+    double ewma;
+    uint8_t unit;               // Of the latest value
+    uint64_t min_head, min_tail;    // Monotonic queues of sequence numbers,
+    uint64_t max_head, max_tail;    // used modulo the window size
+} AggregateSeries;
+
+// Rolling aggregates per device and reading type: mean, min and max over
+// the last `window` values, and an exponentially weighted moving average.
+// Every update is O(1) (amortised for min/max) and never allocates: all
+// series are carved out of storage sized at init. Devices are identified
+// by their DeviceRegistry id; ids past max_devices and series past
+// max_series are ignored and counted in `dropped`.
+// Not thread-safe; use one store per thread.
+typedef struct {
+    uint32_t window;
+    double alpha;
+    uint32_t max_devices;
+    uint32_t max_series;
+    uint32_t num_series;
+    uint32_t* series_of;        // series index + 1 per (device, type), 0 if none
+    AggregateSeries* series;
+    int32_t* values;            // window values per series
+    uint64_t* min_queue;        // window sequence numbers per series
+    uint64_t* max_queue;
+    unsigned long dropped;
+} AggregateStore;
+
+// Allocates a store once, up front. window is the number of values the
+// mean, min and max cover; alpha (0, 1] the weight of a new value in the
+// EWMA. Returns 0 on success, -1 on bad arguments or allocation failure.
+int aggregate_store_init(AggregateStore* store, uint32_t window, double alpha, uint32_t max_devices,
+                         uint32_t max_series);
+void aggregate_store_free(AggregateStore* store);
+
+// Adds the readings of one decoded message from device `id`. Readings
+// without a unit (states only) are skipped.
+void aggregate_store_add(AggregateStore* store, int32_t id, const OregonReading* readings, int count);
+
+// Fills stats for a device and reading type. Returns false if the store
+// holds no values for them.
+bool aggregate_store_get(const AggregateStore* store, int32_t id, OregonReadingType type,
+                         AggregateStats* stats);
+
+#endif // AGGREGATE_STORE_H
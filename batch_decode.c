@@ -0,0 +1,297 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch_decode.h"
+#include "cul_stream.h"
+#include "device_registry.h"
+#include "oregon_parser.h"
+
+// Chunks that may be decoded ahead of the writer, per worker thread.
+#define BATCH_WINDOW_PER_THREAD 4
+// Initial device registry size per worker; it grows as needed.
+#define BATCH_EXPECTED_DEVICES  64
+// Output buffer per slot. Text output runs to about three times the input;
+// anything longer grows into a further arena block.
+#define BATCH_ARENA_BLOCK       (4 * BATCH_CHUNK_SIZE)
+
+typedef struct {
+    OutputSink out;      // Rendered output of the chunk, without a descriptor
+    OregonArena arena;   // Backs out; reset for each chunk that uses the slot
+    bool done;
+} BatchSlot;
+
+typedef struct {
+    const char* data;
+    size_t size;
+    size_t num_chunks;
+    size_t window;           // Number of slots; chunk i lives in slot i % window
+    OutputFormat format;
+
+    pthread_mutex_t lock;
+    pthread_cond_t chunk_done;
+    pthread_cond_t slot_free;
+    size_t next_chunk;       // Next chunk a worker will claim
+    size_t next_write;       // Next chunk the writer will emit
+    BatchSlot* slots;
+    BatchStats totals;
+    bool out_of_memory;
+} BatchJob;
+
+// Decodes the lines that start inside chunk idx and renders their readings.
+// Device names come from the worker's registry, if it has one.
+static void decode_chunk(const BatchJob* job, size_t idx, OutputSink* out, DeviceRegistry* devices,
+                         BatchStats* stats) {
+    const char* data = job->data;
+    size_t size = job->size;
+    size_t p = idx * (size_t)BATCH_CHUNK_SIZE;
+    size_t end = p + BATCH_CHUNK_SIZE < size ? p + BATCH_CHUNK_SIZE : size;
+
+    // A line straddling the chunk start belongs to the previous chunk
+    if (p > 0 && data[p - 1] != '\n') {
+        const char* nl = memchr(data + p, '\n', size - p);
+        if (!nl) {
+            return;
+        }
+        p = (size_t)(nl - data) + 1;
+    }
+
+    char line[CUL_LINE_MAX + 1];
+    char name[DEVICE_NAME_MAX];
+    OregonReading readings[OREGON_MAX_READINGS];
+    while (p < end) {
+        const char* nl = memchr(data + p, '\n', size - p);
+        size_t line_end = nl ? (size_t)(nl - data) : size;
+        size_t len = line_end - p;
+        if (len > 0 && data[p + len - 1] == '\r') {
+            len--;
+        }
+
+        if (len > CUL_LINE_MAX) {
+            stats->overlong++;
+        } else if (len > 0) {
+            memcpy(line, data + p, len);
+            line[len] = '\0';
+            stats->lines++;
+
+            int count = 0;
+            OregonMessageInfo info;
+            OregonStatus status = oregon_decode_cul(line, &info, readings, OREGON_MAX_READINGS, &count);
+            stats->by_status[status]++;
+            stats->by_protocol[info.protocol]++;
+            if (status == OREGON_OK) {
+                int32_t id = devices ? device_registry_observe(devices, readings[0].device, 0) : -1;
+                if (id >= 0) {
+                    output_sink_readings(out, device_registry_get(devices, id)->name, 0, readings, count);
+                } else {
+                    oregon_device_name(readings[0].device, name, sizeof(name));
+                    output_sink_readings(out, name, 0, readings, count);
+                }
+            }
+        }
+        p = line_end + 1;
+    }
+}
+
+static void* batch_worker(void* arg) {
+    BatchJob* job = arg;
+    BatchStats stats;
+    memset(&stats, 0, sizeof(stats));
+    DeviceRegistry registry;
+    DeviceRegistry* devices = device_registry_init(&registry, BATCH_EXPECTED_DEVICES) == 0 ? &registry : NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        // Stay within the window so finished output cannot pile up unbounded
+        while (job->next_chunk < job->num_chunks && job->next_chunk >= job->next_write + job->window) {
+            pthread_cond_wait(&job->slot_free, &job->lock);
+        }
+        if (job->next_chunk >= job->num_chunks) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        size_t idx = job->next_chunk++;
+        BatchSlot* slot = &job->slots[idx % job->window];
+        pthread_mutex_unlock(&job->lock);
+
+        // The slot is ours until the writer is done with it. Its arena
+        // keeps the blocks of earlier chunks, so this allocates nothing
+        // once the buffer has grown to the size of a chunk's output.
+        OutputSink out;
+        oregon_arena_reset(&slot->arena);
+        bool ok = output_sink_init_arena(&out, job->format, &slot->arena, BATCH_ARENA_BLOCK) == 0;
+        if (ok) {
+            decode_chunk(job, idx, &out, devices, &stats);
+            ok = !out.failed;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        slot->out = out;
+        slot->done = true;
+        if (!ok) {
+            job->out_of_memory = true;
+        }
+        pthread_cond_broadcast(&job->chunk_done);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->totals.lines += stats.lines;
+    job->totals.overlong += stats.overlong;
+    for (int s = 0; s < OREGON_STATUS_COUNT; s++) {
+        job->totals.by_status[s] += stats.by_status[s];
+    }
+    for (int v = 0; v < OREGON_VERSION_COUNT; v++) {
+        job->totals.by_protocol[v] += stats.by_protocol[v];
+    }
+    pthread_mutex_unlock(&job->lock);
+    if (devices) {
+        device_registry_free(devices);
+    }
+    return NULL;
+}
+
+int batch_decode_file(const char* path, int threads, OutputFormat format, int out_fd, BatchStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    BatchJob job;
+    memset(&job, 0, sizeof(job));
+    job.data = map;
+    job.size = (size_t)st.st_size;
+    job.format = format;
+    job.num_chunks = (job.size + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+    if (threads < 1) {
+        threads = 1;
+    }
+    if ((size_t)threads > job.num_chunks) {
+        threads = (int)job.num_chunks;
+    }
+    job.window = (size_t)threads * BATCH_WINDOW_PER_THREAD;
+    job.slots = calloc(job.window, sizeof(BatchSlot));
+    pthread_t* workers = calloc((size_t)threads, sizeof(pthread_t));
+    if (!job.slots || !workers) {
+        free(job.slots);
+        free(workers);
+        munmap(map, job.size);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (size_t s = 0; s < job.window; s++) {
+        if (oregon_arena_init(&job.slots[s].arena, BATCH_ARENA_BLOCK) != 0) {
+            while (s-- > 0) {
+                oregon_arena_free(&job.slots[s].arena);
+            }
+            free(job.slots);
+            free(workers);
+            munmap(map, job.size);
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.chunk_done, NULL);
+    pthread_cond_init(&job.slot_free, NULL);
+
+    int started = 0;
+    int create_err = 0;
+    while (started < threads) {
+        create_err = pthread_create(&workers[started], NULL, batch_worker, &job);
+        if (create_err != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        // Not even one worker: nothing would ever fill the slots
+        job.num_chunks = 0;
+    }
+
+    // Write finished chunks in input order as they become available
+    OutputSink header;
+    if (output_sink_init(&header, format, out_fd, 256) == 0) {
+        output_sink_header(&header);
+        output_sink_free(&header);
+    }
+    int write_errno = 0;
+    for (size_t w = 0; w < job.num_chunks; w++) {
+        pthread_mutex_lock(&job.lock);
+        BatchSlot* slot = &job.slots[w % job.window];
+        while (!slot->done) {
+            pthread_cond_wait(&job.chunk_done, &job.lock);
+        }
+        OutputSink chunk = slot->out;
+        memset(&slot->out, 0, sizeof(slot->out));
+        slot->done = false;
+        pthread_mutex_unlock(&job.lock);
+
+        // The chunk goes out in one write when its sink is flushed
+        chunk.fd = out_fd;
+        if (!write_errno && output_sink_flush(&chunk) != 0) {
+            write_errno = errno;
+        }
+        chunk.fd = -1;
+        output_sink_free(&chunk);
+
+        // Only now may a worker reuse the slot and its arena
+        pthread_mutex_lock(&job.lock);
+        job.next_write = w + 1;
+        pthread_cond_broadcast(&job.slot_free);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    *stats = job.totals;
+
+    pthread_cond_destroy(&job.slot_free);
+    pthread_cond_destroy(&job.chunk_done);
+    pthread_mutex_destroy(&job.lock);
+    for (size_t s = 0; s < job.window; s++) {
+        oregon_arena_free(&job.slots[s].arena);
+    }
+    free(job.slots);
+    free(workers);
+    munmap(map, job.size);
+
+    if (started == 0) {
+        errno = create_err;
+        return -1;
+    }
+    if (job.out_of_memory) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (write_errno) {
+        errno = write_errno;
+        return -1;
+    }
+    return 0;
+}
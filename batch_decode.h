@@ -0,0 +1,29 @@
+#ifndef BATCH_DECODE_H
+#define BATCH_DECODE_H
+
+#include "oregon_status.h"
+#include "cul_preprocessor.h"
+#include "output_sink.h"
+
+// Input bytes per work unit. Lines belong to the chunk their first byte is in.
+#define BATCH_CHUNK_SIZE (1u << 20)
+
+// Totals over every line of a batch run.
+typedef struct {
+    unsigned long lines;
+    unsigned long overlong;
+    unsigned long by_status[OREGON_STATUS_COUNT];
+    unsigned long by_protocol[OREGON_VERSION_COUNT];
+} BatchStats;
+
+// Decodes every line of a captured CUL log with `threads` worker threads
+// and writes the readings to the file descriptor `out_fd` in input order, in
+// the given output format.
+// The file is memory-mapped and cut into chunks at newline boundaries;
+// each worker serialises whole chunks into its own output sink, and the
+// calling thread writes finished chunks in order, one write per chunk. Only a bounded window of
+// chunks is in flight, so memory use does not grow with the file size.
+// Returns 0 on success, -1 with errno set if the file cannot be read.
+int batch_decode_file(const char* path, int threads, OutputFormat format, int out_fd, BatchStats* stats);
+
+#endif // BATCH_DECODE_H
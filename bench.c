@@ -0,0 +1,479 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "cul_preprocessor.h"
+#include "oregon_parser.h"
+#include "decode_cache.h"
+#include "hex_pack.h"
+#include "oregon_stats.h"
+
+// Replays a CUL corpus in memory through each decoding stage and reports
+// throughput, per-message latency percentiles and heap allocations.
+
+#define DEFAULT_CORPUS     "test_data.txt"
+#define DEFAULT_ITERATIONS 100
+#define MAX_LINE_LENGTH    256
+#define BENCH_CACHE_SIZE   4096
+#define BENCH_ARENA_BLOCK  (64 * 1024)
+
+// ==========================================================================
+// ALLOCATION COUNTING (linked with -Wl,--wrap=malloc,...)
+// ==========================================================================
+
+static unsigned long alloc_count = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr) {
+    __real_free(ptr);
+}
+
+// ==========================================================================
+// LATENCY HISTOGRAM
+// ==========================================================================
+
+// Log-linear buckets: exact below 64ns, then 32 sub-buckets per power of two.
+#define HIST_LINEAR   64
+#define HIST_SUB_BITS 5
+#define HIST_BUCKETS  (HIST_LINEAR + (64 - 6) * (1 << HIST_SUB_BITS))
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+} Histogram;
+
+static int hist_bucket(uint64_t ns) {
+    if (ns < HIST_LINEAR) {
+        return (int)ns;
+    }
+    int exp = 63 - __builtin_clzll(ns);
+    int sub = (int)((ns >> (exp - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1));
+    return HIST_LINEAR + (exp - 6) * (1 << HIST_SUB_BITS) + sub;
+}
+
+// Returns the upper bound of a bucket in ns.
+static uint64_t hist_bucket_limit(int bucket) {
+    if (bucket < HIST_LINEAR) {
+        return (uint64_t)bucket;
+    }
+    int exp = (bucket - HIST_LINEAR) / (1 << HIST_SUB_BITS) + 6;
+    int sub = (bucket - HIST_LINEAR) % (1 << HIST_SUB_BITS);
+    return ((uint64_t)((1 << HIST_SUB_BITS) + sub + 1) << (exp - HIST_SUB_BITS)) - 1;
+}
+
+static uint64_t hist_percentile(const Histogram* h, double pct) {
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)h->total);
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen > rank) {
+            return hist_bucket_limit(b);
+        }
+    }
+    return 0;
+}
+
+// ==========================================================================
+// CORPUS AND STAGES
+// ==========================================================================
+
+typedef struct {
+    char** lines;          // Raw CUL lines
+    size_t num_lines;
+    OregonFrame* frames;   // Frames of the lines that pre-process successfully
+    char** hex;            // Hex rendering of each frame, for the string API
+    size_t num_frames;
+} BenchCorpus;
+
+// Consumes stage results so the compiler cannot drop the work.
+static volatile uint64_t bench_sink;
+
+typedef struct {
+    const char* name;
+    bool per_frame;        // Runs over frames instead of raw lines
+    void (*run)(const BenchCorpus* c, size_t i);
+    void (*reset)(void);   // Optional, called before every pass over the corpus
+} BenchStage;
+
+// Hex payload of a CUL line, after the "om" prefix
+static const char* cul_payload(const char* line) {
+    size_t len = strlen(line);
+    return line + (len < 2 ? len : 2);
+}
+
+static void run_hex_pack(const BenchCorpus* c, size_t i) {
+    uint8_t bytes[MAX_LINE_LENGTH / 2];
+    const char* hex = cul_payload(c->lines[i]);
+    bench_sink += hex_pack(hex, strlen(hex), bytes);
+}
+
+static void run_hex_pack_scalar(const BenchCorpus* c, size_t i) {
+    uint8_t bytes[MAX_LINE_LENGTH / 2];
+    const char* hex = cul_payload(c->lines[i]);
+    bench_sink += hex_pack_scalar(hex, strlen(hex), bytes);
+}
+
+static void run_preprocess(const BenchCorpus* c, size_t i) {
+    OregonFrame frame;
+    bench_sink += cul_preprocess_frame(c->lines[i], &frame);
+}
+
+static void run_parse(const BenchCorpus* c, size_t i) {
+    OregonReading readings[OREGON_MAX_READINGS];
+    int count;
+    bench_sink += oregon_decode_frame(&c->frames[i], NULL, readings, OREGON_MAX_READINGS, &count);
+}
+
+static void run_parse_generic(const BenchCorpus* c, size_t i) {
+    OregonReading readings[OREGON_MAX_READINGS];
+    int count;
+    bench_sink += oregon_decode_frame_generic(&c->frames[i], NULL, readings, OREGON_MAX_READINGS, &count);
+}
+
+static void run_preprocess_cul_message(const BenchCorpus* c, size_t i) {
+    char* hex = preprocess_cul_message(c->lines[i]);
+    bench_sink += (uintptr_t)hex;
+    free(hex);
+}
+
+// One arena for a whole pass over the corpus, reset before the next
+static OregonArena bench_arena;
+
+static void reset_arena(void) {
+    oregon_arena_reset(&bench_arena);
+}
+
+static void run_preprocess_cul_message_arena(const BenchCorpus* c, size_t i) {
+    bench_sink += (uintptr_t)preprocess_cul_message_arena(c->lines[i], &bench_arena);
+}
+
+static void run_parse_oregon_message(const BenchCorpus* c, size_t i) {
+    parse_oregon_message(c->hex[i]);
+    bench_sink++;
+}
+
+static void run_decode(const BenchCorpus* c, size_t i) {
+    OregonReading readings[OREGON_MAX_READINGS];
+    int count;
+    bench_sink += oregon_decode_cul(c->lines[i], NULL, readings, OREGON_MAX_READINGS, &count);
+}
+
+// Starts every pass with an empty cache, so only repeats within the corpus hit
+static DecodeCache bench_cache;
+
+static void reset_cache(void) {
+    decode_cache_clear(&bench_cache);
+}
+
+static void run_decode_cached(const BenchCorpus* c, size_t i) {
+    OregonReading readings[OREGON_MAX_READINGS];
+    int count;
+    bench_sink += decode_cache_decode_cul(&bench_cache, c->lines[i], 0, NULL, readings,
+                                          OREGON_MAX_READINGS, &count);
+}
+
+// Never reset and large enough for every distinct line, so once warmed up
+// every lookup is a hit
+static DecodeCache bench_hit_cache;
+
+static void run_decode_cache_hit(const BenchCorpus* c, size_t i) {
+    OregonReading readings[OREGON_MAX_READINGS];
+    int count;
+    bench_sink += decode_cache_decode_cul(&bench_hit_cache, c->lines[i], 0, NULL, readings,
+                                          OREGON_MAX_READINGS, &count);
+}
+
+static const BenchStage STAGES[] = {
+    {.name = "hex_pack",               .run = run_hex_pack},
+    {.name = "hex_pack_scalar",        .run = run_hex_pack_scalar},
+    {.name = "preprocess",             .run = run_preprocess},
+    {.name = "parse",                  .run = run_parse,            .per_frame = true},
+    {.name = "parse_generic",          .run = run_parse_generic,    .per_frame = true},
+    {.name = "decode",                 .run = run_decode},
+    {.name = "decode_cached",          .run = run_decode_cached,    .reset = reset_cache},
+    {.name = "decode_cache_hit",       .run = run_decode_cache_hit},
+    {.name = "preprocess_cul_message", .run = run_preprocess_cul_message},
+    {.name = "preprocess_cul_message_arena", .run = run_preprocess_cul_message_arena, .reset = reset_arena},
+    {.name = "parse_oregon_message",   .run = run_parse_oregon_message, .per_frame = true},
+};
+static const int NUM_STAGES = sizeof(STAGES) / sizeof(STAGES[0]);
+
+typedef struct {
+    uint64_t messages;
+    double total_ns;
+    double allocs_per_msg;
+    uint64_t p50, p99, p999;
+} StageResult;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Cost of one timer read, subtracted from per-message latencies.
+static uint64_t timer_overhead_ns(void) {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t t0 = now_ns();
+        uint64_t t1 = now_ns();
+        if (t1 - t0 < best) {
+            best = t1 - t0;
+        }
+    }
+    return best;
+}
+
+static void run_stage(const BenchStage* stage, const BenchCorpus* c, int iterations,
+                      uint64_t timer_overhead, StageResult* res) {
+    size_t n = stage->per_frame ? c->num_frames : c->num_lines;
+    static Histogram hist;
+    memset(&hist, 0, sizeof(hist));
+    memset(res, 0, sizeof(*res));
+
+    // Warm up caches and branch predictors
+    if (stage->reset) {
+        stage->reset();
+    }
+    for (size_t i = 0; i < n; i++) {
+        stage->run(c, i);
+    }
+
+    // Throughput pass: one timer read around the whole replay
+    unsigned long allocs_before = alloc_count;
+    uint64_t start = now_ns();
+    for (int it = 0; it < iterations; it++) {
+        if (stage->reset) {
+            stage->reset();
+        }
+        for (size_t i = 0; i < n; i++) {
+            stage->run(c, i);
+        }
+    }
+    res->total_ns = (double)(now_ns() - start);
+    res->messages = (uint64_t)n * iterations;
+    res->allocs_per_msg = res->messages ? (double)(alloc_count - allocs_before) / res->messages : 0;
+
+    // Latency pass: every message timed on its own
+    for (int it = 0; it < iterations; it++) {
+        if (stage->reset) {
+            stage->reset();
+        }
+        for (size_t i = 0; i < n; i++) {
+            uint64_t t0 = now_ns();
+            stage->run(c, i);
+            uint64_t dt = now_ns() - t0;
+            dt = dt > timer_overhead ? dt - timer_overhead : 0;
+            hist.counts[hist_bucket(dt)]++;
+            hist.total++;
+        }
+    }
+    res->p50 = hist_percentile(&hist, 50.0);
+    res->p99 = hist_percentile(&hist, 99.0);
+    res->p999 = hist_percentile(&hist, 99.9);
+}
+
+static bool load_corpus(const char* path, BenchCorpus* c) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror("Error: Could not open corpus");
+        return false;
+    }
+
+    size_t cap = 1024;
+    memset(c, 0, sizeof(*c));
+    c->lines = malloc(cap * sizeof(char*));
+
+    char line[MAX_LINE_LENGTH];
+    while (c->lines && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (strlen(line) == 0) {
+            continue;
+        }
+        if (c->num_lines == cap) {
+            cap *= 2;
+            c->lines = realloc(c->lines, cap * sizeof(char*));
+            if (!c->lines) {
+                break;
+            }
+        }
+        c->lines[c->num_lines++] = strdup(line);
+    }
+    fclose(file);
+
+    if (!c->lines || c->num_lines == 0) {
+        fprintf(stderr, "Error: Corpus %s is empty or could not be loaded\n", path);
+        return false;
+    }
+
+    c->frames = malloc(c->num_lines * sizeof(OregonFrame));
+    c->hex = malloc(c->num_lines * sizeof(char*));
+    if (!c->frames || !c->hex) {
+        return false;
+    }
+    for (size_t i = 0; i < c->num_lines; i++) {
+        OregonFrame* frame = &c->frames[c->num_frames];
+        if (cul_preprocess_frame(c->lines[i], frame) == OREGON_OK) {
+            char hex[CUL_HEX_OUTPUT_SIZE];
+            cul_frame_to_hex(frame, hex, sizeof(hex));
+            c->hex[c->num_frames++] = strdup(hex);
+        }
+    }
+    return true;
+}
+
+// ==========================================================================
+// REPORTING
+// ==========================================================================
+
+static void report_text(FILE* out, const char* corpus, const BenchCorpus* c, int iterations,
+                        const StageResult* results) {
+    fprintf(out, "Corpus: %s (%zu lines, %zu frames) x %d iterations, hex_pack: %s\n\n",
+            corpus, c->num_lines, c->num_frames, iterations, hex_pack_impl());
+    fprintf(out, "%-30s %12s %10s %8s %8s %8s %11s\n",
+            "stage", "msgs/s", "ns/msg", "p50", "p99", "p99.9", "allocs/msg");
+    for (int s = 0; s < NUM_STAGES; s++) {
+        const StageResult* r = &results[s];
+        double ns_per_msg = r->total_ns / r->messages;
+        fprintf(out, "%-30s %12.0f %10.1f %8llu %8llu %8llu %11.2f\n",
+                STAGES[s].name, 1e9 / ns_per_msg, ns_per_msg,
+                (unsigned long long)r->p50, (unsigned long long)r->p99,
+                (unsigned long long)r->p999, r->allocs_per_msg);
+    }
+    fprintf(out, "\nLatencies in ns, timer overhead subtracted.\n");
+}
+
+// Writes s as a JSON string, quotes included.
+static void write_json_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') {
+            fputc('\\', out);
+            fputc(ch, out);
+        } else if (ch < 0x20) {
+            fprintf(out, "\\u%04x", ch);
+        } else {
+            fputc(ch, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void report_json(FILE* out, const char* corpus, const char* label, const BenchCorpus* c,
+                        int iterations, const StageResult* results) {
+    fprintf(out, "{\"label\":");
+    write_json_string(out, label);
+    fprintf(out, ",\"corpus\":");
+    write_json_string(out, corpus);
+    fprintf(out, ",\"lines\":%zu,\"frames\":%zu,\"iterations\":%d,\"hex_pack\":\"%s\",\"stages\":[",
+            c->num_lines, c->num_frames, iterations, hex_pack_impl());
+    for (int s = 0; s < NUM_STAGES; s++) {
+        const StageResult* r = &results[s];
+        double ns_per_msg = r->total_ns / r->messages;
+        fprintf(out, "%s{\"name\":\"%s\",\"messages\":%llu,\"msgs_per_sec\":%.0f,\"ns_per_msg\":%.2f,"
+                     "\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"allocs_per_msg\":%.3f}",
+                s ? "," : "", STAGES[s].name, (unsigned long long)r->messages, 1e9 / ns_per_msg,
+                ns_per_msg, (unsigned long long)r->p50, (unsigned long long)r->p99,
+                (unsigned long long)r->p999, r->allocs_per_msg);
+    }
+    fprintf(out, "]}\n");
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-n iterations] [-f corpus] [--json] [--label name] [--timers]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option options[] = {
+        {"iterations", required_argument, NULL, 'n'},
+        {"file",       required_argument, NULL, 'f'},
+        {"json",       no_argument,       NULL, 'j'},
+        {"label",      required_argument, NULL, 'l'},
+        {"timers",     no_argument,       NULL, 'T'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    const char* corpus = DEFAULT_CORPUS;
+    const char* label = "";
+    int iterations = DEFAULT_ITERATIONS;
+    bool json = false;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:f:jl:Th", options, NULL)) != -1) {
+        switch (opt) {
+            case 'n': iterations = atoi(optarg); break;
+            case 'f': corpus = optarg; break;
+            case 'j': json = true; break;
+            case 'l': label = optarg; break;
+            case 'T': oregon_stats_set_timers(true); break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    BenchCorpus c;
+    if (!load_corpus(corpus, &c) || decode_cache_init(&bench_cache, BENCH_CACHE_SIZE, 0) != 0 ||
+        decode_cache_init(&bench_hit_cache, c.num_lines * 4, 0) != 0 ||
+        oregon_arena_init(&bench_arena, BENCH_ARENA_BLOCK) != 0) {
+        return 1;
+    }
+
+    // The printing wrappers are benchmarked with their output suppressed;
+    // results go to a private copy of the original stdout.
+    fflush(stdout);
+    FILE* out = fdopen(dup(STDOUT_FILENO), "w");
+    int devnull = open("/dev/null", O_WRONLY);
+    if (!out || devnull < 0) {
+        perror("Error: Could not redirect output");
+        return 1;
+    }
+    dup2(devnull, STDOUT_FILENO);
+    dup2(devnull, STDERR_FILENO);
+    close(devnull);
+
+    uint64_t timer_overhead = timer_overhead_ns();
+    StageResult results[sizeof(STAGES) / sizeof(STAGES[0])];
+    for (int s = 0; s < NUM_STAGES; s++) {
+        run_stage(&STAGES[s], &c, iterations, timer_overhead, &results[s]);
+        fflush(stdout);
+    }
+
+    if (json) {
+        report_json(out, corpus, label, &c, iterations, results);
+    } else {
+        report_text(out, corpus, &c, iterations, results);
+    }
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "cul_mux.h"
+
+// Length of the RSSI suffix the CUL appends to every message, in hex chars
+#define RSSI_HEX_CHARS  2
+#define MUX_READ_SIZE   4096
+#define MUX_MAX_EVENTS  CUL_MUX_MAX_SOURCES
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+// FNV-1a
+static uint64_t hash_key(const char* key, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// The CUL reports RSSI as a two's complement byte in half dB steps above
+// -74 dBm, so the signed byte orders copies by signal strength. Lines
+// without one rank lowest.
+static int8_t line_rssi(const char* line, size_t len) {
+    if (len < RSSI_HEX_CHARS) {
+        return INT8_MIN;
+    }
+    int hi = hex_digit(line[len - 2]);
+    int lo = hex_digit(line[len - 1]);
+    return hi < 0 || lo < 0 ? INT8_MIN : (int8_t)(uint8_t)(hi << 4 | lo);
+}
+
+// ==========================================================================
+// DEDUPLICATION
+// ==========================================================================
+
+static void release_oldest(CulMux* mux) {
+    CulPendingLine* p = &mux->pending[mux->pending_head];
+    for (int s = 0; s < mux->num_sources; s++) {
+        if (p->sources & (1u << s)) {
+            if (s == p->best) {
+                mux->sources[s].stats.kept++;
+            } else {
+                mux->sources[s].stats.duplicates++;
+            }
+        }
+    }
+    mux->pending_head = (mux->pending_head + 1) % CUL_MUX_PENDING;
+    mux->pending_count--;
+    mux->cb(mux->ctx, p->line, p->len);
+}
+
+static void release_due(CulMux* mux, uint64_t now) {
+    while (mux->pending_count && mux->pending[mux->pending_head].deadline_ms <= now) {
+        release_oldest(mux);
+    }
+}
+
+// Line callback of every source's reader.
+static void on_source_line(void* ctx, const char* line, size_t len) {
+    CulSource* src = ctx;
+    CulMux* mux = src->mux;
+    if (mux->window_ms == 0) {
+        src->stats.kept++;
+        mux->cb(mux->ctx, line, len);
+        return;
+    }
+
+    size_t key_len = len > RSSI_HEX_CHARS ? len - RSSI_HEX_CHARS : len;
+    uint64_t hash = hash_key(line, key_len);
+    int8_t rssi = line_rssi(line, len);
+    uint32_t bit = 1u << src->index;
+
+    // The oldest copy of this frame this stick has not contributed to yet
+    for (unsigned i = 0; i < mux->pending_count; i++) {
+        CulPendingLine* p = &mux->pending[(mux->pending_head + i) % CUL_MUX_PENDING];
+        if (p->hash != hash || (p->sources & bit) || p->len != len || memcmp(p->line, line, key_len) != 0) {
+            continue;
+        }
+        p->sources |= bit;
+        if (rssi > p->rssi) {
+            memcpy(p->line, line, len + 1);
+            p->rssi = rssi;
+            p->best = src->index;
+        }
+        return;
+    }
+
+    if (mux->pending_count == CUL_MUX_PENDING) {
+        release_oldest(mux);
+    }
+    CulPendingLine* p = &mux->pending[(mux->pending_head + mux->pending_count) % CUL_MUX_PENDING];
+    mux->pending_count++;
+    p->hash = hash;
+    p->deadline_ms = now_ms() + mux->window_ms;
+    p->sources = bit;
+    p->best = src->index;
+    p->rssi = rssi;
+    p->len = (uint16_t)len;
+    memcpy(p->line, line, len + 1);
+}
+
+// ==========================================================================
+// SOURCES
+// ==========================================================================
+
+static int watch_source(CulMux* mux, CulSource* src) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = src;
+    src->polled = true;
+    if (epoll_ctl(mux->epoll_fd, EPOLL_CTL_ADD, src->fd, &ev) != 0) {
+        if (errno != EPERM) {
+            return -1;
+        }
+        // A regular file: always readable, read on every pass instead
+        src->polled = false;
+    }
+    return 0;
+}
+
+static void end_source(CulMux* mux, CulSource* src) {
+    if (src->polled) {
+        epoll_ctl(mux->epoll_fd, EPOLL_CTL_DEL, src->fd, NULL);
+    }
+    if (src->fd > STDIN_FILENO) {
+        close(src->fd);
+    }
+    src->fd = -1;
+    mux->open_sources--;
+}
+
+// End of input: a FIFO is reopened to wait for its next writer, anything
+// else is finished.
+static void source_eof(CulMux* mux, CulSource* src) {
+    cul_line_reader_finish(&src->reader, on_source_line, src);
+    if (!src->fifo) {
+        end_source(mux, src);
+        return;
+    }
+    epoll_ctl(mux->epoll_fd, EPOLL_CTL_DEL, src->fd, NULL);
+    close(src->fd);
+    src->fd = cul_open_source_nonblock(src->path, mux->baud);
+    src->stats.reopens++;
+    if (src->fd < 0 || watch_source(mux, src) != 0) {
+        fprintf(stderr, "Error: Could not reopen %s: %s\n", src->path, strerror(errno));
+        if (src->fd >= 0) {
+            close(src->fd);
+        }
+        src->fd = -1;
+        mux->open_sources--;
+    }
+}
+
+static void read_source(CulMux* mux, CulSource* src) {
+    char buf[MUX_READ_SIZE];
+    ssize_t n = read(src->fd, buf, sizeof(buf));
+    if (n > 0) {
+        src->stats.bytes += (size_t)n;
+        cul_line_reader_feed(&src->reader, buf, (size_t)n, on_source_line, src);
+    } else if (n == 0) {
+        source_eof(mux, src);
+    } else if (errno != EAGAIN && errno != EINTR) {
+        fprintf(stderr, "Error: Read from %s failed: %s\n", src->path, strerror(errno));
+        end_source(mux, src);
+    }
+}
+
+int cul_mux_open(CulMux* mux, const char* const* paths, int num_paths, int baud, uint64_t window_ms,
+                 cul_line_cb cb, void* ctx) {
+    memset(mux, 0, sizeof(*mux));
+    mux->epoll_fd = -1;
+    if (num_paths < 1 || num_paths > CUL_MUX_MAX_SOURCES) {
+        fprintf(stderr, "Error: Between 1 and %d sources are supported\n", CUL_MUX_MAX_SOURCES);
+        errno = EINVAL;
+        return -1;
+    }
+    mux->baud = baud;
+    mux->window_ms = window_ms;
+    mux->cb = cb;
+    mux->ctx = ctx;
+    mux->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (mux->epoll_fd < 0) {
+        perror("Error: epoll_create1");
+        return -1;
+    }
+
+    for (int i = 0; i < num_paths; i++) {
+        CulSource* src = &mux->sources[i];
+        src->mux = mux;
+        src->path = paths[i];
+        src->index = (uint8_t)i;
+        cul_line_reader_init(&src->reader);
+        src->fd = cul_open_source_nonblock(paths[i], baud);
+        mux->num_sources++;
+        if (src->fd < 0) {
+            fprintf(stderr, "Error: Could not open %s: %s\n", paths[i], strerror(errno));
+            cul_mux_close(mux);
+            return -1;
+        }
+        mux->open_sources++;
+
+        struct stat st;
+        src->fifo = strcmp(paths[i], "-") != 0 && fstat(src->fd, &st) == 0 && S_ISFIFO(st.st_mode);
+        if (watch_source(mux, src) != 0) {
+            fprintf(stderr, "Error: Could not watch %s: %s\n", paths[i], strerror(errno));
+            cul_mux_close(mux);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int cul_mux_poll(CulMux* mux) {
+    bool unpolled = false;
+    for (int i = 0; i < mux->num_sources; i++) {
+        unpolled |= mux->sources[i].fd >= 0 && !mux->sources[i].polled;
+    }
+
+    // Sleep until input arrives or the oldest held-back line is due
+    int timeout = -1;
+    if (unpolled) {
+        timeout = 0;
+    } else if (mux->pending_count) {
+        uint64_t now = now_ms();
+        uint64_t due = mux->pending[mux->pending_head].deadline_ms;
+        timeout = due > now ? (int)(due - now) : 0;
+    }
+
+    struct epoll_event events[MUX_MAX_EVENTS];
+    int n = epoll_wait(mux->epoll_fd, events, MUX_MAX_EVENTS, timeout);
+    for (int i = 0; i < n; i++) {
+        CulSource* src = events[i].data.ptr;
+        if (src->fd >= 0) {
+            read_source(mux, src);
+        }
+    }
+    for (int i = 0; i < mux->num_sources; i++) {
+        CulSource* src = &mux->sources[i];
+        if (src->fd >= 0 && !src->polled) {
+            read_source(mux, src);
+        }
+    }
+
+    release_due(mux, now_ms());
+    return mux->open_sources;
+}
+
+void cul_mux_close(CulMux* mux) {
+    for (int i = 0; i < mux->num_sources; i++) {
+        CulSource* src = &mux->sources[i];
+        if (src->fd >= 0) {
+            cul_line_reader_finish(&src->reader, on_source_line, src);
+            end_source(mux, src);
+        }
+    }
+    while (mux->pending_count) {
+        release_oldest(mux);
+    }
+    if (mux->epoll_fd >= 0) {
+        close(mux->epoll_fd);
+        mux->epoll_fd = -1;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef CUL_MUX_H
+#define CUL_MUX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "cul_stream.h"
+
+#define CUL_MUX_MAX_SOURCES 16
+// Frames held back at once while waiting for copies from other sticks
+#define CUL_MUX_PENDING     64
+
+typedef struct {
+    unsigned long bytes;
+    unsigned long kept;         // Lines passed on, as the best copy of their frame
+    unsigned long duplicates;   // Lines dropped for a better copy from another stick
+    unsigned long reopens;      // FIFO writers that went away and were waited for again
+} CulSourceStats;
+
+typedef struct CulMux CulMux;
+
+typedef struct {
+    CulMux* mux;
+    const char* path;
+    int fd;                     // -1 once the source has ended
+    uint8_t index;
+    bool fifo;                  // Reopened when its writer goes away
+    bool polled;                // False for regular files, which epoll cannot watch
+    CulLineReader reader;
+    CulSourceStats stats;
+} CulSource;
+
+// A line waiting out the dedupe window, with the best copy seen so far.
+typedef struct {
+    uint64_t hash;              // Of the line without its RSSI byte
+    uint64_t deadline_ms;
+    uint32_t sources;           // Bit per source that delivered a copy
+    uint8_t best;               // Source of the kept copy
+    int8_t rssi;                // Its raw RSSI byte; larger is stronger
+    uint16_t len;
+    char line[CUL_LINE_MAX + 1];
+} CulPendingLine;
+
+// Reads several CUL sticks (serial devices, FIFOs, stdin or files) in one
+// event loop on non-blocking descriptors, each with its own line reader,
+// and hands lines to a single callback.
+// Several sticks in range of a sensor all report its frames. A line whose
+// frame (the line without its trailing RSSI byte) arrives from another
+// stick within `window_ms` is a duplicate: only the copy with the best RSSI
+// is passed on, once the window has passed. Repeats from the same stick
+// are separate transmissions and are all passed on. window_ms 0 passes
+// every line on at once.
+struct CulMux {
+    int epoll_fd;
+    int baud;
+    uint64_t window_ms;
+    cul_line_cb cb;
+    void* ctx;
+    CulSource sources[CUL_MUX_MAX_SOURCES];
+    int num_sources;
+    int open_sources;
+    CulPendingLine pending[CUL_MUX_PENDING];   // Ring in order of arrival
+    unsigned pending_head;
+    unsigned pending_count;
+};
+
+// Opens every source. Returns 0 on success, or -1 with errno set and a
+// message naming the failing path on stderr.
+int cul_mux_open(CulMux* mux, const char* const* paths, int num_paths, int baud, uint64_t window_ms,
+                 cul_line_cb cb, void* ctx);
+
+// Waits for input (or the end of a dedupe window), reads what is ready and
+// passes on the lines that are due. Returns the number of sources still
+// open; 0 once all have ended. Returns early when a signal arrives.
+int cul_mux_poll(CulMux* mux);
+
+// Passes on everything still held back and closes all sources.
+void cul_mux_close(CulMux* mux);
+
+#endif // CUL_MUX_H
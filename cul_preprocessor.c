@@ -2,157 +2,218 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <endian.h>
 #include "cul_preprocessor.h"
+#include "hex_pack.h"
+#include "oregon_stats.h"
+
+// Payloads longer than CUL_MAX_HEX_CHARS are treated like invalid hex.
+#define CUL_MAX_BITS      (CUL_MAX_HEX_CHARS * 4)
+// One spare word so bit windows can always read the word after the last one.
+#define CUL_BIT_WORDS     (CUL_MAX_BITS / 64 + 1)
+
+// Oregon V2 preamble "10011001" and V3 preamble "11110101" as bit patterns.
+#define OREGON_V2_PREAMBLE 0x99
+#define OREGON_V3_PREAMBLE 0xF5
+// V3 payload starts at the first "0101" in the stream.
+#define OREGON_V3_SYNC     0x5
+
+// ==========================================================================
+// LOOKUP TABLES
+// ==========================================================================
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// Reverses the bit order of a byte.
+#define R2(n) (n), (n) + 2 * 64, (n) + 1 * 64, (n) + 3 * 64
+#define R4(n) R2(n), R2((n) + 2 * 16), R2((n) + 1 * 16), R2((n) + 3 * 16)
+#define R6(n) R4(n), R4((n) + 2 * 4), R4((n) + 1 * 4), R4((n) + 3 * 4)
+static const uint8_t BIT_REVERSE[256] = { R6(0), R6(2), R6(1), R6(3) };
+#undef R2
+#undef R4
+#undef R6
+
+// Manchester de-interleave: picks the second bit of each of the four pairs
+// in a byte (bits 6, 4, 2, 0) and returns them in reversed order, so that
+// bit 6 becomes bit 0 of the result and bit 0 becomes bit 3.
+#define MD(n) ((((n) >> 6) & 1) | ((((n) >> 4) & 1) << 1) | \
+               ((((n) >> 2) & 1) << 2) | (((n) & 1) << 3))
+#define MD4(n)  MD(n), MD((n) + 1), MD((n) + 2), MD((n) + 3)
+#define MD16(n) MD4(n), MD4((n) + 4), MD4((n) + 8), MD4((n) + 12)
+#define MD64(n) MD16(n), MD16((n) + 16), MD16((n) + 32), MD16((n) + 48)
+static const uint8_t MANCHESTER_ODD[256] = { MD64(0), MD64(64), MD64(128), MD64(192) };
+#undef MD
+#undef MD4
+#undef MD16
+#undef MD64
+
+// Manchester encoding of a nibble, the inverse of MANCHESTER_ODD: each bit,
+// least significant first, becomes the pair (~b, b).
+#define MS(n) ((((n) & 1) << 6) | (((n) & 2) << 3) | ((n) & 4) | (((n) & 8) >> 3))
+#define ME(n) (MS(n) | ((MS(n) ^ 0x55) << 1))
+#define ME4(n) ME(n), ME((n) + 1), ME((n) + 2), ME((n) + 3)
+static const uint8_t MANCHESTER_PAIRS[16] = { ME4(0), ME4(4), ME4(8), ME4(12) };
+#undef MS
+#undef ME
+#undef ME4
 
 // ==========================================================================
-// UTILITY FUNCTIONS
+// PACKED BIT STREAM
 // ==========================================================================
 
-// Converts a hex character ('0'-'9', 'a'-'f') to its 4-bit binary string representation.
-static const char* hex_char_to_bin(char c) {
-    switch(c) {
-        case '0': return "0000";
-        case '1': return "0001";
-        case '2': return "0010";
-        case '3': return "0011";
-        case '4': return "0100";
-        case '5': return "0101";
-        case '6': return "0110";
-        case '7': return "0111";
-        case '8': return "1000";
-        case '9': return "1001";
-        case 'a': case 'A': return "1010";
-        case 'b': case 'B': return "1011";
-        case 'c': case 'C': return "1100";
-        case 'd': case 'D': return "1101";
-        case 'e': case 'E': return "1110";
-        case 'f': case 'F': return "1111";
-    }
-    return NULL;
-}
-
-// Converts an 8-character binary string (e.g., "10101011") to a byte.
-static uint8_t bin_str_to_byte(const char* bin_str) {
-    return (uint8_t)strtol(bin_str, NULL, 2);
-}
-
-// Converts a raw hex string from the CUL into a bit string.
-// Caller must free the returned string.
-static char* raw_hex_to_bit_string(const char* hex) {
+// The CUL payload as a packed bit stream, MSB first: bit 0 of the stream is
+// the top bit of words[0].
+typedef struct {
+    uint64_t words[CUL_BIT_WORDS];
+    size_t nbits;
+} BitStream;
+
+// Packs a raw hex string from the CUL into a bit stream.
+// Returns false on an invalid hex character or an oversized payload.
+static bool pack_hex(const char* hex, BitStream* bs) {
     size_t hex_len = strlen(hex);
-    // Each hex char is 4 bits, +1 for null terminator
-    char* bit_string = malloc(hex_len * 4 + 1);
-    if (!bit_string) {
-        perror("malloc failed");
-        return NULL;
+    if (hex_len > CUL_MAX_HEX_CHARS) {
+        return false;
     }
-    bit_string[0] = '\0';
 
-    for (size_t i = 0; i < hex_len; ++i) {
-        const char* bin = hex_char_to_bin(hex[i]);
-        if (bin) {
-            strcat(bit_string, bin);
-        } else {
-            // Invalid hex character
-            free(bit_string);
-            return NULL;
-        }
+    // Packed bytes in memory order are the words in big-endian order
+    memset(bs->words, 0, sizeof(bs->words));
+    if (hex_pack(hex, hex_len, (uint8_t*)bs->words) != hex_len) {
+        return false; // Invalid hex character
+    }
+    for (size_t w = 0; w < (hex_len + 15) / 16; ++w) {
+        bs->words[w] = be64toh(bs->words[w]);
     }
-    return bit_string;
+    bs->nbits = hex_len * 4;
+    return true;
+}
+
+// Returns the n (1..57) bits starting at bit position pos.
+static inline uint32_t get_bits(const BitStream* bs, size_t pos, unsigned n) {
+    size_t w = pos / 64;
+    unsigned off = pos % 64;
+    uint64_t v = bs->words[w] << off;
+    if (off) {
+        v |= bs->words[w + 1] >> (64 - off);
+    }
+    return (uint32_t)(v >> (64 - n));
 }
 
 // ==========================================================================
-// OREGON PROTOCOL DECODERS
+// SYNC SCANNER
 // ==========================================================================
 
-// Decodes an Oregon V2 Manchester-encoded bit stream.
-static char* decode_oregon_v2(const char* bit_data) {
-    const char* preamble = "10011001";
-    char* preamble_pos = strstr(bit_data, preamble);
-
-    if (!preamble_pos) {
-        return NULL; // Not a valid OSV2 message
-    }
-
-    // Allocate buffers
-    char decoded_bits[256] = {0};
-    char final_hex[128] = {0};
-
-    int bit_idx = 0;
-    // Start after the preamble and step 16 bits (8 Manchester-encoded pairs) at a time
-    for (const char* p = preamble_pos; (p - bit_data + 16) <= strlen(bit_data); p += 16) {
-        char reversed_byte[9] = {0};
-        
-        // This loop extracts every second bit and prepends it, effectively
-        // doing the Manchester decode and reversing the bit order simultaneously.
-        for (int i = 1; i < 16; i += 2) {
-            memmove(reversed_byte + 1, reversed_byte, 7);
-            reversed_byte[0] = p[i];
-        }
-        
-        strcat(decoded_bits, reversed_byte);
-    }
-    
-    // Convert the decoded bits back to a hex string
-    for (size_t i = 0; i < strlen(decoded_bits); i += 8) {
-        char current_byte_str[9] = {0};
-        strncpy(current_byte_str, decoded_bits + i, 8);
-        uint8_t byte = bin_str_to_byte(current_byte_str);
-        sprintf(final_hex + strlen(final_hex), "%02X", byte);
+// First positions of the Oregon sync patterns in a stream, -1 where absent.
+typedef struct {
+    long v2_preamble;
+    long v3_preamble;
+    long v3_sync;
+} SyncScan;
+
+// Matches a width-bit pattern at all 64 positions of a chunk. win[k] is the
+// chunk shifted left by k bits; bit 63 - j of the result is set if the
+// pattern starts at bit j of the chunk.
+static inline uint64_t match_pattern(const uint64_t* win, uint32_t pattern, unsigned width) {
+    uint64_t m = ~0ull;
+    for (unsigned k = 0; k < width; ++k) {
+        m &= ((pattern >> (width - 1 - k)) & 1) ? win[k] : ~win[k];
     }
+    return m;
+}
 
-    if (strlen(final_hex) == 0) {
-        return NULL;
+// Returns the first match of a chunk starting at stream bit base that lies
+// entirely within the stream, or -1.
+static inline long first_match(uint64_t m, size_t base, size_t nbits, unsigned width) {
+    if (nbits < base + width) {
+        return -1;
+    }
+    size_t last = nbits - width - base;
+    if (last < 63) {
+        m &= ~(~0ull >> (last + 1));
     }
+    return m ? (long)(base + __builtin_clzll(m)) : -1;
+}
 
-    // Prepend the total bit length as a two-char hex string
-    size_t total_bits = strlen(final_hex) * 4;
-    char* result = malloc(strlen(final_hex) + 3);
-    sprintf(result, "%02lX%s", total_bits, final_hex);
+// Finds the V2 and V3 sync patterns together in one pass over the stream.
+// Per 64-bit chunk the shifted windows are built once and shared by all
+// three patterns. V2 takes priority, so the scan stops at the first V2
+// preamble that leaves room for a byte.
+static void scan_sync(const BitStream* bs, SyncScan* scan) {
+    scan->v2_preamble = scan->v3_preamble = scan->v3_sync = -1;
 
-    return result;
+    for (size_t w = 0; w * 64 < bs->nbits; ++w) {
+        size_t base = w * 64;
+        uint64_t win[8];
+        win[0] = bs->words[w];
+        for (unsigned k = 1; k < 8; ++k) {
+            win[k] = (bs->words[w] << k) | (bs->words[w + 1] >> (64 - k));
+        }
+
+        if (scan->v3_preamble < 0) {
+            scan->v3_preamble = first_match(match_pattern(win, OREGON_V3_PREAMBLE, 8), base, bs->nbits, 8);
+        }
+        if (scan->v3_sync < 0) {
+            scan->v3_sync = first_match(match_pattern(win, OREGON_V3_SYNC, 4), base, bs->nbits, 4);
+        }
+        if (scan->v2_preamble < 0) {
+            scan->v2_preamble = first_match(match_pattern(win, OREGON_V2_PREAMBLE, 8), base, bs->nbits, 8);
+            if (scan->v2_preamble >= 0 && bs->nbits - (size_t)scan->v2_preamble >= 16) {
+                return;
+            }
+        }
+        if (scan->v2_preamble >= 0 && scan->v3_preamble >= 0 && scan->v3_sync >= 0) {
+            return;
+        }
+    }
 }
 
-// Decodes an Oregon V3 bit stream (bit-reversed bytes).
-static char* decode_oregon_v3(const char* bit_data) {
-    const char* preamble = "11110101";
-    if (!strstr(bit_data, preamble)) {
-        return NULL;
+// ==========================================================================
+// OREGON PROTOCOL DECODERS
+// ==========================================================================
+
+// Decodes an Oregon V2 Manchester-encoded bit stream from its preamble into
+// data, setting *nbits to the decoded length.
+static OregonStatus decode_oregon_v2(const BitStream* bs, long start, uint8_t* data, uint16_t* nbits) {
+    if (start < 0) {
+        return OREGON_ERR_NO_PREAMBLE; // Not a valid OSV2 message
     }
-    
-    // Find the start of the actual data
-    char* start_pos = strstr(bit_data, "0101");
-    if (!start_pos) {
-        return NULL;
+
+    // Each output byte takes 16 stream bits (8 Manchester-encoded pairs).
+    // The second bit of every pair carries the data, least significant first.
+    size_t nbytes = (bs->nbits - (size_t)start) / 16;
+    if (nbytes == 0) {
+        return OREGON_ERR_NO_PREAMBLE;
     }
 
-    char final_hex[128] = {0};
+    for (size_t i = 0; i < nbytes; ++i) {
+        uint32_t w = get_bits(bs, (size_t)start + i * 16, 16);
+        data[i] = (uint8_t)(MANCHESTER_ODD[w >> 8] | (MANCHESTER_ODD[w & 0xFF] << 4));
+    }
 
-    // Step 8 bits at a time
-    for (const char* p = start_pos; (p - bit_data + 8) <= strlen(bit_data); p += 8) {
-        char byte_str[9] = {0};
-        char reversed_byte_str[9] = {0};
-        strncpy(byte_str, p, 8);
+    *nbits = (uint16_t)(nbytes * 8);
+    return OREGON_OK;
+}
 
-        // Reverse the bits in the byte
-        for (int i = 0; i < 8; ++i) {
-            reversed_byte_str[i] = byte_str[7 - i];
-        }
-        
-        uint8_t byte = bin_str_to_byte(reversed_byte_str);
-        sprintf(final_hex + strlen(final_hex), "%02X", byte);
+// Decodes an Oregon V3 bit stream (bit-reversed bytes). The data starts at
+// the first sync nibble, wherever the preamble is.
+static OregonStatus decode_oregon_v3(const BitStream* bs, long preamble, long start, uint8_t* data,
+                                     uint16_t* nbits) {
+    if (preamble < 0 || start < 0) {
+        return OREGON_ERR_NO_PREAMBLE;
     }
 
-    if (strlen(final_hex) == 0) {
-        return NULL;
+    size_t nbytes = (bs->nbits - (size_t)start) / 8;
+    if (nbytes == 0) {
+        return OREGON_ERR_NO_PREAMBLE;
     }
-    
-    // Prepend bit length
-    size_t total_bits = strlen(final_hex) * 4;
-    char* result = malloc(strlen(final_hex) + 3);
-    sprintf(result, "%02lX%s", total_bits, final_hex);
 
-    return result;
+    for (size_t i = 0; i < nbytes; ++i) {
+        data[i] = BIT_REVERSE[get_bits(bs, (size_t)start + i * 8, 8)];
+    }
+
+    *nbits = (uint16_t)(nbytes * 8);
+    return OREGON_OK;
 }
 
 
@@ -160,39 +221,194 @@ static char* decode_oregon_v3(const char* bit_data) {
 // MAIN PRE-PROCESSOR FUNCTION
 // ==========================================================================
 
-char* preprocess_cul_message(const char* cul_msg) {
+// Checks the "om" prefix and packs the hex payload.
+static inline OregonStatus pack_message(const char* cul_msg, BitStream* bits) {
     // Check for "om" prefix and minimum length
     if (strncmp(cul_msg, "om", 2) != 0 || strlen(cul_msg) < 4) {
-        fprintf(stderr, "Error: Invalid CUL message format. Must start with 'om'.\n");
-        return NULL;
+        return OREGON_ERR_BAD_PREFIX;
     }
-    
+
     // The actual raw hex data starts after "om"
-    const char* raw_hex = cul_msg + 2;
-    
-    char* bit_string = raw_hex_to_bit_string(raw_hex);
-    if (!bit_string) {
-        fprintf(stderr, "Error: Could not convert raw hex to bit string.\n");
-        return NULL;
+    if (!pack_hex(cul_msg + 2, bits)) {
+        return OREGON_ERR_BAD_HEX;
     }
-    
-    char* result = NULL;
+    return OREGON_OK;
+}
 
-    // Try decoding as Oregon V2
-    result = decode_oregon_v2(bit_string);
-    if (result) {
-        free(bit_string);
-        return result;
+// Decodes the payload from the sync positions; V2 wins if it decodes.
+// Returns the protocol version in *version.
+static inline OregonStatus decode_payload(const BitStream* bits, const SyncScan* scan, uint8_t* data,
+                                          uint16_t* nbits, uint8_t* version) {
+    OregonStatus status = decode_oregon_v2(bits, scan->v2_preamble, data, nbits);
+    if (status != OREGON_ERR_NO_PREAMBLE) {
+        *version = 2;
+        return status;
+    }
+    status = decode_oregon_v3(bits, scan->v3_preamble, scan->v3_sync, data, nbits);
+    if (status == OREGON_OK) {
+        *version = 3;
+    }
+    return status;
+}
+
+// The CUL appends the RSSI as the last byte of the message
+static inline uint8_t message_rssi(const BitStream* bits) {
+    return (uint8_t)get_bits(bits, bits->nbits - 8, 8);
+}
+
+static OregonStatus preprocess_frame(const char* cul_msg, OregonFrame* frame) {
+    BitStream bits;
+    OregonStatus status = pack_message(cul_msg, &bits);
+    if (status != OREGON_OK) {
+        return status;
+    }
+    frame->rssi = message_rssi(&bits);
+
+    // Locate both protocols' sync patterns at once
+    SyncScan scan;
+    scan_sync(&bits, &scan);
+    return decode_payload(&bits, &scan, frame->data, &frame->bits, &frame->version);
+}
+
+OregonStatus cul_preprocess_frame(const char* cul_msg, OregonFrame* frame) {
+    OREGON_STATS_BEGIN(start);
+    OregonStatus status = preprocess_frame(cul_msg, frame);
+    OREGON_STATS_END(OREGON_STAGE_PREPROCESS, status, start);
+    return status;
+}
+
+OregonStatus cul_frame_to_hex(const OregonFrame* frame, char* out, size_t out_size) {
+    unsigned total_bits = frame->bits;
+    size_t nbytes = total_bits / 8;
+    // The bit length takes at least two hex digits, more if it needs them.
+    int len_digits = 2;
+    while ((total_bits >> (4 * len_digits)) != 0) {
+        len_digits++;
+    }
+
+    if (out_size < len_digits + nbytes * 2 + 1) {
+        return OREGON_ERR_BUFFER_TOO_SMALL;
+    }
+
+    for (int d = len_digits - 1; d >= 0; --d) {
+        *out++ = HEX_DIGITS[(total_bits >> (4 * d)) & 0xF];
+    }
+    for (size_t i = 0; i < nbytes; ++i) {
+        *out++ = HEX_DIGITS[frame->data[i] >> 4];
+        *out++ = HEX_DIGITS[frame->data[i] & 0xF];
+    }
+    *out = '\0';
+    return OREGON_OK;
+}
+
+// ==========================================================================
+// ENCODER
+// ==========================================================================
+
+// Lead-ins before the payload: V2 alternates up to its preamble, which is
+// the Manchester-coded first payload nibble. V3 is all ones, forming its
+// preamble with the first payload nibble, which is also its sync.
+#define CUL_V2_LEAD_IN "AAAA"
+#define CUL_V3_LEAD_IN "FFFFFF"
+
+OregonStatus cul_encode_frame(const OregonFrame* frame, char* out, size_t out_size) {
+    size_t nibbles = ((size_t)frame->bits + 3) / 4;
+    if ((frame->version != 2 && frame->version != 3) || nibbles < 2 || (frame->data[0] & 0x0F) != 0xA) {
+        return OREGON_ERR_NO_PREAMBLE;
+    }
+    bool v2 = frame->version == 2;
+    const char* lead = v2 ? CUL_V2_LEAD_IN : CUL_V3_LEAD_IN;
+    size_t lead_len = strlen(lead);
+    size_t hex_len = lead_len + nibbles * (v2 ? 2 : 1) + 2;
+    if (hex_len > CUL_MAX_HEX_CHARS) {
+        return OREGON_ERR_BAD_HEX;
+    }
+    if (out_size < 2 + hex_len + 1) {
+        return OREGON_ERR_BUFFER_TOO_SMALL;
     }
 
-    // If V2 fails, try decoding as Oregon V3
-    result = decode_oregon_v3(bit_string);
+    char* p = out;
+    *p++ = 'o';
+    *p++ = 'm';
+    memcpy(p, lead, lead_len);
+    p += lead_len;
+    // Both protocols send the low nibble of a byte before the high one, and
+    // the bits of a nibble least significant first
+    for (size_t j = 0; j < nibbles; j++) {
+        uint8_t byte = frame->data[j / 2];
+        unsigned nibble = (j & 1) ? byte >> 4 : byte & 0x0F;
+        if (v2) {
+            *p++ = HEX_DIGITS[MANCHESTER_PAIRS[nibble] >> 4];
+            *p++ = HEX_DIGITS[MANCHESTER_PAIRS[nibble] & 0xF];
+        } else {
+            *p++ = HEX_DIGITS[BIT_REVERSE[nibble] >> 4];
+        }
+    }
+    *p++ = HEX_DIGITS[frame->rssi >> 4];
+    *p++ = HEX_DIGITS[frame->rssi & 0xF];
+    *p = '\0';
+
+    // The decoder tries V2 first, so a V2 preamble anywhere in a V3 line
+    // would take it over
+    if (!v2) {
+        BitStream bits;
+        SyncScan scan;
+        pack_hex(out + 2, &bits);
+        scan_sync(&bits, &scan);
+        if (scan.v2_preamble >= 0 && bits.nbits - (size_t)scan.v2_preamble >= 16) {
+            return OREGON_ERR_NO_PREAMBLE;
+        }
+    }
+    return OREGON_OK;
+}
+
+OregonStatus cul_preprocess(const char* cul_msg, char* out_hex, size_t out_size) {
+    OregonFrame frame;
+
+    OregonStatus status = cul_preprocess_frame(cul_msg, &frame);
+    if (status != OREGON_OK) {
+        return status;
+    }
+    return cul_frame_to_hex(&frame, out_hex, out_size);
+}
+
+void print_preprocess_error(OregonStatus status) {
+    switch (status) {
+        case OREGON_ERR_BAD_PREFIX:
+            fprintf(stderr, "Error: Invalid CUL message format. Must start with 'om'.\n");
+            break;
+        case OREGON_ERR_BAD_HEX:
+            fprintf(stderr, "Error: Could not convert raw hex to bit string.\n");
+            break;
+        default:
+            break; // Frames without a preamble are rejected silently
+    }
+}
+
+char* preprocess_cul_message(const char* cul_msg) {
+    char hex[CUL_HEX_OUTPUT_SIZE];
+
+    OregonStatus status = cul_preprocess(cul_msg, hex, sizeof(hex));
+    if (status != OREGON_OK) {
+        print_preprocess_error(status);
+        return NULL;
+    }
+
+    size_t len = strlen(hex) + 1;
+    char* result = malloc(len);
     if (result) {
-        free(bit_string);
-        return result;
+        memcpy(result, hex, len);
     }
+    return result;
+}
+
+char* preprocess_cul_message_arena(const char* cul_msg, OregonArena* arena) {
+    char hex[CUL_HEX_OUTPUT_SIZE];
 
-    // If both fail
-    free(bit_string);
-    return NULL;
-}
\ No newline at end of file
+    OregonStatus status = cul_preprocess(cul_msg, hex, sizeof(hex));
+    if (status != OREGON_OK) {
+        print_preprocess_error(status);
+        return NULL;
+    }
+    return oregon_arena_strdup(arena, hex);
+}
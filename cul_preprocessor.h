@@ -1,10 +1,68 @@
 #ifndef CUL_PREPROCESSOR_H
 #define CUL_PREPROCESSOR_H
 
-// Pre-processes a raw CUL message (e.g., "omAAAA...") into a clean 
+#include <stddef.h>
+#include <stdint.h>
+#include "oregon_status.h"
+#include "oregon_arena.h"
+
+// Longest raw hex payload (the part after "om") that can be decoded.
+#define CUL_MAX_HEX_CHARS 256
+
+// Largest decoded Oregon frame in bytes.
+#define OREGON_FRAME_MAX_BYTES (CUL_MAX_HEX_CHARS / 2)
+// Size of arrays indexed by OregonFrame.version; index 0 counts no frame.
+#define OREGON_VERSION_COUNT 4
+
+// A decoded Oregon frame, handed from the pre-processor to the parser.
+typedef struct {
+    uint16_t bits;      // Decoded length in bits
+    uint8_t version;    // Oregon protocol version (2 or 3)
+    uint8_t rssi;       // Raw RSSI byte the CUL appends to every message
+    uint8_t data[OREGON_FRAME_MAX_BYTES]; // Payload, starting with the sensor type id
+} OregonFrame;
+
+// Buffer size that always fits the output of cul_preprocess():
+// up to three bit-length digits, two hex chars per byte and a terminator.
+#define CUL_HEX_OUTPUT_SIZE (3 + CUL_MAX_HEX_CHARS + 1)
+
+// Pre-processes a raw CUL message (e.g., "omAAAA...") into a binary frame.
+// Reentrant: uses no heap and no stdio. The only global state is the
+// per-thread statistics (oregon_stats.h), registered on a thread's first call.
+// Returns OREGON_OK on success, otherwise the reason the message was rejected.
+OregonStatus cul_preprocess_frame(const char* cul_msg, OregonFrame* frame);
+
+// Renders a frame as a hex string: the bit length (at least two hex digits)
+// followed by the payload bytes (e.g., "581a89..."). Meant for debugging.
+OregonStatus cul_frame_to_hex(const OregonFrame* frame, char* out_hex, size_t out_size);
+
+// Renders a frame as the raw CUL message a stick would report for it: "om",
+// a lead-in, the payload line-coded for frame->version (V2 Manchester or V3
+// bit-reversed) and frame->rssi. The inverse of cul_preprocess_frame(), meant
+// for generating test traffic; out_size of CUL_HEX_OUTPUT_SIZE always fits.
+// frame->data must start with a sensor type id, whose low nibble 0xA doubles
+// as the sync pattern. Returns OREGON_ERR_NO_PREAMBLE for any other start or
+// version, or for a V3 line that would read as V2 because the payload happens
+// to contain the V2 preamble; OREGON_ERR_BAD_HEX if the line gets too long.
+OregonStatus cul_encode_frame(const OregonFrame* frame, char* out, size_t out_size);
+
+// Pre-processes a raw CUL message (e.g., "omAAAA...") into a clean
+// Oregon Scientific hex string (e.g., "581a89...") written to out_hex.
+// Same as cul_preprocess_frame() followed by cul_frame_to_hex().
+OregonStatus cul_preprocess(const char* cul_msg, char* out_hex, size_t out_size);
+
+// Prints the stderr diagnostic the command line tools show for a failed
+// pre-processing status.
+void print_preprocess_error(OregonStatus status);
+
+// Pre-processes a raw CUL message (e.g., "omAAAA...") into a clean
 // Oregon Scientific hex string (e.g., "581a89...").
 // The caller is responsible for freeing the returned string.
 // Returns NULL if the message cannot be decoded.
 char* preprocess_cul_message(const char* cul_msg);
 
-#endif // CUL_PREPROCESSOR_H
\ No newline at end of file
+// Same, but the string is allocated from `arena` and lives until the arena
+// is reset; nothing is allocated from the heap once the arena has warmed up.
+char* preprocess_cul_message_arena(const char* cul_msg, OregonArena* arena);
+
+#endif // CUL_PREPROCESSOR_H
@@ -0,0 +1,133 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "cul_stream.h"
+
+// ==========================================================================
+// LINE REASSEMBLY
+// ==========================================================================
+
+void cul_line_reader_init(CulLineReader* reader) {
+    memset(reader, 0, sizeof(*reader));
+}
+
+// Terminates the buffered line, strips a trailing CR and hands it to cb.
+static void emit_line(CulLineReader* reader, cul_line_cb cb, void* ctx) {
+    size_t len = reader->len;
+    if (len > 0 && reader->buf[len - 1] == '\r') {
+        len--;
+    }
+    reader->len = 0;
+    if (len == 0) {
+        return; // Skip empty lines
+    }
+
+    reader->buf[len] = '\0';
+    reader->lines++;
+    cb(ctx, reader->buf, len);
+}
+
+void cul_line_reader_feed(CulLineReader* reader, const char* data, size_t len,
+                          cul_line_cb cb, void* ctx) {
+    while (len > 0) {
+        const char* nl = memchr(data, '\n', len);
+        size_t chunk = nl ? (size_t)(nl - data) : len;
+
+        if (!reader->discarding) {
+            if (reader->len + chunk > CUL_LINE_MAX) {
+                // Too long to be a CUL message; drop it up to the next newline
+                reader->discarding = true;
+                reader->len = 0;
+                reader->overlong++;
+            } else {
+                memcpy(reader->buf + reader->len, data, chunk);
+                reader->len += chunk;
+            }
+        }
+
+        if (!nl) {
+            return; // Partial line, wait for more data
+        }
+
+        if (reader->discarding) {
+            reader->discarding = false;
+        } else {
+            emit_line(reader, cb, ctx);
+        }
+        data += chunk + 1;
+        len -= chunk + 1;
+    }
+}
+
+void cul_line_reader_finish(CulLineReader* reader, cul_line_cb cb, void* ctx) {
+    if (!reader->discarding) {
+        emit_line(reader, cb, ctx);
+    }
+    reader->discarding = false;
+    reader->len = 0;
+}
+
+
+// ==========================================================================
+// SOURCES
+// ==========================================================================
+
+static speed_t baud_to_speed(int baud) {
+    switch (baud) {
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 115200: return B115200;
+        default:     return B0;
+    }
+}
+
+static int open_source(const char* path, int baud, int flags) {
+    if (strcmp(path, "-") == 0) {
+        if (flags & O_NONBLOCK) {
+            fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+        }
+        return STDIN_FILENO;
+    }
+
+    int fd = open(path, O_RDONLY | O_NOCTTY | flags);
+    if (fd < 0 || !isatty(fd)) {
+        return fd;
+    }
+
+    // Serial device: raw 8N1, no echo, block until at least one byte arrives
+    struct termios tio;
+    speed_t speed = baud_to_speed(baud);
+    if (tcgetattr(fd, &tio) != 0) {
+        goto fail;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (speed == B0 || cfsetispeed(&tio, speed) != 0 || cfsetospeed(&tio, speed) != 0) {
+        errno = EINVAL;
+        goto fail;
+    }
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        goto fail;
+    }
+    return fd;
+
+fail:;
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return -1;
+}
+
+int cul_open_source(const char* path, int baud) {
+    return open_source(path, baud, 0);
+}
+
+int cul_open_source_nonblock(const char* path, int baud) {
+    return open_source(path, baud, O_NONBLOCK);
+}
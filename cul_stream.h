@@ -0,0 +1,41 @@
+#ifndef CUL_STREAM_H
+#define CUL_STREAM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Longest line accepted from a CUL stream. Longer lines are dropped whole.
+#define CUL_LINE_MAX 512
+
+// Called for every complete line, without its CR/LF and NUL-terminated.
+typedef void (*cul_line_cb)(void* ctx, const char* line, size_t len);
+
+// Reassembles newline-delimited CUL output from arbitrarily split reads.
+typedef struct {
+    char buf[CUL_LINE_MAX + 1];
+    size_t len;
+    bool discarding;          // Skipping the rest of an overlong line
+    unsigned long lines;      // Complete lines handed to the callback
+    unsigned long overlong;   // Lines dropped for exceeding CUL_LINE_MAX
+} CulLineReader;
+
+void cul_line_reader_init(CulLineReader* reader);
+
+// Feeds raw bytes into the reader and calls cb for each line they complete.
+// A partial line at the end is kept until the next call. Empty lines are skipped.
+void cul_line_reader_feed(CulLineReader* reader, const char* data, size_t len,
+                          cul_line_cb cb, void* ctx);
+
+// Hands a trailing unterminated line to cb, e.g. at end of file.
+void cul_line_reader_finish(CulLineReader* reader, cul_line_cb cb, void* ctx);
+
+// Opens a CUL source for reading: "-" is stdin, anything else a path to a
+// file, FIFO or serial device. Serial devices are switched to raw mode at
+// the given baud rate. Returns a file descriptor or -1 with errno set.
+int cul_open_source(const char* path, int baud);
+
+// Same, with O_NONBLOCK set, for event loops. A FIFO opens at once even
+// without a writer.
+int cul_open_source_nonblock(const char* path, int baud);
+
+#endif // CUL_STREAM_H
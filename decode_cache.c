@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <string.h>
+#include "decode_cache.h"
+#include "oregon_stats.h"
+
+// Length of the RSSI suffix the CUL appends to every message, in hex chars
+#define RSSI_HEX_CHARS 2
+
+static inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t load_word(const char* p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+// Hashes 8 bytes at a time in two interleaved lanes, so the multiplies
+// overlap; a tail of under 16 bytes is read as whole words that may overlap
+// bytes already hashed. A final avalanche makes the low bits that pick the
+// set depend on every byte. Never returns 0 so that 0 can mark empty entries.
+static uint64_t hash_key(const char* key, size_t len) {
+    uint64_t a = len * 0x9e3779b97f4a7c15ull, b = 0;
+    size_t i = 0;
+    for (; i + 2 * sizeof(uint64_t) <= len; i += 2 * sizeof(uint64_t)) {
+        a = (a ^ load_word(key + i)) * 0xc4ceb9fe1a85ec53ull;
+        b = (b ^ load_word(key + i + sizeof(uint64_t))) * 0x9e3779b97f4a7c15ull;
+    }
+    size_t rest = len - i;
+    if (len < sizeof(uint64_t)) {
+        uint64_t w = 0;
+        for (size_t k = 0; k < len; k++) {
+            w = (w << 8) | (unsigned char)key[k];
+        }
+        a = (a ^ w) * 0xc4ceb9fe1a85ec53ull;
+    } else {
+        if (rest > sizeof(uint64_t)) {
+            a = (a ^ load_word(key + i)) * 0xc4ceb9fe1a85ec53ull;
+        }
+        if (rest > 0) {
+            b = (b ^ load_word(key + len - sizeof(uint64_t))) * 0x9e3779b97f4a7c15ull;
+        }
+    }
+    return mix(a ^ (b >> 31) ^ (b << 33)) | 1;
+}
+
+// Compares two keys of the same length a word at a time, the last word
+// overlapping the one before, like hash_key().
+static inline bool same_key(const char* x, const char* y, size_t len) {
+    if (len < sizeof(uint64_t)) {
+        return memcmp(x, y, len) == 0;
+    }
+    uint64_t diff = 0;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) < len; i += sizeof(uint64_t)) {
+        diff |= load_word(x + i) ^ load_word(y + i);
+    }
+    diff |= load_word(x + len - sizeof(uint64_t)) ^ load_word(y + len - sizeof(uint64_t));
+    return diff == 0;
+}
+
+// Hash of a whole line, from the hash of the line without its RSSI suffix.
+static inline uint64_t hash_with_rssi(uint64_t hash, const char* rssi) {
+    uint64_t r = ((uint64_t)(unsigned char)rssi[0] << 8) | (unsigned char)rssi[1];
+    return mix(hash ^ (r * 0xc4ceb9fe1a85ec53ull)) | 1;
+}
+
+int decode_cache_init(DecodeCache* cache, size_t capacity, uint64_t ttl_ms) {
+    memset(cache, 0, sizeof(*cache));
+
+    size_t sets = 1;
+    while (sets * DECODE_CACHE_WAYS < capacity) {
+        sets <<= 1;
+    }
+    // Cache-line aligned, so that no set's hashes straddle two lines
+    size_t hash_bytes = (sets * DECODE_CACHE_WAYS * sizeof(uint64_t) + 63) & ~(size_t)63;
+    cache->hashes = aligned_alloc(64, hash_bytes);
+    cache->entries = calloc(sets * DECODE_CACHE_WAYS, sizeof(DecodeCacheEntry));
+    if (!cache->hashes || !cache->entries) {
+        decode_cache_free(cache);
+        return -1;
+    }
+    memset(cache->hashes, 0, hash_bytes);
+    cache->num_sets = sets;
+    cache->ttl_ms = ttl_ms;
+    return 0;
+}
+
+void decode_cache_free(DecodeCache* cache) {
+    free(cache->hashes);
+    free(cache->entries);
+    cache->hashes = NULL;
+    cache->entries = NULL;
+    cache->num_sets = 0;
+}
+
+void decode_cache_clear(DecodeCache* cache) {
+    memset(cache->hashes, 0, cache->num_sets * DECODE_CACHE_WAYS * sizeof(uint64_t));
+}
+
+// Copies a cached result to the caller's buffers: the readings it holds,
+// not the whole entry.
+static OregonStatus answer_from(const DecodeCacheEntry* e, OregonMessageInfo* info,
+                                OregonReading* readings, int max_readings, int* num_readings) {
+    if (info) {
+        *info = e->info;
+    }
+    if (e->num_readings > max_readings) {
+        *num_readings = 0;
+        return OREGON_ERR_BUFFER_TOO_SMALL;
+    }
+    for (int i = 0; i < e->num_readings; i++) {
+        readings[i] = e->readings[i];
+    }
+    *num_readings = e->num_readings;
+    return e->status;
+}
+
+// Where a result may be stored: an entry index, and whether it holds the
+// same key already (an expired result being refreshed).
+typedef struct {
+    size_t index;
+    bool refresh;
+} CacheSlot;
+
+// Looks a key up in its set, accepting only entries whose outcome matches
+// ok. Returns the live entry, or NULL with *slot set to where a new result
+// for the key goes: the expired entry of the same key, else an empty
+// entry, else the oldest one.
+static DecodeCacheEntry* lookup(DecodeCache* cache, uint64_t hash, const char* key, size_t key_len, bool ok,
+                                uint64_t now_ms, CacheSlot* slot) {
+    size_t first = (hash & (cache->num_sets - 1)) * DECODE_CACHE_WAYS;
+    const uint64_t* hashes = &cache->hashes[first];
+    DecodeCacheEntry* set = &cache->entries[first];
+
+    for (int w = 0; w < DECODE_CACHE_WAYS; w++) {
+        DecodeCacheEntry* e = &set[w];
+        if (hashes[w] != hash || e->key_len != key_len || (e->status == OREGON_OK) != ok ||
+            !same_key(e->key, key, key_len)) {
+            continue;
+        }
+        if (cache->ttl_ms == 0 || now_ms - e->stored_ms <= cache->ttl_ms) {
+            return e;
+        }
+        cache->stats.expired++;
+        *slot = (CacheSlot){first + w, true};
+        return NULL;
+    }
+
+    int victim = 0;
+    for (int w = 1; w < DECODE_CACHE_WAYS && hashes[victim] != 0; w++) {
+        if (hashes[w] == 0 || set[w].stored_ms < set[victim].stored_ms) {
+            victim = w;
+        }
+    }
+    *slot = (CacheSlot){first + victim, false};
+    return NULL;
+}
+
+OregonStatus decode_cache_decode_cul(DecodeCache* cache, const char* cul_msg, uint64_t now_ms,
+                                     OregonMessageInfo* info, OregonReading* readings,
+                                     int max_readings, int* num_readings) {
+    size_t len = strlen(cul_msg);
+    if (len <= RSSI_HEX_CHARS || len > DECODE_CACHE_KEY_MAX) {
+        cache->stats.uncacheable++;
+        return oregon_decode_cul(cul_msg, info, readings, max_readings, num_readings);
+    }
+
+    // Successes are keyed without the RSSI suffix, failures with it
+    size_t ok_len = len - RSSI_HEX_CHARS;
+    uint64_t ok_hash = hash_key(cul_msg, ok_len);
+    uint64_t failed_hash = 0;
+    CacheSlot ok_slot, failed_slot;
+    DecodeCacheEntry* e = lookup(cache, ok_hash, cul_msg, ok_len, true, now_ms, &ok_slot);
+    if (!e) {
+        failed_hash = hash_with_rssi(ok_hash, cul_msg + ok_len);
+        e = lookup(cache, failed_hash, cul_msg, len, false, now_ms, &failed_slot);
+    }
+    if (e) {
+        OREGON_STATS_BEGIN(start);
+        cache->stats.hits++;
+        OregonStatus status = answer_from(e, info, readings, max_readings, num_readings);
+        OREGON_STATS_END(OREGON_STAGE_CACHE_HIT, status, start);
+        return status;
+    }
+
+    cache->stats.misses++;
+    DecodeCacheEntry fresh;
+    int count = 0;
+    fresh.status = oregon_decode_cul(cul_msg, &fresh.info, fresh.readings, OREGON_MAX_READINGS, &count);
+    bool ok = fresh.status == OREGON_OK;
+    const CacheSlot* slot = ok ? &ok_slot : &failed_slot;
+    if (!slot->refresh && cache->hashes[slot->index] != 0) {
+        cache->stats.evictions++;
+    }
+
+    e = &cache->entries[slot->index];
+    e->stored_ms = now_ms;
+    e->status = fresh.status;
+    e->key_len = (uint8_t)(ok ? ok_len : len);
+    e->num_readings = (uint8_t)count;
+    memcpy(e->key, cul_msg, e->key_len);
+    memcpy(e->readings, fresh.readings, count * sizeof(OregonReading));
+    e->info = fresh.info;
+    cache->hashes[slot->index] = ok ? ok_hash : failed_hash;
+    return answer_from(e, info, readings, max_readings, num_readings);
+}
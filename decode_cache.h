@@ -0,0 +1,66 @@
+#ifndef DECODE_CACHE_H
+#define DECODE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "oregon_parser.h"
+
+// Longest CUL line that is cached, RSSI suffix included. Longer lines are
+// decoded normally and never cached.
+#define DECODE_CACHE_KEY_MAX 64
+// Entries per set; a set is picked by hash and searched linearly.
+#define DECODE_CACHE_WAYS    4
+
+typedef struct {
+    uint64_t stored_ms;
+    OregonStatus status;
+    uint8_t key_len;
+    uint8_t num_readings;
+    char key[DECODE_CACHE_KEY_MAX];     // Without the RSSI suffix unless status is a failure
+    OregonReading readings[OREGON_MAX_READINGS];
+    OregonMessageInfo info;         // Last: only copied out when asked for
+} DecodeCacheEntry;
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long expired;      // Misses caused by an entry older than the TTL
+    unsigned long evictions;    // Live entries replaced to make room
+    unsigned long uncacheable;  // Lines too short or too long to be cached
+} DecodeCacheStats;
+
+// Bounded cache of recent decode results keyed on the raw CUL line with its
+// trailing RSSI byte ignored, so repeated transmissions of the same frame
+// skip the Manchester decode, checksum and field extraction.
+// Successful results are reused whatever the RSSI; failures are only reused
+// for an exact repeat of the line, because the RSSI bits take part in the
+// preamble search of a frame that did not decode. Failures are therefore
+// stored under the whole line, so the copies of a bad frame heard with
+// different RSSIs spread over the sets instead of thrashing one.
+// A lookup hashes the key a word at a time and scans the set's hashes,
+// which share a cache line, so only a matching entry is touched. A hit
+// copies out just the readings, and the message info if it is asked for.
+// Not thread-safe; use one cache per thread.
+typedef struct {
+    uint64_t* hashes;           // Per entry, 0 if empty; a set's fit in one cache line
+    DecodeCacheEntry* entries;
+    size_t num_sets;            // Power of two
+    uint64_t ttl_ms;            // 0 means entries never expire
+    DecodeCacheStats stats;
+} DecodeCache;
+
+// Allocates a cache of at least `capacity` entries (rounded up to a power
+// of two) once, up front. Returns 0 on success, -1 if allocation fails.
+int decode_cache_init(DecodeCache* cache, size_t capacity, uint64_t ttl_ms);
+void decode_cache_free(DecodeCache* cache);
+
+// Empties the cache without freeing it. The statistics are kept.
+void decode_cache_clear(DecodeCache* cache);
+
+// Same contract as oregon_decode_cul(), answered from the cache when possible.
+// now_ms is a monotonic timestamp used for the TTL.
+OregonStatus decode_cache_decode_cul(DecodeCache* cache, const char* cul_msg, uint64_t now_ms,
+                                     OregonMessageInfo* info, OregonReading* readings,
+                                     int max_readings, int* num_readings);
+
+#endif // DECODE_CACHE_H
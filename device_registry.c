@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <string.h>
+#include "device_registry.h"
+
+// Multiplicative hash, the same as for the sensor table; uses the top bits.
+static inline uint32_t slot_of(const DeviceRegistry* reg, uint32_t device) {
+    return (device * 0x9E3779B1u) >> (32 - __builtin_ctz(reg->num_slots));
+}
+
+int device_registry_init(DeviceRegistry* reg, uint32_t expected) {
+    memset(reg, 0, sizeof(*reg));
+    if (expected < 8) {
+        expected = 8;
+    }
+
+    uint32_t slots = 16;
+    while (slots < expected * 2) {
+        slots <<= 1;
+    }
+    reg->devices = malloc(expected * sizeof(DeviceEntry));
+    reg->slots = calloc(slots, sizeof(uint32_t));
+    if (!reg->devices || !reg->slots) {
+        device_registry_free(reg);
+        return -1;
+    }
+    reg->cap_devices = expected;
+    reg->num_slots = slots;
+    return 0;
+}
+
+void device_registry_free(DeviceRegistry* reg) {
+    free(reg->devices);
+    free(reg->slots);
+    memset(reg, 0, sizeof(*reg));
+}
+
+// Returns the slot holding the device, or the empty slot where it belongs.
+static uint32_t probe(const DeviceRegistry* reg, uint32_t device) {
+    uint32_t mask = reg->num_slots - 1;
+    uint32_t s = slot_of(reg, device);
+    while (reg->slots[s] && reg->devices[reg->slots[s] - 1].device != device) {
+        s = (s + 1) & mask;
+    }
+    return s;
+}
+
+int32_t device_registry_find(const DeviceRegistry* reg, uint32_t device) {
+    return (int32_t)reg->slots[probe(reg, device)] - 1;
+}
+
+// Doubles the slot table and re-inserts every id.
+static bool grow_slots(DeviceRegistry* reg) {
+    uint32_t* old = reg->slots;
+    uint32_t old_count = reg->num_slots;
+    uint32_t* slots = calloc((size_t)old_count * 2, sizeof(uint32_t));
+    if (!slots) {
+        return false;
+    }
+
+    reg->slots = slots;
+    reg->num_slots = old_count * 2;
+    for (uint32_t s = 0; s < old_count; s++) {
+        if (old[s]) {
+            reg->slots[probe(reg, reg->devices[old[s] - 1].device)] = old[s];
+        }
+    }
+    free(old);
+    return true;
+}
+
+int32_t device_registry_observe(DeviceRegistry* reg, uint32_t device, uint64_t now) {
+    uint32_t s = probe(reg, device);
+    if (!reg->slots[s]) {
+        // Keep the load factor at or below one half
+        if ((reg->num_devices + 1) * 2 > reg->num_slots) {
+            if (!grow_slots(reg)) {
+                return -1;
+            }
+            s = probe(reg, device);
+        }
+        if (reg->num_devices == reg->cap_devices) {
+            DeviceEntry* devices = realloc(reg->devices, reg->cap_devices * 2 * sizeof(DeviceEntry));
+            if (!devices) {
+                return -1;
+            }
+            reg->devices = devices;
+            reg->cap_devices *= 2;
+        }
+
+        DeviceEntry* e = &reg->devices[reg->num_devices];
+        e->device = device;
+        oregon_device_name(device, e->name, sizeof(e->name));
+        e->first_seen = now;
+        e->last_seen = now;
+        e->messages = 0;
+        reg->slots[s] = ++reg->num_devices;
+    }
+
+    DeviceEntry* e = &reg->devices[reg->slots[s] - 1];
+    e->last_seen = now;
+    e->messages++;
+    return (int32_t)reg->slots[s] - 1;
+}
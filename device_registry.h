@@ -0,0 +1,50 @@
+#ifndef DEVICE_REGISTRY_H
+#define DEVICE_REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "oregon_parser.h"
+
+// Longest interned device name, including the terminating NUL.
+#define DEVICE_NAME_MAX 32
+
+// Everything known about one device, identified by its OREGON_DEVICE_KEY().
+typedef struct {
+    uint32_t device;
+    char name[DEVICE_NAME_MAX];  // Formatted once, on first sight
+    uint64_t first_seen;         // Timestamps as passed to device_registry_observe()
+    uint64_t last_seen;
+    unsigned long messages;
+} DeviceEntry;
+
+// Devices seen so far, each with a small dense id in order of first sight.
+// Lookup is an open-addressing hash table over the device key that stores
+// ids, so finding a known device is O(1) and never formats its name again.
+// Not thread-safe; use one registry per thread.
+typedef struct {
+    DeviceEntry* devices;        // Indexed by id
+    uint32_t num_devices;
+    uint32_t cap_devices;
+    uint32_t* slots;             // id + 1 per slot, 0 marks an empty slot
+    uint32_t num_slots;          // Power of two, at least twice num_devices
+} DeviceRegistry;
+
+// Sizes the registry for `expected` devices; it grows beyond that as needed.
+// Returns 0 on success, -1 if allocation fails.
+int device_registry_init(DeviceRegistry* reg, uint32_t expected);
+void device_registry_free(DeviceRegistry* reg);
+
+// Returns the id of a device, or -1 if it has not been seen.
+int32_t device_registry_find(const DeviceRegistry* reg, uint32_t device);
+
+// Records a message from a device at time `now`, registering it first if it
+// is new. Returns its id, or -1 if a new device could not be allocated.
+int32_t device_registry_observe(DeviceRegistry* reg, uint32_t device, uint64_t now);
+
+// Entry of an id returned above. Only valid until the next observe call,
+// which may move the entries when the registry grows.
+static inline const DeviceEntry* device_registry_get(const DeviceRegistry* reg, int32_t id) {
+    return &reg->devices[id];
+}
+
+#endif // DEVICE_REGISTRY_H
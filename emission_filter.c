@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <string.h>
+#include "emission_filter.h"
+
+int emission_filter_init(EmissionFilter* filter, uint32_t max_devices, uint64_t heartbeat_ms) {
+    memset(filter, 0, sizeof(*filter));
+    if (max_devices == 0) {
+        return -1;
+    }
+    filter->series = calloc((size_t)max_devices * OREGON_READING_TYPE_COUNT, sizeof(EmissionSeries));
+    if (!filter->series) {
+        return -1;
+    }
+    filter->max_devices = max_devices;
+    filter->heartbeat_ms = heartbeat_ms;
+    return 0;
+}
+
+void emission_filter_free(EmissionFilter* filter) {
+    free(filter->series);
+    memset(filter, 0, sizeof(*filter));
+}
+
+bool emission_filter_parse_deadbands(const char* spec, int32_t* out) {
+    int32_t deadband[OREGON_READING_TYPE_COUNT];
+    memcpy(deadband, out, sizeof(deadband));
+
+    const char* p = spec;
+    while (*p) {
+        size_t len = strcspn(p, "=");
+        if (p[len] != '=') {
+            return false;
+        }
+        int type = 0;
+        while (type < OREGON_READING_TYPE_COUNT &&
+               (strlen(oregon_reading_type_str((OregonReadingType)type)) != len ||
+                strncmp(p, oregon_reading_type_str((OregonReadingType)type), len) != 0)) {
+            type++;
+        }
+        if (type == OREGON_READING_TYPE_COUNT) {
+            return false;
+        }
+
+        char* end;
+        double value = strtod(p + len + 1, &end);
+        if (end == p + len + 1 || (*end != ',' && *end != '\0') || !(value >= 0.0) ||
+            value * OREGON_VALUE_SCALE > INT32_MAX) {
+            return false;
+        }
+        deadband[type] = (int32_t)(value * OREGON_VALUE_SCALE + 0.5);
+        p = *end == ',' ? end + 1 : end;
+    }
+
+    memcpy(out, deadband, sizeof(deadband));
+    return true;
+}
+
+int emission_filter_apply(EmissionFilter* filter, int32_t id, uint64_t now, const OregonReading* readings,
+                          int count, OregonReading* out) {
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        const OregonReading* r = &readings[i];
+        if (id < 0 || (uint32_t)id >= filter->max_devices || r->type >= OREGON_READING_TYPE_COUNT) {
+            filter->untracked++;
+            out[kept++] = *r;
+            continue;
+        }
+
+        EmissionSeries* s = &filter->series[(size_t)id * OREGON_READING_TYPE_COUNT + r->type];
+        bool pass = !s->seen || r->state != s->state || r->forecast != s->forecast;
+        if (!pass && r->unit != OREGON_UNIT_NONE && r->value != s->value) {
+            int64_t delta = (int64_t)r->value - s->value;
+            pass = llabs(delta) >= filter->deadband[r->type];
+        }
+        if (!pass && filter->heartbeat_ms > 0 && now - s->time_ms >= filter->heartbeat_ms) {
+            pass = true;
+            filter->heartbeats++;
+        }
+        if (!pass) {
+            filter->suppressed++;
+            continue;
+        }
+
+        *s = (EmissionSeries){now, r->value, r->state, r->forecast, 1, 0};
+        filter->passed++;
+        out[kept++] = *r;
+    }
+    return kept;
+}
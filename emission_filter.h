@@ -0,0 +1,59 @@
+#ifndef EMISSION_FILTER_H
+#define EMISSION_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "oregon_parser.h"
+
+// What was last emitted for one reading type of one device.
+typedef struct {
+    uint64_t time_ms;           // When it was emitted
+    int32_t value;
+    uint8_t state;
+    uint8_t forecast;
+    uint8_t seen;               // 0 until the first emission
+    uint8_t reserved;
+} EmissionSeries;
+
+// Change-driven emission: passes a reading on only if it differs from the
+// last one emitted for its device and type. A value must move by at least
+// the type's deadband (any change with a deadband of 0); a new state or
+// forecast (e.g. battery ok -> low) always passes. A reading that has not
+// passed for the heartbeat interval passes anyway, so quiet series still
+// show up downstream. Comparing with the last emitted value rather than the
+// last seen one keeps slow drift from hiding under the deadband.
+// Devices are identified by their DeviceRegistry id. The table is sized at
+// init and indexed directly by id and type, so every check is O(1) and
+// never allocates; readings of ids past max_devices always pass and are
+// counted in `untracked`.
+// Not thread-safe; use one filter per thread.
+typedef struct {
+    uint32_t max_devices;
+    uint64_t heartbeat_ms;      // 0 disables heartbeats
+    int32_t deadband[OREGON_READING_TYPE_COUNT];    // In 1/OREGON_VALUE_SCALE units
+    EmissionSeries* series;     // max_devices * OREGON_READING_TYPE_COUNT
+    unsigned long passed;       // Including heartbeats
+    unsigned long heartbeats;
+    unsigned long suppressed;
+    unsigned long untracked;
+} EmissionFilter;
+
+// Allocates the table once, up front, with every deadband 0. Returns 0 on
+// success, -1 on bad arguments or allocation failure.
+int emission_filter_init(EmissionFilter* filter, uint32_t max_devices, uint64_t heartbeat_ms);
+void emission_filter_free(EmissionFilter* filter);
+
+// Reads deadbands from a list such as "temperature=0.1,humidity=1", in the
+// readings' units, into an array for EmissionFilter.deadband; types not
+// listed keep their entry. Returns false, leaving the array as it was, on an
+// unknown type or a bad value.
+bool emission_filter_parse_deadbands(const char* spec, int32_t* deadband);
+
+// Filters the readings of one message from device `id`, received at time
+// `now`, into out (room for count readings). Returns how many passed; 0
+// means the message need not be emitted at all.
+int emission_filter_apply(EmissionFilter* filter, int32_t id, uint64_t now, const OregonReading* readings,
+                          int count, OregonReading* out);
+
+#endif // EMISSION_FILTER_H
@@ -0,0 +1,530 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <termios.h>
+
+#include "cul_preprocessor.h"
+#include "oregon_parser.h"
+
+// Generates synthetic CUL traffic for load tests: the lines a CUL stick
+// would report for a population of simulated Oregon devices, optionally
+// mixed with noise, truncated preambles and duplicates, written to stdout,
+// a file, a FIFO or a pseudo-terminal at a given rate.
+
+#define DEFAULT_COUNT    1000000
+#define DEFAULT_DEVICES  4
+#define OUTPUT_BUFFER    (256 * 1024)
+#define MAX_SENSORS      64
+#define MAX_DEVICES      65536
+// Attempts to find V3 values whose line does not also read as V2
+#define V3_ATTEMPTS      8
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// ==========================================================================
+// RANDOM NUMBERS
+// ==========================================================================
+
+// xorshift64*: fast, and reproducible from --seed
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+// Uniform in [0, n)
+static uint32_t rng_below(uint32_t n) {
+    return (uint32_t)(((rng_next() >> 32) * n) >> 32);
+}
+
+static int32_t rng_between(int32_t lo, int32_t hi) {
+    return lo + (int32_t)rng_below((uint32_t)(hi - lo + 1));
+}
+
+static bool rng_chance(double p) {
+    return p > 0 && (double)(rng_next() >> 11) * 0x1.0p-53 < p;
+}
+
+// ==========================================================================
+// SIMULATED DEVICES
+// ==========================================================================
+
+// Range of each reading type's random walk and its largest step per
+// message, in value units; 0..0 for the types that only carry a state.
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int32_t step;
+} Walk;
+
+static const Walk WALKS[OREGON_READING_TYPE_COUNT] = {
+    [OREGON_READING_TEMPERATURE]    = {-2000, 4000, 20},
+    [OREGON_READING_HUMIDITY]       = {1000, 9900, 100},
+    [OREGON_READING_PRESSURE]       = {95000, 105000, 100},
+    [OREGON_READING_BATTERY_LEVEL]  = {0, 10000, 1000},
+    [OREGON_READING_WIND_SPEED]     = {0, 3000, 50},
+    [OREGON_READING_WIND_AVERAGE]   = {0, 2000, 30},
+    [OREGON_READING_WIND_DIRECTION] = {0, 33750, 2250},
+    [OREGON_READING_RAIN_RATE]      = {0, 5000, 100},
+    [OREGON_READING_RAIN_TOTAL]     = {0, 999900, 100},
+    [OREGON_READING_UV]             = {0, 1100, 100},
+};
+
+static const uint8_t FORECASTS[] = {
+    OREGON_FORECAST_SUNNY, OREGON_FORECAST_PARTLY, OREGON_FORECAST_CLOUDY, OREGON_FORECAST_RAIN,
+};
+
+// One reading of every type; the encoder picks the ones its sensor sends.
+typedef struct {
+    uint32_t device;
+    uint8_t version;
+    OregonReading readings[OREGON_READING_TYPE_COUNT];
+} SimDevice;
+
+static void device_init(SimDevice* d, uint32_t device, uint8_t version) {
+    d->device = device;
+    d->version = version;
+    for (int t = 0; t < OREGON_READING_TYPE_COUNT; t++) {
+        OregonReading* r = &d->readings[t];
+        r->device = device;
+        r->type = (uint8_t)t;
+        r->value = rng_between(WALKS[t].min, WALKS[t].max);
+        r->unit = OREGON_UNIT_NONE;
+        r->state = OREGON_STATE_NONE;
+        r->forecast = OREGON_FORECAST_NONE;
+    }
+    d->readings[OREGON_READING_BATTERY].state =
+        rng_below(32) ? OREGON_STATE_BATTERY_OK : OREGON_STATE_BATTERY_LOW;
+    d->readings[OREGON_READING_PRESSURE].forecast = FORECASTS[rng_below(sizeof(FORECASTS))];
+}
+
+// Moves every value one random step and derives the comfort level.
+static void device_step(SimDevice* d) {
+    for (int t = 0; t < OREGON_READING_TYPE_COUNT; t++) {
+        const Walk* w = &WALKS[t];
+        if (w->step) {
+            int32_t v = d->readings[t].value + rng_between(-w->step, w->step);
+            d->readings[t].value = v < w->min ? w->min : v > w->max ? w->max : v;
+        }
+    }
+    if (!rng_below(64)) {
+        d->readings[OREGON_READING_PRESSURE].forecast = FORECASTS[rng_below(sizeof(FORECASTS))];
+    }
+    int32_t humidity = d->readings[OREGON_READING_HUMIDITY].value;
+    d->readings[OREGON_READING_HUMIDITY].state = humidity < 4000 ? OREGON_STATE_DRY
+                                               : humidity > 7000 ? OREGON_STATE_WET
+                                               : OREGON_STATE_COMFORTABLE;
+}
+
+// ==========================================================================
+// OUTPUT
+// ==========================================================================
+
+typedef struct {
+    int fd;
+    size_t len;
+    bool closed;            // The reader went away or a write failed
+    char buf[OUTPUT_BUFFER];
+} Output;
+
+static void output_flush(Output* out) {
+    size_t done = 0;
+    while (done < out->len && !out->closed) {
+        ssize_t n = write(out->fd, out->buf + done, out->len - done);
+        if (n > 0) {
+            done += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            // A reader that stopped reading blocks the write; give up on a signal
+            out->closed = stop_requested;
+        } else if (n < 0) {
+            if (errno != EPIPE && errno != EIO) {
+                perror("Error: write");
+            }
+            out->closed = true;
+        }
+    }
+    out->len = 0;
+}
+
+static void output_line(Output* out, const char* line, size_t len) {
+    if (out->len + len + 1 > sizeof(out->buf)) {
+        output_flush(out);
+    }
+    memcpy(out->buf + out->len, line, len);
+    out->buf[out->len + len] = '\n';
+    out->len += len + 1;
+}
+
+// Creates a pseudo-terminal in raw mode and prints the path readers open.
+// The slave side is kept open as well, so that lines written before a
+// reader arrives wait in the terminal's buffer.
+static int open_pty(int* slave) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        return -1;
+    }
+    const char* path = ptsname(master);
+    *slave = path ? open(path, O_RDWR | O_NOCTTY) : -1;
+    struct termios tio;
+    if (*slave < 0 || tcgetattr(*slave, &tio) != 0) {
+        close(master);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(*slave, TCSANOW, &tio);
+    fprintf(stderr, "Writing to %s\n", path);
+    return master;
+}
+
+// ==========================================================================
+// GENERATION
+// ==========================================================================
+
+typedef struct {
+    unsigned long lines;
+    unsigned long frames;
+    unsigned long noise;
+    unsigned long truncated;
+    unsigned long duplicates;
+    unsigned long v3_as_v2;     // V3 devices that had to fall back to V2
+    unsigned long verified;
+    unsigned long mismatches;
+} GenStats;
+
+typedef struct {
+    unsigned long count;        // 0 for no limit
+    double rate;                // Lines per second, 0 for no limit
+    double noise;
+    double truncate;
+    double duplicates;
+    bool verify;
+} GenOptions;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !stop_requested) {
+    }
+}
+
+// A random hex line of typical length that is not a frame.
+static size_t noise_line(char* line) {
+    static const char HEX[] = "0123456789ABCDEF";
+    size_t len = 2 + 8 + rng_below(48);
+    line[0] = 'o';
+    line[1] = 'm';
+    for (size_t i = 2; i < len; i++) {
+        line[i] = HEX[rng_below(16)];
+    }
+    line[len] = '\0';
+    return len;
+}
+
+// Encodes the device's next message. Returns false if it has no valid line.
+static bool frame_line(SimDevice* d, GenStats* stats, OregonFrame* frame, char* line) {
+    for (int attempt = 0; attempt < V3_ATTEMPTS; attempt++) {
+        device_step(d);
+        if (oregon_encode_frame(d->device, d->readings, OREGON_READING_TYPE_COUNT, frame) != OREGON_OK) {
+            return false;
+        }
+        frame->version = d->version;
+        frame->rssi = (uint8_t)rng_below(256);
+        OregonStatus status = cul_encode_frame(frame, line, CUL_HEX_OUTPUT_SIZE);
+        if (status == OREGON_OK) {
+            return true;
+        }
+        if (status != OREGON_ERR_NO_PREAMBLE || d->version != 3) {
+            return false;
+        }
+    }
+    // The V2 preamble keeps turning up, typically in the type id or rolling
+    // code (e.g. WTGR800_A's 0x1a99), so the device switches to V2 for good
+    stats->v3_as_v2++;
+    d->version = 2;
+    frame->version = 2;
+    return cul_encode_frame(frame, line, CUL_HEX_OUTPUT_SIZE) == OREGON_OK;
+}
+
+// Decodes a generated line again and checks that it names the device and
+// that its readings encode back to the same payload.
+static void verify_line(const SimDevice* d, const OregonFrame* frame, const char* line, GenStats* stats) {
+    OregonReading readings[OREGON_MAX_READINGS];
+    int count = 0;
+    OregonStatus status = oregon_decode_cul(line, NULL, readings, OREGON_MAX_READINGS, &count);
+    OregonFrame again;
+    bool ok = status == OREGON_OK && count > 0 && readings[0].device == d->device &&
+              oregon_encode_frame(d->device, readings, count, &again) == OREGON_OK &&
+              memcmp(again.data, frame->data, ((size_t)frame->bits + 7) / 8) == 0;
+    stats->verified++;
+    if (!ok && stats->mismatches++ < 10) {
+        fprintf(stderr, "Mismatch: %s (%s)\n", line, oregon_status_str(status));
+    }
+}
+
+static void generate(Output* out, SimDevice* devices, size_t num_devices, const GenOptions* opt,
+                     GenStats* stats) {
+    char line[CUL_HEX_OUTPUT_SIZE];
+    OregonFrame frame;
+
+    // With a rate, lines go out in ticks of about a millisecond, each
+    // followed by a flush so that readers see them on time
+    unsigned long per_tick = 0;
+    uint64_t tick_ns = 0;
+    if (opt->rate > 0) {
+        per_tick = opt->rate >= 1000 ? (unsigned long)(opt->rate / 1000) : 1;
+        tick_ns = (uint64_t)(per_tick * 1e9 / opt->rate);
+    }
+    uint64_t next_tick = now_ns();
+    unsigned long in_tick = 0;
+
+    while (!stop_requested && !out->closed && (!opt->count || stats->lines < opt->count)) {
+        if (per_tick && in_tick == per_tick) {
+            output_flush(out);
+            next_tick += tick_ns;
+            sleep_until(next_tick);
+            in_tick = 0;
+        }
+
+        if (rng_chance(opt->noise)) {
+            output_line(out, line, noise_line(line));
+            stats->noise++;
+        } else {
+            SimDevice* d = &devices[rng_below((uint32_t)num_devices)];
+            if (!frame_line(d, stats, &frame, line)) {
+                continue;
+            }
+            size_t len = strlen(line);
+            if (rng_chance(opt->truncate)) {
+                // Starts 5 to 7 hex digits in: past the lead-in, into the preamble
+                size_t cut = 5 + rng_below(3);
+                memmove(line + 2, line + 2 + cut, len - 2 - cut + 1);
+                output_line(out, line, len - cut);
+                stats->truncated++;
+            } else {
+                output_line(out, line, len);
+                stats->frames++;
+                if (opt->verify) {
+                    verify_line(d, &frame, line, stats);
+                }
+                if (rng_chance(opt->duplicates) && (!opt->count || stats->lines + 1 < opt->count)) {
+                    output_line(out, line, len);
+                    stats->duplicates++;
+                    stats->lines++;
+                    in_tick++;
+                }
+            }
+        }
+        stats->lines++;
+        in_tick++;
+    }
+    output_flush(out);
+}
+
+// ==========================================================================
+// MAIN
+// ==========================================================================
+
+// Parses a comma-separated list of part names into sensor indexes.
+static int parse_sensors(const char* list, unsigned* sensors) {
+    int count = 0;
+    char* copy = strdup(list);
+    for (char* name = strtok(copy, ","); name; name = strtok(NULL, ",")) {
+        unsigned s = 0;
+        while (oregon_sensor_name(s) && strcasecmp(oregon_sensor_name(s), name) != 0) {
+            s++;
+        }
+        if (!oregon_sensor_name(s) || count == MAX_SENSORS) {
+            fprintf(stderr, "Error: Unknown sensor %s\n", name);
+            free(copy);
+            return -1;
+        }
+        sensors[count++] = s;
+    }
+    free(copy);
+    return count;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--count N] [--rate N] [--output PATH | --pty] [--sensors LIST]\n"
+                    "          [--devices N] [--protocol 2|3|mixed] [--noise P] [--truncate P]\n"
+                    "          [--duplicates P] [--seed N] [--verify]\n", prog);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -n, --count N    Lines to write, 0 for no limit (default: %d)\n", DEFAULT_COUNT);
+    fprintf(stderr, "  -r, --rate N     Lines per second (default: as fast as possible)\n");
+    fprintf(stderr, "  -o, --output PATH  File or FIFO to write to (default: stdout)\n");
+    fprintf(stderr, "  -p, --pty        Write to a new pseudo-terminal, e.g. for\n");
+    fprintf(stderr, "                   oregon_parser --stream /dev/pts/N\n");
+    fprintf(stderr, "  -s, --sensors LIST  Comma-separated part names, e.g. THGR810,WGR800\n");
+    fprintf(stderr, "                   (default: every known sensor)\n");
+    fprintf(stderr, "  -d, --devices N  Simulated devices per sensor (default: %d)\n", DEFAULT_DEVICES);
+    fprintf(stderr, "  -V, --protocol V  Oregon protocol: 2 (default), 3 or mixed (per device)\n");
+    fprintf(stderr, "  -N, --noise P    Fraction of lines that are random hex instead of a frame\n");
+    fprintf(stderr, "  -t, --truncate P  Fraction of frames sent without the start of their preamble\n");
+    fprintf(stderr, "  -D, --duplicates P  Fraction of frames sent twice in a row\n");
+    fprintf(stderr, "  -S, --seed N     Seed for reproducible output\n");
+    fprintf(stderr, "  -c, --verify     Decode every frame again and check it; exit 1 on a mismatch\n");
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option options[] = {
+        {"count",      required_argument, NULL, 'n'},
+        {"rate",       required_argument, NULL, 'r'},
+        {"output",     required_argument, NULL, 'o'},
+        {"pty",        no_argument,       NULL, 'p'},
+        {"sensors",    required_argument, NULL, 's'},
+        {"devices",    required_argument, NULL, 'd'},
+        {"protocol",   required_argument, NULL, 'V'},
+        {"noise",      required_argument, NULL, 'N'},
+        {"truncate",   required_argument, NULL, 't'},
+        {"duplicates", required_argument, NULL, 'D'},
+        {"seed",       required_argument, NULL, 'S'},
+        {"verify",     no_argument,       NULL, 'c'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    GenOptions opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.count = DEFAULT_COUNT;
+    const char* path = NULL;
+    bool pty = false;
+    unsigned sensors[MAX_SENSORS];
+    int num_sensors = 0;
+    long devices_per_sensor = DEFAULT_DEVICES;
+    int protocol = 2;   // 0 for mixed
+
+    int c;
+    while ((c = getopt_long(argc, argv, "n:r:o:ps:d:V:N:t:D:S:ch", options, NULL)) != -1) {
+        switch (c) {
+            case 'n': opt.count = strtoul(optarg, NULL, 10); break;
+            case 'r': opt.rate = atof(optarg); break;
+            case 'o': path = optarg; break;
+            case 'p': pty = true; break;
+            case 's':
+                num_sensors = parse_sensors(optarg, sensors);
+                if (num_sensors < 0) {
+                    return 1;
+                }
+                break;
+            case 'd': devices_per_sensor = atol(optarg); break;
+            case 'V':
+                if (strcmp(optarg, "mixed") == 0) {
+                    protocol = 0;
+                } else {
+                    protocol = atoi(optarg);
+                    if (protocol != 2 && protocol != 3) {
+                        fprintf(stderr, "Error: Unknown protocol %s\n", optarg);
+                        return 1;
+                    }
+                }
+                break;
+            case 'N': opt.noise = atof(optarg); break;
+            case 't': opt.truncate = atof(optarg); break;
+            case 'D': opt.duplicates = atof(optarg); break;
+            case 'S': rng_state = strtoull(optarg, NULL, 0) * 0x9E3779B97F4A7C15ull | 1; break;
+            case 'c': opt.verify = true; break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc || devices_per_sensor < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (num_sensors == 0) {
+        while (oregon_sensor_name((unsigned)num_sensors) && num_sensors < MAX_SENSORS) {
+            sensors[num_sensors] = (unsigned)num_sensors;
+            num_sensors++;
+        }
+    }
+    size_t num_devices = (size_t)num_sensors * (size_t)devices_per_sensor;
+    if (num_devices > MAX_DEVICES) {
+        fprintf(stderr, "Error: At most %d devices\n", MAX_DEVICES);
+        return 1;
+    }
+    SimDevice* devices = malloc(num_devices * sizeof(SimDevice));
+    Output* out = malloc(sizeof(Output));
+    if (!devices || !out) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < num_devices; i++) {
+        unsigned sensor = sensors[i % (size_t)num_sensors];
+        uint32_t key = OREGON_DEVICE_KEY(sensor, rng_below(256), 1 + rng_below(3));
+        uint8_t version = protocol ? (uint8_t)protocol : (uint8_t)(2 + rng_below(2));
+        device_init(&devices[i], key, version);
+    }
+
+    int slave = -1;
+    out->len = 0;
+    out->closed = false;
+    out->fd = STDOUT_FILENO;
+    if (pty) {
+        out->fd = open_pty(&slave);
+    } else if (path) {
+        out->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (out->fd < 0) {
+        fprintf(stderr, "Error: Could not open %s: %s\n", pty ? "a pseudo-terminal" : path, strerror(errno));
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    GenStats stats;
+    memset(&stats, 0, sizeof(stats));
+    uint64_t start = now_ns();
+    generate(out, devices, num_devices, &opt, &stats);
+    double seconds = (double)(now_ns() - start) / 1e9;
+
+    fprintf(stderr, "Wrote %lu lines in %.2f s (%.0f lines/s): %lu frames, %lu noise, %lu truncated, "
+                    "%lu duplicates\n",
+            stats.lines, seconds, seconds > 0 ? stats.lines / seconds : 0.0, stats.frames, stats.noise,
+            stats.truncated, stats.duplicates);
+    if (stats.v3_as_v2) {
+        fprintf(stderr, "%lu V3 devices sent V2 instead, their frames kept containing the V2 preamble\n",
+                stats.v3_as_v2);
+    }
+    if (opt.verify) {
+        fprintf(stderr, "Verified %lu frames: %lu mismatches\n", stats.verified, stats.mismatches);
+    }
+
+    if (out->fd != STDOUT_FILENO) {
+        close(out->fd);
+    }
+    if (slave >= 0) {
+        close(slave);
+    }
+    free(out);
+    free(devices);
+    return stats.mismatches ? 1 : 0;
+}
@@ -0,0 +1,167 @@
+#include "hex_pack.h"
+
+// SSE2 is part of the x86-64 baseline; AVX2 is compiled per function.
+// The Makefile builds this file with -O2 even in debug builds, as the
+// intrinsics at -O0 are several times slower than the table lookup.
+#if defined(__x86_64__)
+#define HEX_PACK_X86 1
+#include <immintrin.h>
+#endif
+
+// ==========================================================================
+// SCALAR
+// ==========================================================================
+
+// Maps an ASCII character to HEX_VALID | nibble value, or 0 if it is not hex.
+#define HEX_VALID 0x10
+static const uint8_t HEX_VALUE[256] = {
+    ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+    ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+    ['a'] = 0x1A, ['b'] = 0x1B, ['c'] = 0x1C, ['d'] = 0x1D, ['e'] = 0x1E, ['f'] = 0x1F,
+    ['A'] = 0x1A, ['B'] = 0x1B, ['C'] = 0x1C, ['D'] = 0x1D, ['E'] = 0x1E, ['F'] = 0x1F,
+};
+
+// Packs hex[start..len) into out[start / 2..]; start must be even.
+static size_t pack_tail(const char* hex, size_t start, size_t len, uint8_t* out) {
+    size_t i = start;
+    for (; i + 1 < len; i += 2) {
+        uint8_t hi = HEX_VALUE[(unsigned char)hex[i]];
+        uint8_t lo = HEX_VALUE[(unsigned char)hex[i + 1]];
+        if (!(hi & lo & HEX_VALID)) {
+            return (hi & HEX_VALID) ? i + 1 : i;
+        }
+        out[i / 2] = (uint8_t)((hi << 4) | (lo & 0x0F));
+    }
+    if (i < len) {
+        uint8_t hi = HEX_VALUE[(unsigned char)hex[i]];
+        if (!(hi & HEX_VALID)) {
+            return i;
+        }
+        out[i / 2] = (uint8_t)(hi << 4);
+    }
+    return len;
+}
+
+size_t hex_pack_scalar(const char* hex, size_t len, uint8_t* out) {
+    return pack_tail(hex, 0, len, out);
+}
+
+// ==========================================================================
+// SSE2 / AVX2
+// ==========================================================================
+
+#ifdef HEX_PACK_X86
+
+// Validates and packs 16 characters into 8 bytes. Returns a mask of the
+// characters that are not hex. Setting bit 5 folds 'A'-'F' onto 'a'-'f' and
+// leaves digits alone; bytes >= 0x80 compare as negative and so fail both
+// range checks. A nibble is then (c & 0xF) plus 9 for letters.
+// Always inlined, so that inside the AVX2 kernel it is VEX-encoded too and
+// no SSE/AVX transition penalty is paid.
+static inline __attribute__((always_inline)) unsigned pack16(const char* hex, uint8_t* out) {
+    __m128i c = _mm_loadu_si128((const __m128i*)hex);
+    __m128i lc = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), lc));
+    unsigned bad = ~(unsigned)_mm_movemask_epi8(_mm_or_si128(digit, alpha)) & 0xFFFF;
+    if (bad) {
+        return bad;
+    }
+
+    // Each 16-bit lane holds an (even, odd) character pair as (hi, lo)
+    __m128i v = _mm_add_epi8(_mm_and_si128(c, _mm_set1_epi8(0x0F)),
+                             _mm_and_si128(alpha, _mm_set1_epi8(9)));
+    __m128i pairs = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 4), _mm_set1_epi16(0x00F0)),
+                                 _mm_srli_epi16(v, 8));
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(pairs, pairs));
+    return 0;
+}
+
+static size_t hex_pack_sse2(const char* hex, size_t len, uint8_t* out) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        unsigned bad = pack16(hex + i, out + i / 2);
+        if (bad) {
+            return i + (size_t)__builtin_ctz(bad);
+        }
+    }
+    return pack_tail(hex, i, len, out);
+}
+
+__attribute__((target("avx2")))
+static size_t hex_pack_avx2(const char* hex, size_t len, uint8_t* out) {
+    const __m256i digit_lo = _mm256_set1_epi8('0' - 1);
+    const __m256i digit_hi = _mm256_set1_epi8('9' + 1);
+    const __m256i alpha_lo = _mm256_set1_epi8('a' - 1);
+    const __m256i alpha_hi = _mm256_set1_epi8('f' + 1);
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    const __m256i alpha_add = _mm256_set1_epi8(9);
+    const __m256i hi_mask = _mm256_set1_epi16(0x00F0);
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(hex + i));
+        __m256i lc = _mm256_or_si256(c, case_bit);
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, digit_lo), _mm256_cmpgt_epi8(digit_hi, c));
+        __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lc, alpha_lo), _mm256_cmpgt_epi8(alpha_hi, lc));
+        uint32_t bad = ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(digit, alpha));
+        if (bad) {
+            return i + (size_t)__builtin_ctz(bad);
+        }
+
+        __m256i v = _mm256_add_epi8(_mm256_and_si256(c, low_nibble), _mm256_and_si256(alpha, alpha_add));
+        __m256i pairs = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(v, 4), hi_mask),
+                                        _mm256_srli_epi16(v, 8));
+        // packus works per 128-bit lane; gather the two 8-byte halves
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(pairs, pairs), 0x08);
+        _mm_storeu_si128((__m128i*)(out + i / 2), _mm256_castsi256_si128(packed));
+    }
+    if (i + 16 <= len) {
+        unsigned bad = pack16(hex + i, out + i / 2);
+        if (bad) {
+            return i + (size_t)__builtin_ctz(bad);
+        }
+        i += 16;
+    }
+    // GCC turns this into a tail call without the vzeroupper it puts before
+    // a return; dirty upper halves would slow every later SSE instruction.
+    _mm256_zeroupper();
+    return pack_tail(hex, i, len, out);
+}
+
+#endif // HEX_PACK_X86
+
+// ==========================================================================
+// DISPATCH
+// ==========================================================================
+
+typedef size_t (*hex_pack_func_t)(const char* hex, size_t len, uint8_t* out);
+
+static hex_pack_func_t hex_pack_best = hex_pack_scalar;
+static const char* hex_pack_best_name = "scalar";
+
+// Runs before main(), so worker threads only ever read the selection.
+__attribute__((constructor))
+static void hex_pack_select(void) {
+#ifdef HEX_PACK_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        hex_pack_best = hex_pack_avx2;
+        hex_pack_best_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        hex_pack_best = hex_pack_sse2;
+        hex_pack_best_name = "sse2";
+    }
+#endif
+}
+
+size_t hex_pack(const char* hex, size_t len, uint8_t* out) {
+    return hex_pack_best(hex, len, out);
+}
+
+const char* hex_pack_impl(void) {
+    return hex_pack_best_name;
+}
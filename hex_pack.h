@@ -0,0 +1,21 @@
+#ifndef HEX_PACK_H
+#define HEX_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Validates len hex characters (either case) and packs them two per byte,
+// high nibble first, into out, which must hold (len + 1) / 2 bytes. An odd
+// trailing character lands in the high nibble of the last byte.
+// Returns len if every character is a hex digit, otherwise the offset of the
+// first one that is not; out is unspecified in that case.
+// Uses AVX2 or SSE2 when the CPU has them, picked once at startup.
+size_t hex_pack(const char* hex, size_t len, uint8_t* out);
+
+// Portable implementation with the same contract, for reference and benchmarks.
+size_t hex_pack_scalar(const char* hex, size_t len, uint8_t* out);
+
+// Name of the implementation hex_pack() dispatches to: "avx2", "sse2" or "scalar".
+const char* hex_pack_impl(void);
+
+#endif // HEX_PACK_H
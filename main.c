@@ -1,35 +1,795 @@
 #include <stdio.h>
-#include <stdlib.h> // For free()
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include "cul_preprocessor.h" // Our new pre-processor
 #include "oregon_parser.h"    // Our original parser
+#include "cul_stream.h"
+#include "batch_decode.h"
+#include "decode_cache.h"
+#include "device_registry.h"
+#include "aggregate_store.h"
+#include "aggregate_report.h"
+#include "output_sink.h"
+#include "cul_mux.h"
+#include "pipeline.h"
+#include "reading_archive.h"
+#include "emission_filter.h"
+#include "oregon_stats.h"
 
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <raw_cul_message>\n", argv[0]);
-        fprintf(stderr, "Example: %s omAAAAAAAB32D4CB3554D54CAB5554B53554B54D4D555414\n", argv[0]);
-        return 1;
+#define STREAM_READ_SIZE   4096
+#define STREAM_OUTPUT_SIZE (64 * 1024)
+#define DEFAULT_BAUD       38400
+#define DEFAULT_CACHE_TTL  300
+#define EXPECTED_DEVICES   64
+#define DEFAULT_EWMA_ALPHA 0.1
+#define DEFAULT_DEDUPE_MS  200
+#define DEFAULT_QUEUE_DEPTH 1024
+#define AGGREGATE_MAX_DEVICES 256
+#define AGGREGATE_MAX_SERIES  1024
+#define ARCHIVE_SYNC_MS    1000
+#define DEFAULT_HEARTBEAT  300
+#define FILTER_MAX_DEVICES 256
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// ==========================================================================
+// DECODER STATISTICS
+// ==========================================================================
+
+static volatile sig_atomic_t stats_requested = 0;
+
+static void on_stats_signal(int sig) {
+    (void)sig;
+    stats_requested = 1;
+}
+
+static uint64_t clock_ms(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+// Prints the merged decoder counters as one JSON line on stderr.
+static void dump_stats(void) {
+    OregonStatsSnapshot snap;
+    oregon_stats_snapshot(&snap);
+    oregon_stats_write_json(stderr, &snap, clock_ms(CLOCK_REALTIME));
+    fflush(stderr);
+}
+
+// Dumps on SIGUSR1, and every `interval_s` seconds if non-zero. The handlers
+// only set a flag; the reading loop does the dump, and since they are
+// installed without SA_RESTART a blocking read returns early to do it.
+static void install_stats_signals(unsigned interval_s) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stats_signal;
+    sigaction(SIGUSR1, &sa, NULL);
+    if (interval_s > 0) {
+        sigaction(SIGALRM, &sa, NULL);
+        struct itimerval it = {{interval_s, 0}, {interval_s, 0}};
+        setitimer(ITIMER_REAL, &it, NULL);
     }
+}
 
+static void service_stats(void) {
+    if (stats_requested) {
+        stats_requested = 0;
+        dump_stats();
+    }
+}
+
+// Decodes a single message given on the command line and prints every stage.
+static int run_single(const char* cul_msg) {
     printf("--- Stage 1: Pre-processing CUL Message ---\n");
-    printf("Raw Input: %s\n", argv[1]);
+    printf("Raw Input: %s\n", cul_msg);
 
     // Step 1: Call the pre-processor to decode the Manchester stream
-    char* oregon_hex_string = preprocess_cul_message(argv[1]);
+    OregonFrame frame;
+    OregonStatus status = cul_preprocess_frame(cul_msg, &frame);
 
-    if (!oregon_hex_string) {
+    if (status != OREGON_OK) {
+        print_preprocess_error(status);
         fprintf(stderr, "Failed to decode CUL message. It's not a recognized Oregon V2 or V3 protocol.\n");
         return 1;
     }
 
+    char oregon_hex_string[CUL_HEX_OUTPUT_SIZE];
+    cul_frame_to_hex(&frame, oregon_hex_string, sizeof(oregon_hex_string));
     printf("Preprocessor Output: %s\n\n", oregon_hex_string);
 
     printf("--- Stage 2: Parsing Oregon Data ---\n");
-    
-    // Step 2: Pass the clean hex string to our original parser
-    parse_oregon_message(oregon_hex_string);
 
-    // IMPORTANT: Free the memory allocated by the pre-processor
-    free(oregon_hex_string);
+    // Step 2: Hand the decoded frame straight to the parser
+    parse_oregon_frame(&frame);
+
+    return 0;
+}
+
+
+// ==========================================================================
+// STREAMING MODE
+// ==========================================================================
+
+typedef struct {
+    bool verbose;
+    OutputSink* out;
+    DecodeCache* cache;          // NULL when caching is disabled
+    DeviceRegistry* devices;     // NULL if the registry could not be allocated
+    AggregateStore* aggregates;  // NULL when aggregation is disabled
+    AggregateReport* report;     // NULL unless aggregates are written to the output
+    bool aggregates_only;        // Write aggregate records instead of readings
+    ReadingArchive* archive;     // NULL when not archiving
+    EmissionFilter* filter;      // NULL when every reading is emitted
+    unsigned long by_status[OREGON_STATUS_COUNT];
+    unsigned long by_protocol[OREGON_VERSION_COUNT];
+} StreamState;
+
+// Decodes one complete CUL line and writes its readings to the output.
+static void handle_line(void* ctx, const char* line, size_t len) {
+    (void)len;
+    StreamState* state = ctx;
+    OregonReading readings[OREGON_MAX_READINGS];
+    int count = 0;
+    OregonMessageInfo info;
+
+    OregonStatus status;
+    if (state->cache) {
+        status = decode_cache_decode_cul(state->cache, line, clock_ms(CLOCK_MONOTONIC), &info,
+                                         readings, OREGON_MAX_READINGS, &count);
+    } else {
+        status = oregon_decode_cul(line, &info, readings, OREGON_MAX_READINGS, &count);
+    }
+    state->by_status[status]++;
+    state->by_protocol[info.protocol]++;
+
+    if (status == OREGON_OK) {
+        uint64_t now = clock_ms(CLOCK_REALTIME);
+        int32_t id = -1;
+        if (state->devices) {
+            uint32_t known = state->devices->num_devices;
+            id = device_registry_observe(state->devices, readings[0].device, now);
+            if (id >= 0 && (uint32_t)id >= known && state->verbose) {
+                fprintf(stderr, "New device %s\n", device_registry_get(state->devices, id)->name);
+            }
+        }
+        if (id >= 0 && state->report) {
+            aggregate_report_add(state->report, id, device_registry_get(state->devices, id)->name, now,
+                                 readings, count);
+        } else if (id >= 0 && state->aggregates) {
+            aggregate_store_add(state->aggregates, id, readings, count);
+        }
+        if (state->archive) {
+            reading_archive_append(state->archive, now, readings, count);
+        }
+        if (state->aggregates_only) {
+            return;
+        }
+
+        OregonReading changed[OREGON_MAX_READINGS];
+        const OregonReading* emit = readings;
+        if (state->filter) {
+            count = emission_filter_apply(state->filter, id, now, readings, count, changed);
+            emit = changed;
+        }
+        if (count == 0) {
+            return;
+        }
+        if (id >= 0) {
+            output_sink_readings(state->out, device_registry_get(state->devices, id)->name, now, emit, count);
+        } else {
+            char name[DEVICE_NAME_MAX];
+            oregon_device_name(readings[0].device, name, sizeof(name));
+            output_sink_readings(state->out, name, now, emit, count);
+        }
+    } else if (state->verbose) {
+        fprintf(stderr, "Dropped %s: %s\n", line, oregon_status_str(status));
+    }
+}
+
+static void print_summary(unsigned long lines, unsigned long overlong, const unsigned long* by_status,
+                          const unsigned long* by_protocol) {
+    fprintf(stderr, "Lines: %lu, overlong: %lu\n", lines, overlong);
+    fprintf(stderr, "Frames: %lu Oregon V2, %lu Oregon V3\n", by_protocol[2], by_protocol[3]);
+    for (int s = 0; s < OREGON_STATUS_COUNT; s++) {
+        if (by_status[s] > 0) {
+            fprintf(stderr, "  %-16s %lu\n", oregon_status_str((OregonStatus)s), by_status[s]);
+        }
+    }
+}
+
+static void format_time(uint64_t ms, char* buf, size_t size) {
+    time_t t = (time_t)(ms / 1000);
+    struct tm tm;
+    strftime(buf, size, "%Y-%m-%d %H:%M:%S", localtime_r(&t, &tm));
+}
+
+// Lists every device that sent a decodable message, in order of first sight.
+static void print_devices(const DeviceRegistry* devices) {
+    fprintf(stderr, "Devices: %u\n", devices->num_devices);
+    for (uint32_t id = 0; id < devices->num_devices; id++) {
+        const DeviceEntry* e = device_registry_get(devices, (int32_t)id);
+        char first[32], last[32];
+        format_time(e->first_seen, first, sizeof(first));
+        format_time(e->last_seen, last, sizeof(last));
+        fprintf(stderr, "  %-20s %8lu msgs, first %s, last %s\n", e->name, e->messages, first, last);
+    }
+}
+
+// Rolling aggregates of every device and reading type with a value.
+static void print_aggregates(const DeviceRegistry* devices, const AggregateStore* aggregates) {
+    fprintf(stderr, "Aggregates over the last %u readings (EWMA alpha %.2f):\n",
+            aggregates->window, aggregates->alpha);
+    for (uint32_t id = 0; id < devices->num_devices; id++) {
+        const DeviceEntry* e = device_registry_get(devices, (int32_t)id);
+        for (int type = 0; type < OREGON_READING_TYPE_COUNT; type++) {
+            AggregateStats st;
+            if (!aggregate_store_get(aggregates, (int32_t)id, (OregonReadingType)type, &st)) {
+                continue;
+            }
+            double scale = OREGON_VALUE_SCALE;
+            fprintf(stderr, "  %-20s %-15s n=%-4u mean %.2f, min %.2f, max %.2f, ewma %.2f\n",
+                    e->name, oregon_reading_type_str((OregonReadingType)type), st.count,
+                    st.mean / scale, st.min / scale, st.max / scale, st.ewma / scale);
+        }
+    }
+    if (aggregates->dropped > 0) {
+        fprintf(stderr, "  %lu readings beyond the store's capacity were not aggregated\n",
+                aggregates->dropped);
+    }
+}
+
+typedef struct {
+    const char* const* sources;  // "-" for stdin
+    int num_sources;
+    int baud;
+    bool verbose;
+    OutputFormat format;
+    size_t cache_size;           // 0 disables the decode cache
+    uint64_t cache_ttl_ms;
+    uint32_t window;             // 0 disables aggregation
+    double alpha;
+    bool report;                 // Write aggregate records to the output
+    uint64_t report_ms;          // ... every this often per device; 0 once per window
+    bool aggregates_only;        // ... instead of the readings
+    uint64_t dedupe_ms;          // Cross-stick duplicate window, multi-source only
+    bool pipeline;               // Decode on stage threads instead of the reader's
+    size_t queue_depth;
+    bool lossless;               // Ingest waits for room even on live sources
+    bool stats;                  // Dump decoder counters at exit
+    unsigned stats_interval;     // ... and every this many seconds; 0 disables
+    const char* archive;         // Archive file to append readings to, or NULL
+    int32_t deadband[OREGON_READING_TYPE_COUNT];
+    bool filter;                 // Emit only readings that changed
+    uint64_t heartbeat_ms;       // ... or were last emitted this long ago; 0 disables
+} StreamOptions;
+
+// Where the readers deliver lines: straight to handle_line, or into the
+// pipeline. on_idle runs whenever the input goes quiet.
+typedef struct {
+    cul_line_cb on_line;
+    void (*on_idle)(void* ctx);
+    void* ctx;
+} LineConsumer;
+
+static void flush_output(void* ctx) {
+    StreamState* state = ctx;
+    output_sink_flush(state->out);
+}
+
+// Reads one source with blocking reads until end of input or a signal.
+// Output is flushed whenever the input goes quiet, so a slow consumer only
+// delays the next read; buffered input is never dropped.
+static int read_single(const char* path, int baud, const LineConsumer* consumer, CulLineReader* reader) {
+    int fd = cul_open_source(path, baud);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    // A FIFO reports end of file whenever its writer goes away; keep serving it.
+    struct stat st;
+    bool reopen_on_eof = strcmp(path, "-") != 0 && fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
 
+    char buf[STREAM_READ_SIZE];
+    int rc = 0;
+    while (!stop_requested) {
+        service_stats();
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Error: Read from %s failed: %s\n", path, strerror(errno));
+            rc = 1;
+            break;
+        }
+        if (n == 0) {
+            cul_line_reader_finish(reader, consumer->on_line, consumer->ctx);
+            consumer->on_idle(consumer->ctx);
+            if (!reopen_on_eof) {
+                break;
+            }
+            close(fd);
+            // Opening blocks until a writer appears; stats signals interrupt it
+            do {
+                service_stats();
+                fd = cul_open_source(path, baud);
+            } while (fd < 0 && errno == EINTR && !stop_requested);
+            if (fd < 0) {
+                if (errno != EINTR) {
+                    fprintf(stderr, "Error: Could not reopen %s: %s\n", path, strerror(errno));
+                    rc = 1;
+                }
+                break;
+            }
+            continue;
+        }
+
+        cul_line_reader_feed(reader, buf, (size_t)n, consumer->on_line, consumer->ctx);
+        consumer->on_idle(consumer->ctx);
+    }
+
+    cul_line_reader_finish(reader, consumer->on_line, consumer->ctx);
+    consumer->on_idle(consumer->ctx);
+    if (fd > STDIN_FILENO) {
+        close(fd);
+    }
+    return rc;
+}
+
+// Reads several sticks at once through one event loop, with cross-stick
+// duplicates suppressed, until all sources end or a signal arrives.
+static int read_multi(const StreamOptions* opt, const LineConsumer* consumer, unsigned long* lines,
+                      unsigned long* overlong) {
+    static CulMux mux;
+    if (cul_mux_open(&mux, opt->sources, opt->num_sources, opt->baud, opt->dedupe_ms,
+                     consumer->on_line, consumer->ctx) != 0) {
+        return 1;
+    }
+    while (!stop_requested && cul_mux_poll(&mux) > 0) {
+        consumer->on_idle(consumer->ctx);
+        service_stats();
+    }
+    cul_mux_close(&mux);
+    consumer->on_idle(consumer->ctx);
+
+    fprintf(stderr, "Sources: %d, duplicate window %llu ms\n", mux.num_sources,
+            (unsigned long long)opt->dedupe_ms);
+    for (int i = 0; i < mux.num_sources; i++) {
+        const CulSource* src = &mux.sources[i];
+        fprintf(stderr, "  %-20s %8lu lines, %lu kept, %lu duplicates, %lu overlong, %lu reopens\n",
+                src->path, src->reader.lines, src->stats.kept, src->stats.duplicates,
+                src->reader.overlong, src->stats.reopens);
+        *lines += src->reader.lines;
+        *overlong += src->reader.overlong;
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+// Decodes newline-delimited CUL output from one or more files, FIFOs,
+// serial devices or stdin until end of input or SIGINT/SIGTERM.
+static int run_stream(const StreamOptions* opt) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    install_stats_signals(opt->stats_interval);
+
+    StreamState state;
+    memset(&state, 0, sizeof(state));
+    state.verbose = opt->verbose;
+    state.aggregates_only = opt->aggregates_only;
+
+    OutputSink out;
+    if (output_sink_init(&out, opt->format, STDOUT_FILENO, STREAM_OUTPUT_SIZE) != 0) {
+        fprintf(stderr, "Error: Could not allocate the output buffer\n");
+        return 1;
+    }
+    output_sink_header(&out);
+    state.out = &out;
+
+    DecodeCache cache;
+    if (opt->cache_size > 0) {
+        if (decode_cache_init(&cache, opt->cache_size, opt->cache_ttl_ms) != 0) {
+            fprintf(stderr, "Error: Could not allocate a decode cache of %zu entries\n", opt->cache_size);
+            output_sink_free(&out);
+            return 1;
+        }
+        state.cache = &cache;
+    }
+
+    DeviceRegistry devices;
+    if (device_registry_init(&devices, EXPECTED_DEVICES) == 0) {
+        state.devices = &devices;
+    }
+
+    AggregateStore aggregates;
+    AggregateReport report;
+    if (opt->window > 0 && state.devices) {
+        if (aggregate_store_init(&aggregates, opt->window, opt->alpha, AGGREGATE_MAX_DEVICES,
+                                 AGGREGATE_MAX_SERIES) != 0 ||
+            (opt->report && aggregate_report_init(&report, &aggregates, &out, opt->report_ms) != 0)) {
+            fprintf(stderr, "Error: Could not set up aggregation over %u readings\n", opt->window);
+            aggregate_store_free(&aggregates);
+            device_registry_free(&devices);
+            if (state.cache) {
+                decode_cache_free(&cache);
+            }
+            output_sink_free(&out);
+            return 1;
+        }
+        state.aggregates = &aggregates;
+        if (opt->report) {
+            state.report = &report;
+        }
+    }
+
+    static ReadingArchive archive;
+    if (opt->archive) {
+        if (reading_archive_open(&archive, opt->archive, ARCHIVE_SYNC_MS) != 0) {
+            fprintf(stderr, "Error: Could not open archive %s: %s\n", opt->archive,
+                    errno == EINVAL ? "not an archive" :
+                    errno == EWOULDBLOCK ? "another process is writing it" : strerror(errno));
+            if (state.report) {
+                aggregate_report_free(&report);
+            }
+            if (state.aggregates) {
+                aggregate_store_free(&aggregates);
+            }
+            if (state.devices) {
+                device_registry_free(&devices);
+            }
+            if (state.cache) {
+                decode_cache_free(&cache);
+            }
+            output_sink_free(&out);
+            return 1;
+        }
+        state.archive = &archive;
+    }
+
+    // Allocated last: nothing after it can fail
+    EmissionFilter filter;
+    if (opt->filter && state.devices && emission_filter_init(&filter, FILTER_MAX_DEVICES, opt->heartbeat_ms) == 0) {
+        memcpy(filter.deadband, opt->deadband, sizeof(filter.deadband));
+        state.filter = &filter;
+    } else if (opt->filter) {
+        fprintf(stderr, "Warning: Could not set up the emission filter, emitting every reading\n");
+    }
+
+    const char* single = opt->num_sources ? opt->sources[0] : "-";
+    LineConsumer consumer = {handle_line, flush_output, &state};
+    static Pipeline pipeline;
+    bool pipelined = false;
+    if (opt->pipeline) {
+        // Waiting on a live source (serial device, pipe, FIFO) backs up
+        // whatever feeds it, so ingest only waits for room when every source
+        // is a regular file or --lossless asks for it
+        bool files = true;
+        for (int i = 0; i < (opt->num_sources ? opt->num_sources : 1); i++) {
+            const char* path = opt->num_sources ? opt->sources[i] : "-";
+            struct stat st;
+            int rc = strcmp(path, "-") == 0 ? fstat(STDIN_FILENO, &st) : stat(path, &st);
+            files &= rc == 0 && S_ISREG(st.st_mode);
+        }
+        PipelineConfig pc = {
+            .depth = opt->queue_depth,
+            .lossless = opt->lossless || files,
+            .verbose = opt->verbose,
+            .out = &out,
+            .devices = state.devices,
+            .aggregates = state.report ? NULL : state.aggregates,
+            .report = state.report,
+            .aggregates_only = state.aggregates_only,
+            .archive = state.archive,
+            .filter = state.filter,
+        };
+        if (pipeline_start(&pipeline, &pc) == 0) {
+            consumer = (LineConsumer){pipeline_push_line, pipeline_publish, &pipeline};
+            pipelined = true;
+        } else {
+            fprintf(stderr, "Warning: Could not start the decoding pipeline (%s), decoding inline\n",
+                    strerror(errno));
+        }
+    }
+
+    int rc;
+    unsigned long lines = 0, overlong = 0;
+    if (opt->num_sources > 1) {
+        rc = read_multi(opt, &consumer, &lines, &overlong);
+    } else {
+        static CulLineReader reader;
+        cul_line_reader_init(&reader);
+        rc = read_single(single, opt->baud, &consumer, &reader);
+        lines = reader.lines;
+        overlong = reader.overlong;
+    }
+    if (pipelined) {
+        pipeline_stop(&pipeline);
+        pipeline_status_counts(&pipeline, state.by_status);
+        memcpy(state.by_protocol, pipeline.by_protocol, sizeof(state.by_protocol));
+    }
+    if (state.report) {
+        aggregate_report_flush(&report, -1);
+    }
+
+    output_sink_free(&out);
+    print_summary(lines, overlong, state.by_status, state.by_protocol);
+    if (pipelined) {
+        pipeline_print_stats(&pipeline, stderr);
+        pipeline_free(&pipeline);
+    }
+    if (state.archive) {
+        bool failed = archive.failed;
+        if (reading_archive_close(&archive) != 0) {
+            failed = true;
+        }
+        fprintf(stderr, "Archive: %lu readings appended", archive.appended);
+        if (archive.dropped > 0) {
+            fprintf(stderr, ", %lu of devices beyond its %d dropped", archive.dropped, ARCHIVE_MAX_DEVICES);
+        }
+        if (archive.reordered > 0) {
+            fprintf(stderr, ", %lu out of order", archive.reordered);
+        }
+        fprintf(stderr, "%s\n", failed ? "; writing failed, later readings were lost" : "");
+    }
+    if (state.filter) {
+        fprintf(stderr, "Emission filter: %lu readings passed (%lu heartbeats), %lu suppressed",
+                filter.passed, filter.heartbeats, filter.suppressed);
+        if (filter.untracked > 0) {
+            fprintf(stderr, ", %lu of untracked devices passed", filter.untracked);
+        }
+        fprintf(stderr, "\n");
+        emission_filter_free(&filter);
+    }
+    if (state.cache) {
+        const DecodeCacheStats* cs = &cache.stats;
+        fprintf(stderr, "Cache: %lu hits, %lu misses (%lu expired), %lu evictions, %lu uncacheable\n",
+                cs->hits, cs->misses, cs->expired, cs->evictions, cs->uncacheable);
+        decode_cache_free(&cache);
+    }
+    if (state.devices) {
+        print_devices(&devices);
+        if (state.aggregates) {
+            print_aggregates(&devices, &aggregates);
+            if (state.report) {
+                fprintf(stderr, "  %lu aggregate records written\n", report.records);
+                aggregate_report_free(&report);
+            }
+            aggregate_store_free(&aggregates);
+        }
+        device_registry_free(&devices);
+    }
+    if (opt->stats) {
+        dump_stats();
+    }
+    return rc;
+}
+
+
+// ==========================================================================
+// BATCH MODE
+// ==========================================================================
+
+// Decodes a captured CUL log with several threads, output in input order.
+static int run_batch(const char* path, int threads, OutputFormat format, bool dump) {
+    if (threads < 1) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+
+    BatchStats stats;
+    int rc = batch_decode_file(path, threads, format, STDOUT_FILENO, &stats);
+    if (rc != 0) {
+        fprintf(stderr, "Error: Could not decode %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    print_summary(stats.lines, stats.overlong, stats.by_status, stats.by_protocol);
+    if (dump) {
+        dump_stats();
+    }
+    return 0;
+}
+
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s <raw_cul_message>\n", prog);
+    fprintf(stderr, "       %s --stream [--baud N] [--cache N [--cache-ttl S]]\n"
+                    "                [--window N [--ewma-alpha A] [--aggregate-every S [--aggregates-only]]]\n"
+                    "                [--output FORMAT] [--verbose]\n"
+                    "                [--dedupe-window MS] [--pipeline [--queue-depth N] [--lossless]]\n"
+                    "                [--stats [--stats-interval S]] [--timers] [--archive FILE]\n"
+                    "                [--deadband LIST] [--heartbeat S] [source...]\n", prog);
+    fprintf(stderr, "       %s --batch <capture_file> [--jobs N] [--output FORMAT] [--stats [--timers]]\n",
+            prog);
+    fprintf(stderr, "Example: %s omAAAAAAAB32D4CB3554D54CAB5554B53554B54D4D555414\n", prog);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -s, --stream     Decode newline-delimited CUL output continuously from\n");
+    fprintf(stderr, "                   source (file, FIFO or serial device; default: stdin). Several\n");
+    fprintf(stderr, "                   sources are read at once, e.g. one per CUL stick\n");
+    fprintf(stderr, "  -b, --baud N     Baud rate for serial sources (default: %d)\n", DEFAULT_BAUD);
+    fprintf(stderr, "  -c, --cache N    Reuse results of repeated frames from a cache of N entries\n");
+    fprintf(stderr, "  -t, --cache-ttl S  Expire cached results after S seconds (default: %d)\n", DEFAULT_CACHE_TTL);
+    fprintf(stderr, "  -w, --window N   Keep rolling mean/min/max over the last N readings of\n");
+    fprintf(stderr, "                   each device and reading type, printed at exit\n");
+    fprintf(stderr, "  -a, --ewma-alpha A  Weight of a new reading in the moving average (default: %.1f)\n",
+            DEFAULT_EWMA_ALPHA);
+    fprintf(stderr, "  -e, --aggregate-every S  With --window, also write each device's aggregates to\n");
+    fprintf(stderr, "                   the output every S seconds; 0 writes a type's once per window\n");
+    fprintf(stderr, "  -R, --aggregates-only  Write the aggregate records instead of the readings\n");
+    fprintf(stderr, "  -d, --dedupe-window MS  With several sources, pass on only the best-RSSI copy\n");
+    fprintf(stderr, "                   of a frame heard by several sticks within MS ms (default: %d)\n",
+            DEFAULT_DEDUPE_MS);
+    fprintf(stderr, "  -P, --pipeline   Decode on separate preprocess, parse and output threads, so\n");
+    fprintf(stderr, "                   a slow consumer never stalls reading a live source (lines\n");
+    fprintf(stderr, "                   are dropped and counted instead when the queue is full)\n");
+    fprintf(stderr, "  -q, --queue-depth N  Messages each pipeline queue holds (default: %d)\n",
+            DEFAULT_QUEUE_DEPTH);
+    fprintf(stderr, "  -L, --lossless   With --pipeline, wait for room instead of dropping lines;\n");
+    fprintf(stderr, "                   always the case when every source is a regular file\n");
+    fprintf(stderr, "  -A, --archive FILE  Also append every reading to an archive file, for\n");
+    fprintf(stderr, "                   queries with oregon_query\n");
+    fprintf(stderr, "  -D, --deadband LIST  Emit a reading only when it changed from the last one\n");
+    fprintf(stderr, "                   emitted for its device and type by at least the type's\n");
+    fprintf(stderr, "                   deadband, e.g. temperature=0.1,humidity=1 (others: any\n");
+    fprintf(stderr, "                   change); state changes always pass\n");
+    fprintf(stderr, "  -H, --heartbeat S  With --deadband, emit unchanged readings again after S\n");
+    fprintf(stderr, "                   seconds (default: %d, 0 never); alone, enables the filter\n",
+            DEFAULT_HEARTBEAT);
+    fprintf(stderr, "  -v, --verbose    Report every line that fails to decode on stderr\n");
+    fprintf(stderr, "  -B, --batch      Decode a captured CUL log file with several threads\n");
+    fprintf(stderr, "  -j, --jobs N     Worker threads for --batch (default: one per CPU)\n");
+    fprintf(stderr, "  -o, --output FORMAT  Output format for --stream and --batch: text (default),\n");
+    fprintf(stderr, "                   json (JSON Lines), csv or influx (InfluxDB line protocol)\n");
+    fprintf(stderr, "  -S, --stats      Print decoder counters per stage and outcome as a JSON line\n");
+    fprintf(stderr, "                   on stderr at exit; in stream mode also on SIGUSR1\n");
+    fprintf(stderr, "  -I, --stats-interval S  Print them every S seconds as well (implies --stats)\n");
+    fprintf(stderr, "  -T, --timers     Also count CPU cycles spent in each stage\n");
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option options[] = {
+        {"stream",  no_argument,       NULL, 's'},
+        {"baud",    required_argument, NULL, 'b'},
+        {"verbose", no_argument,       NULL, 'v'},
+        {"cache",   required_argument, NULL, 'c'},
+        {"cache-ttl", required_argument, NULL, 't'},
+        {"window",  required_argument, NULL, 'w'},
+        {"ewma-alpha", required_argument, NULL, 'a'},
+        {"aggregate-every", required_argument, NULL, 'e'},
+        {"aggregates-only", no_argument, NULL, 'R'},
+        {"dedupe-window", required_argument, NULL, 'd'},
+        {"pipeline", no_argument,      NULL, 'P'},
+        {"queue-depth", required_argument, NULL, 'q'},
+        {"lossless", no_argument,      NULL, 'L'},
+        {"batch",   no_argument,       NULL, 'B'},
+        {"jobs",    required_argument, NULL, 'j'},
+        {"output",  required_argument, NULL, 'o'},
+        {"stats",   no_argument,       NULL, 'S'},
+        {"stats-interval", required_argument, NULL, 'I'},
+        {"timers",  no_argument,       NULL, 'T'},
+        {"archive", required_argument, NULL, 'A'},
+        {"deadband", required_argument, NULL, 'D'},
+        {"heartbeat", required_argument, NULL, 'H'},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    bool stream = false;
+    bool batch = false;
+    int jobs = 0;
+    long cache_size = 0;
+    long cache_ttl = DEFAULT_CACHE_TTL;
+    long window = 0;
+    long aggregate_every = -1;
+    long dedupe_ms = DEFAULT_DEDUPE_MS;
+    long queue_depth = DEFAULT_QUEUE_DEPTH;
+    long stats_interval = 0;
+    long heartbeat = DEFAULT_HEARTBEAT;
+
+    StreamOptions so;
+    memset(&so, 0, sizeof(so));
+    so.baud = DEFAULT_BAUD;
+    so.alpha = DEFAULT_EWMA_ALPHA;
+    so.format = OUTPUT_TEXT;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "sb:vBj:c:t:w:a:e:Rd:Pq:Lo:SI:TA:D:H:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 's': stream = true; break;
+            case 'b': so.baud = atoi(optarg); break;
+            case 'v': so.verbose = true; break;
+            case 'B': batch = true; break;
+            case 'j': jobs = atoi(optarg); break;
+            case 'c': cache_size = atol(optarg); break;
+            case 't': cache_ttl = atol(optarg); break;
+            case 'w': window = atol(optarg); break;
+            case 'a': so.alpha = atof(optarg); break;
+            case 'e': aggregate_every = atol(optarg); break;
+            case 'R': so.aggregates_only = true; break;
+            case 'd': dedupe_ms = atol(optarg); break;
+            case 'P': so.pipeline = true; break;
+            case 'q': queue_depth = atol(optarg); break;
+            case 'L': so.lossless = true; break;
+            case 'S': so.stats = true; break;
+            case 'I': stats_interval = atol(optarg); so.stats = true; break;
+            case 'T': oregon_stats_set_timers(true); break;
+            case 'A': so.archive = optarg; break;
+            case 'D':
+                if (!emission_filter_parse_deadbands(optarg, so.deadband)) {
+                    fprintf(stderr, "Error: Bad deadband list %s\n", optarg);
+                    return 1;
+                }
+                so.filter = true;
+                break;
+            case 'H': heartbeat = atol(optarg); so.filter = true; break;
+            case 'o':
+                if (!output_format_parse(optarg, &so.format)) {
+                    fprintf(stderr, "Error: Unknown output format %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (batch) {
+        if (optind >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        return run_batch(argv[optind], jobs, so.format, so.stats);
+    }
+    if (stream) {
+        so.sources = (const char* const*)argv + optind;
+        so.num_sources = argc - optind;
+        so.cache_size = cache_size > 0 ? (size_t)cache_size : 0;
+        so.cache_ttl_ms = cache_ttl > 0 ? (uint64_t)cache_ttl * 1000u : 0;
+        so.window = window > 0 ? (uint32_t)window : 0;
+        so.report = aggregate_every >= 0 || so.aggregates_only;
+        so.report_ms = aggregate_every > 0 ? (uint64_t)aggregate_every * 1000u : 0;
+        so.dedupe_ms = dedupe_ms > 0 ? (uint64_t)dedupe_ms : 0;
+        so.queue_depth = queue_depth > 0 ? (size_t)queue_depth : DEFAULT_QUEUE_DEPTH;
+        so.stats_interval = stats_interval > 0 ? (unsigned)stats_interval : 0;
+        so.heartbeat_ms = heartbeat > 0 ? (uint64_t)heartbeat * 1000u : 0;
+        if (so.report && so.window == 0) {
+            fprintf(stderr, "Error: --aggregate-every and --aggregates-only need --window\n");
+            return 1;
+        }
+        if (so.aggregates_only && so.filter) {
+            fprintf(stderr, "Error: --aggregates-only leaves no readings for --deadband or --heartbeat\n");
+            return 1;
+        }
+        if (so.lossless && !so.pipeline) {
+            fprintf(stderr, "Error: --lossless needs --pipeline\n");
+            return 1;
+        }
+        if (so.pipeline && so.cache_size > 0) {
+            fprintf(stderr, "Error: --cache works on whole lines and cannot be combined with --pipeline\n");
+            return 1;
+        }
+        return run_stream(&so);
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    return run_single(argv[optind]);
+}
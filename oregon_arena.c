@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+#include "oregon_arena.h"
+
+static size_t align_up(size_t n) {
+    return (n + OREGON_ARENA_ALIGN - 1) & ~(size_t)(OREGON_ARENA_ALIGN - 1);
+}
+
+static OregonArenaBlock* new_block(OregonArena* arena, size_t size) {
+    OregonArenaBlock* b = malloc(sizeof(OregonArenaBlock) + size);
+    if (!b) {
+        return NULL;
+    }
+    b->next = NULL;
+    b->size = size;
+    arena->blocks++;
+    return b;
+}
+
+int oregon_arena_init(OregonArena* arena, size_t block_size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->block_size = align_up(block_size ? block_size : OREGON_ARENA_ALIGN);
+    arena->first = new_block(arena, arena->block_size);
+    if (!arena->first) {
+        return -1;
+    }
+    arena->current = arena->first;
+    return 0;
+}
+
+void oregon_arena_free(OregonArena* arena) {
+    OregonArenaBlock* b = arena->first;
+    while (b) {
+        OregonArenaBlock* next = b->next;
+        free(b);
+        b = next;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+void oregon_arena_reset(OregonArena* arena) {
+    arena->current = arena->first;
+    arena->used = 0;
+    arena->last = 0;
+}
+
+void* oregon_arena_alloc(OregonArena* arena, size_t size) {
+    size = align_up(size ? size : 1);
+    if (arena->used + size > arena->current->size) {
+        // Move on to the next kept block that fits, or splice in a new one
+        // after the current block so the chain order is kept for next time
+        OregonArenaBlock* b = arena->current->next;
+        while (b && b->size < size) {
+            b = b->next;
+        }
+        if (!b) {
+            b = new_block(arena, size > arena->block_size ? size : arena->block_size);
+            if (!b) {
+                return NULL;
+            }
+            b->next = arena->current->next;
+            arena->current->next = b;
+        }
+        arena->current = b;
+        arena->used = 0;
+    }
+    arena->last = arena->used;
+    arena->used += size;
+    return arena->current->data + arena->last;
+}
+
+void* oregon_arena_grow(OregonArena* arena, void* ptr, size_t old_size, size_t new_size) {
+    unsigned char* p = ptr;
+    if (p == arena->current->data + arena->last && arena->last + new_size <= arena->current->size) {
+        arena->used = arena->last + align_up(new_size ? new_size : 1);
+        return ptr;
+    }
+    void* moved = oregon_arena_alloc(arena, new_size);
+    if (moved && old_size) {
+        memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return moved;
+}
+
+char* oregon_arena_strdup(OregonArena* arena, const char* s) {
+    size_t len = strlen(s) + 1;
+    char* copy = oregon_arena_alloc(arena, len);
+    if (copy) {
+        memcpy(copy, s, len);
+    }
+    return copy;
+}
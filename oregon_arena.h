@@ -0,0 +1,53 @@
+#ifndef OREGON_ARENA_H
+#define OREGON_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Alignment of every arena allocation.
+#define OREGON_ARENA_ALIGN 16
+
+typedef struct OregonArenaBlock {
+    struct OregonArenaBlock* next;
+    size_t size;                 // Usable bytes in data
+    _Alignas(OREGON_ARENA_ALIGN) unsigned char data[];
+} OregonArenaBlock;
+
+// Bump allocator for scratch space and results that all die together, e.g.
+// everything produced while decoding one batch of messages. Allocation is a
+// pointer increment; there is no per-allocation free. Resetting rewinds to
+// the first block but keeps every block, so once an arena has grown to the
+// size of a batch it never calls the system allocator again.
+// Not thread-safe; use one arena per thread or per batch in flight.
+typedef struct {
+    OregonArenaBlock* first;
+    OregonArenaBlock* current;
+    size_t used;                 // Bytes taken from current
+    size_t last;                 // Offset of the latest allocation in current
+    size_t block_size;           // Size of blocks added when the chain runs out
+    unsigned long blocks;        // Blocks obtained from malloc so far
+} OregonArena;
+
+// Allocates the first block of `block_size` bytes. Returns 0 on success,
+// -1 if allocation fails.
+int oregon_arena_init(OregonArena* arena, size_t block_size);
+// Returns every block to the system.
+void oregon_arena_free(OregonArena* arena);
+
+// Invalidates everything allocated so far and makes the space reusable.
+void oregon_arena_reset(OregonArena* arena);
+
+// Returns `size` bytes aligned to OREGON_ARENA_ALIGN, or NULL if a new block
+// was needed and could not be allocated.
+void* oregon_arena_alloc(OregonArena* arena, size_t size);
+
+// Resizes ptr, an allocation of old_size bytes, to new_size. The latest
+// allocation grows in place when its block has room; otherwise the first
+// old_size bytes are copied to a new allocation. Returns NULL on failure,
+// leaving ptr untouched.
+void* oregon_arena_grow(OregonArena* arena, void* ptr, size_t old_size, size_t new_size);
+
+// Copies a NUL-terminated string into the arena.
+char* oregon_arena_strdup(OregonArena* arena, const char* s);
+
+#endif // OREGON_ARENA_H
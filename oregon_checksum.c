@@ -0,0 +1,13 @@
+#include "oregon_checksum.h"
+
+const OregonChecksum OREGON_CHECKSUM1 = OREGON_CHECKSUM1_DESC;
+const OregonChecksum OREGON_CHECKSUM2 = OREGON_CHECKSUM2_DESC;
+const OregonChecksum OREGON_CHECKSUM3 = OREGON_CHECKSUM3_DESC;
+const OregonChecksum OREGON_CHECKSUM4 = OREGON_CHECKSUM4_DESC;
+const OregonChecksum OREGON_CHECKSUM5 = OREGON_CHECKSUM5_DESC;
+const OregonChecksum OREGON_CHECKSUM6 = OREGON_CHECKSUM6_DESC;
+const OregonChecksum OREGON_CHECKSUM7 = OREGON_CHECKSUM7_DESC;
+
+bool oregon_checksum_verify(const OregonChecksum* cs, const uint8_t* payload) {
+    return oregon_checksum_eval(cs, payload);
+}
@@ -0,0 +1,101 @@
+#ifndef OREGON_CHECKSUM_H
+#define OREGON_CHECKSUM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <endian.h>
+
+// Payload nibbles are numbered in transmission order: nibble 2k is the high
+// nibble of byte k, nibble 2k + 1 its low nibble.
+#define OREGON_NIBBLE(bytes, i) (((bytes)[(i) >> 1] >> ((~(i) & 1) << 2)) & 0x0F)
+
+// Longest range a checksum can cover; verification reads this many nibbles'
+// worth of whole words from the payload.
+#define OREGON_CHECKSUM_MAX_NIBBLES 32
+
+// Describes one checksum: the sum of the covered nibbles minus offset,
+// modulo 256, and where the expected value lives. The expected byte is
+// nibble check_lo | nibble check_hi << 4, so split or swapped check nibbles
+// need no special code.
+typedef struct {
+    uint8_t nibbles;    // Nibbles covered, starting at nibble 0
+    uint8_t offset;     // Subtracted from the sum
+    uint8_t check_lo;   // Nibble index of the expected value's low nibble
+    uint8_t check_hi;   // Nibble index of the expected value's high nibble
+} OregonChecksum;
+
+// Expected value in the byte right after a whole number of covered bytes.
+#define OREGON_SUM_BYTE(bytes) {2 * (bytes), 0xa, 2 * (bytes) + 1, 2 * (bytes)}
+
+// The Oregon Scientific nibble-sum checksums, named as in the FHEM module.
+// The _DESC initialisers let callers build constant copies the compiler can
+// fold into specialised code.
+#define OREGON_CHECKSUM1_DESC {13, 0xa, 12, 15}
+#define OREGON_CHECKSUM2_DESC OREGON_SUM_BYTE(8)
+#define OREGON_CHECKSUM3_DESC OREGON_SUM_BYTE(11)
+#define OREGON_CHECKSUM4_DESC OREGON_SUM_BYTE(9)
+#define OREGON_CHECKSUM5_DESC OREGON_SUM_BYTE(10)
+#define OREGON_CHECKSUM6_DESC {16, 0xa, 16, 19}
+#define OREGON_CHECKSUM7_DESC OREGON_SUM_BYTE(7)
+
+extern const OregonChecksum OREGON_CHECKSUM1;   // 13 nibbles, check in nibbles 12 and 15
+extern const OregonChecksum OREGON_CHECKSUM2;   // bytes 0-7, check in byte 8
+extern const OregonChecksum OREGON_CHECKSUM3;   // bytes 0-10, check in byte 11
+extern const OregonChecksum OREGON_CHECKSUM4;   // bytes 0-8, check in byte 9
+extern const OregonChecksum OREGON_CHECKSUM5;   // bytes 0-9, check in byte 10
+extern const OregonChecksum OREGON_CHECKSUM6;   // bytes 0-7, check in nibbles 16 and 19
+extern const OregonChecksum OREGON_CHECKSUM7;   // bytes 0-6, check in byte 7
+
+// Returns true if the payload matches the checksum. The payload buffer must
+// be readable for OREGON_CHECKSUM_MAX_NIBBLES / 2 bytes, as OregonFrame.data is.
+bool oregon_checksum_verify(const OregonChecksum* cs, const uint8_t* payload);
+
+// ==========================================================================
+// INLINE EVALUATION
+// ==========================================================================
+
+// Everything below is inline so that a descriptor known at compile time
+// reduces to a few masks and adds; oregon_checksum_verify() wraps it.
+
+static inline uint64_t oregon_load_le64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+// Keeps the first n (0..16) nibbles of a little-endian word: whole bytes,
+// then the high nibble of the next byte if n is odd.
+static inline uint64_t oregon_nibble_mask(unsigned n) {
+    if (n >= 16) {
+        return ~0ull;
+    }
+    uint64_t m = (1ull << (8 * (n / 2))) - 1;
+    if (n & 1) {
+        m |= 0xF0ull << (8 * (n / 2));
+    }
+    return m;
+}
+
+// Adds the two nibbles of each byte in place (at most 30 per byte), then
+// sums the bytes into the top byte with one multiply (at most 240).
+static inline unsigned oregon_sum_word_nibbles(uint64_t w) {
+    uint64_t s = (w & 0x0F0F0F0F0F0F0F0Full) + ((w >> 4) & 0x0F0F0F0F0F0F0F0Full);
+    return (unsigned)((s * 0x0101010101010101ull) >> 56);
+}
+
+static inline unsigned oregon_nibble_sum(const uint8_t* p, unsigned n) {
+    unsigned sum = oregon_sum_word_nibbles(oregon_load_le64(p) & oregon_nibble_mask(n));
+    if (n > 16) {
+        sum += oregon_sum_word_nibbles(oregon_load_le64(p + 8) & oregon_nibble_mask(n - 16));
+    }
+    return sum;
+}
+
+static inline bool oregon_checksum_eval(const OregonChecksum* cs, const uint8_t* payload) {
+    uint8_t expected = (uint8_t)(OREGON_NIBBLE(payload, cs->check_lo) |
+                                 (OREGON_NIBBLE(payload, cs->check_hi) << 4));
+    return (uint8_t)(oregon_nibble_sum(payload, cs->nibbles) - cs->offset) == expected;
+}
+
+#endif // OREGON_CHECKSUM_H
@@ -3,6 +3,9 @@
 #include <string.h>
 #include <time.h>
 #include "oregon_parser.h"
+#include "hex_pack.h"
+#include "oregon_checksum.h"
+#include "oregon_stats.h"
 
 // ==========================================================================
 // UTILITY MACROS AND FUNCTIONS (Equivalent to OREGON_hi/lo_nibble, etc.)
@@ -13,28 +16,6 @@
 // Extracts the low nibble from a byte
 #define LO_NIBBLE(b) ((b) & 0x0F)
 
-// Converts a Binary Coded Decimal (BCD) byte to its decimal value.
-// e.g., 0x21 becomes 21. This replaces Perl's sprintf("%02x", ...) trick.
-static inline uint8_t bcd_to_dec(uint8_t bcd) {
-    return (uint8_t)((HI_NIBBLE(bcd) * 10) + LO_NIBBLE(bcd));
-}
-
-// Sums the high and low nibbles of each byte in an array.
-// Corresponds to OREGON_nibble_sum
-static int nibble_sum(const uint8_t* bytes, float count) {
-    int sum = 0;
-    int byte_count = (int)count;
-    for (int i = 0; i < byte_count; i++) {
-        sum += HI_NIBBLE(bytes[i]);
-        sum += LO_NIBBLE(bytes[i]);
-    }
-    // Handle fractional part for odd nibble counts
-    if (count > byte_count) {
-        sum += HI_NIBBLE(bytes[byte_count]);
-    }
-    return sum;
-}
-
 // Converts a hex string to a byte array. Returns bytes written or -1 on error.
 static int hex_to_bytes(const char* hex_str, uint8_t* out_bytes, size_t max_len) {
     size_t len = strlen(hex_str);
@@ -43,273 +24,807 @@ static int hex_to_bytes(const char* hex_str, uint8_t* out_bytes, size_t max_len)
     size_t byte_len = len / 2;
     if (byte_len > max_len) return -1; // Buffer too small
 
-    for (size_t i = 0; i < byte_len; i++) {
-        if (sscanf(hex_str + 2 * i, "%2hhx", &out_bytes[i]) != 1) {
-            return -1; // Invalid hex character
-        }
+    if (hex_pack(hex_str, len, out_bytes) != len) {
+        return -1; // Invalid hex character
     }
     return (int)byte_len;
 }
 
 
 // ==========================================================================
-// DATA EXTRACTION FUNCTIONS (e.g., OREGON_temperature, OREGON_humidity)
+// FIELD DESCRIPTORS (Equivalent to OREGON_temperature, OREGON_humidity, ...)
 // ==========================================================================
 
-static void decode_temperature(const uint8_t* bytes, const char* dev_str, OregonReading* r) {
-    strcpy(r->device, dev_str);
-    strcpy(r->type, "temperature");
-    strcpy(r->units, "C");
-    
-    // Ternary operator for sign
-    double sign = (bytes[6] & 0x08) ? -1.0 : 1.0;
-    r->current = sign * (
-        (double)bcd_to_dec(bytes[5]) +
-        (double)HI_NIBBLE(bytes[4]) / 10.0
-    );
-}
-
-static void decode_humidity(const uint8_t* bytes, const char* dev_str, OregonReading* r) {
-    strcpy(r->device, dev_str);
-    strcpy(r->type, "humidity");
-    strcpy(r->units, "%");
-    r->current = (double)(LO_NIBBLE(bytes[7]) * 10 + HI_NIBBLE(bytes[6]));
-    
-    const char* comfort_levels[] = {"normal", "comfortable", "dry", "wet"};
-    strcpy(r->string_val, comfort_levels[bytes[7] >> 6]);
-}
+// Payload nibbles are numbered as in oregon_checksum.h: nibble 2k is the
+// high nibble of byte k. Values are in 1/OREGON_VALUE_SCALE units.
+#define NIB(bytes, i) OREGON_NIBBLE(bytes, i)
+#define FIELD_MAX_DIGITS 6
+
+typedef struct {
+    uint8_t nibble;
+    int32_t weight;         // Contribution of one count of this nibble
+} FieldDigit;
+
+// How to extract one reading from a payload:
+//   value    = offset + sum of nibble * weight over the digits, negated if
+//              the sign nibble has any sign_mask bit set
+//   state    = state_lut[nibble lut_nibble], or of value / OREGON_VALUE_SCALE
+//              clamped to 0..15 if lut_from_value
+//   forecast = forecast_lut[nibble lut_nibble]
+// BCD digits are just nibbles with decimal weights.
+typedef struct {
+    uint8_t type;                   // OregonReadingType
+    uint8_t unit;                   // OregonUnit; OREGON_UNIT_NONE leaves value 0
+    uint8_t num_digits;
+    uint8_t sign_nibble;
+    uint8_t sign_mask;              // 0 for unsigned values
+    uint8_t lut_nibble;
+    bool lut_from_value;
+    int32_t offset;
+    FieldDigit digits[FIELD_MAX_DIGITS];
+    const uint8_t* state_lut;       // 16 OregonState values, or NULL
+    const uint8_t* forecast_lut;    // 16 OregonForecast values, or NULL
+} FieldDesc;
+
+// The readings one sensor family decodes into, in output order.
+typedef struct {
+    uint8_t num_fields;
+    FieldDesc fields[OREGON_MAX_READINGS];
+} SensorLayout;
+
+#define DIGITS(...) \
+    .num_digits = sizeof((FieldDigit[]){__VA_ARGS__}) / sizeof(FieldDigit), .digits = {__VA_ARGS__}
+
+// Comfort level in the top two bits of nibble 14
+static const uint8_t COMFORT_LUT[16] = {
+    OREGON_STATE_NORMAL, OREGON_STATE_NORMAL, OREGON_STATE_NORMAL, OREGON_STATE_NORMAL,
+    OREGON_STATE_COMFORTABLE, OREGON_STATE_COMFORTABLE, OREGON_STATE_COMFORTABLE, OREGON_STATE_COMFORTABLE,
+    OREGON_STATE_DRY, OREGON_STATE_DRY, OREGON_STATE_DRY, OREGON_STATE_DRY,
+    OREGON_STATE_WET, OREGON_STATE_WET, OREGON_STATE_WET, OREGON_STATE_WET,
+};
+
+// Low battery flag in bit 2 of nibble 9
+static const uint8_t BATTERY_LUT[16] = {
+    OREGON_STATE_BATTERY_OK, OREGON_STATE_BATTERY_OK, OREGON_STATE_BATTERY_OK, OREGON_STATE_BATTERY_OK,
+    OREGON_STATE_BATTERY_LOW, OREGON_STATE_BATTERY_LOW, OREGON_STATE_BATTERY_LOW, OREGON_STATE_BATTERY_LOW,
+    OREGON_STATE_BATTERY_OK, OREGON_STATE_BATTERY_OK, OREGON_STATE_BATTERY_OK, OREGON_STATE_BATTERY_OK,
+    OREGON_STATE_BATTERY_LOW, OREGON_STATE_BATTERY_LOW, OREGON_STATE_BATTERY_LOW, OREGON_STATE_BATTERY_LOW,
+};
 
-static void decode_simple_battery(const uint8_t* bytes, const char* dev_str, OregonReading* r) {
-    strcpy(r->device, dev_str);
-    strcpy(r->type, "battery_status");
-    // The 3rd bit of the 5th byte (index 4) indicates low battery
-    bool is_low = (bytes[4] & 0x04) != 0;
-    strcpy(r->string_val, is_low ? "low" : "ok");
+static const uint8_t FORECAST_LUT[16] = {
+    OREGON_FORECAST_UNKNOWN, OREGON_FORECAST_UNKNOWN, OREGON_FORECAST_CLOUDY, OREGON_FORECAST_RAIN,
+    OREGON_FORECAST_UNKNOWN, OREGON_FORECAST_UNKNOWN, OREGON_FORECAST_PARTLY, OREGON_FORECAST_UNKNOWN,
+    OREGON_FORECAST_UNKNOWN, OREGON_FORECAST_UNKNOWN, OREGON_FORECAST_UNKNOWN, OREGON_FORECAST_UNKNOWN,
+    OREGON_FORECAST_SUNNY, OREGON_FORECAST_UNKNOWN, OREGON_FORECAST_UNKNOWN, OREGON_FORECAST_UNKNOWN,
+};
+
+// UV index 0-2 low, 3-5 medium, 6-7 high, 8-10 very high, 11+ dangerous
+static const uint8_t UV_RISK_LUT[16] = {
+    OREGON_STATE_RISK_LOW, OREGON_STATE_RISK_LOW, OREGON_STATE_RISK_LOW,
+    OREGON_STATE_RISK_MEDIUM, OREGON_STATE_RISK_MEDIUM, OREGON_STATE_RISK_MEDIUM,
+    OREGON_STATE_RISK_HIGH, OREGON_STATE_RISK_HIGH,
+    OREGON_STATE_RISK_VERY_HIGH, OREGON_STATE_RISK_VERY_HIGH, OREGON_STATE_RISK_VERY_HIGH,
+    OREGON_STATE_RISK_DANGEROUS, OREGON_STATE_RISK_DANGEROUS, OREGON_STATE_RISK_DANGEROUS,
+    OREGON_STATE_RISK_DANGEROUS, OREGON_STATE_RISK_DANGEROUS,
+};
+
+// Temperature: BCD byte 5 plus tenths in nibble 8, sign in bit 3 of nibble 13
+#define FIELD_TEMPERATURE \
+    {.type = OREGON_READING_TEMPERATURE, .unit = OREGON_UNIT_CELSIUS, \
+     DIGITS({10, 1000}, {11, 100}, {8, 10}), .sign_nibble = 13, .sign_mask = 0x8}
+// Humidity: tens in nibble 15, units in nibble 12
+#define FIELD_HUMIDITY \
+    {.type = OREGON_READING_HUMIDITY, .unit = OREGON_UNIT_PERCENT, \
+     DIGITS({15, 1000}, {12, 100}), .lut_nibble = 14, .state_lut = COMFORT_LUT}
+#define FIELD_SIMPLE_BATTERY \
+    {.type = OREGON_READING_BATTERY, .lut_nibble = 9, .state_lut = BATTERY_LUT}
+// Battery level: 100 - 10 * nibble 9 percent
+#define FIELD_PERCENTAGE_BATTERY \
+    {.type = OREGON_READING_BATTERY_LEVEL, .unit = OREGON_UNIT_PERCENT, \
+     DIGITS({9, -1000}), .offset = 10000}
+// Pressure: byte 8 plus a per-sensor offset in hPa, forecast in nibble 18
+#define FIELD_PRESSURE(offset_hpa) \
+    {.type = OREGON_READING_PRESSURE, .unit = OREGON_UNIT_HPA, \
+     DIGITS({16, 1600}, {17, 100}), .offset = (offset_hpa) * OREGON_VALUE_SCALE, \
+     .lut_nibble = 18, .forecast_lut = FORECAST_LUT}
+// Gust speed: nibble 15 * 10 + BCD byte 6 / 10
+#define FIELD_WIND_SPEED \
+    {.type = OREGON_READING_WIND_SPEED, .unit = OREGON_UNIT_MPS, \
+     DIGITS({15, 1000}, {12, 100}, {13, 10})}
+// Average speed: BCD byte 8 + nibble 14 / 10
+#define FIELD_WIND_AVERAGE \
+    {.type = OREGON_READING_WIND_AVERAGE, .unit = OREGON_UNIT_MPS, \
+     DIGITS({16, 1000}, {17, 100}, {14, 10})}
+// Direction in 22.5 degree steps in nibble 8
+#define FIELD_WIND_QUADRANT \
+    {.type = OREGON_READING_WIND_DIRECTION, .unit = OREGON_UNIT_DEGREES, DIGITS({8, 2250})}
+// Direction in degrees: BCD byte 5 * 10 + nibble 8
+#define FIELD_WIND_DEGREES \
+    {.type = OREGON_READING_WIND_DIRECTION, .unit = OREGON_UNIT_DEGREES, \
+     DIGITS({10, 10000}, {11, 1000}, {8, 100})}
+// Rain rate: BCD byte 5 * 10 + nibble 8 mm/h
+#define FIELD_RAIN_RATE \
+    {.type = OREGON_READING_RAIN_RATE, .unit = OREGON_UNIT_MM_PER_HOUR, \
+     DIGITS({10, 10000}, {11, 1000}, {8, 100})}
+// Rain total: nibble 17 * 1000 + BCD byte 7 * 10 + nibble 12 mm; nibble 16
+// holds half of the checksum
+#define FIELD_RAIN_TOTAL \
+    {.type = OREGON_READING_RAIN_TOTAL, .unit = OREGON_UNIT_MM, \
+     DIGITS({17, 100000}, {14, 10000}, {15, 1000}, {12, 100})}
+// UV index: nibble 11 * 10 + nibble 8, with its risk level
+#define FIELD_UV \
+    {.type = OREGON_READING_UV, .unit = OREGON_UNIT_UV_INDEX, \
+     DIGITS({11, 1000}, {8, 100}), .lut_from_value = true, .state_lut = UV_RISK_LUT}
+
+// Corresponds to OREGON_common_temphydro
+static const SensorLayout LAYOUT_TEMPHYDRO = {3, {FIELD_TEMPERATURE, FIELD_HUMIDITY, FIELD_SIMPLE_BATTERY}};
+// Corresponds to OREGON_alt_temphydrobaro. The perl code also decodes a
+// percentage battery and uses per-sensor pressure offsets; not done here.
+static const SensorLayout LAYOUT_TEMPHYDROBARO = {3, {FIELD_TEMPERATURE, FIELD_HUMIDITY, FIELD_PRESSURE(856)}};
+// Corresponds to OREGON_common_temp
+static const SensorLayout LAYOUT_TEMP = {2, {FIELD_TEMPERATURE, FIELD_SIMPLE_BATTERY}};
+// Corresponds to OREGON_wtgr800_anemometer / OREGON_wgr800_anemometer
+static const SensorLayout LAYOUT_ANEMOMETER = {4, {FIELD_WIND_SPEED, FIELD_WIND_AVERAGE, FIELD_WIND_QUADRANT,
+                                                   FIELD_PERCENTAGE_BATTERY}};
+// Corresponds to OREGON_alt_wind
+static const SensorLayout LAYOUT_ALT_WIND = {4, {FIELD_WIND_SPEED, FIELD_WIND_AVERAGE, FIELD_WIND_DEGREES,
+                                                 FIELD_SIMPLE_BATTERY}};
+// Corresponds to OREGON_common_rain
+static const SensorLayout LAYOUT_RAIN = {3, {FIELD_RAIN_RATE, FIELD_RAIN_TOTAL, FIELD_SIMPLE_BATTERY}};
+// Corresponds to OREGON_uvn800
+static const SensorLayout LAYOUT_UV = {2, {FIELD_UV, FIELD_SIMPLE_BATTERY}};
+
+// Extracts one field: its value (0 without a unit), state and forecast.
+static inline __attribute__((always_inline))
+void extract_field(const FieldDesc* d, const uint8_t* bytes, int32_t* value_out, uint8_t* state,
+                   uint8_t* forecast) {
+    int32_t value = d->offset;
+#pragma GCC unroll 8
+    for (int k = 0; k < d->num_digits; k++) {
+        value += NIB(bytes, d->digits[k].nibble) * d->digits[k].weight;
+    }
+    if (NIB(bytes, d->sign_nibble) & d->sign_mask) {
+        value = -value;
+    }
+    *value_out = d->unit != OREGON_UNIT_NONE ? value : 0;
+
+    unsigned index = NIB(bytes, d->lut_nibble);
+    if (d->lut_from_value) {
+        int32_t whole = value / OREGON_VALUE_SCALE;
+        index = whole < 0 ? 0 : whole > 15 ? 15 : (unsigned)whole;
+    }
+    *state = d->state_lut ? d->state_lut[index] : OREGON_STATE_NONE;
+    *forecast = d->forecast_lut ? d->forecast_lut[index] : OREGON_FORECAST_NONE;
 }
 
-static void decode_pressure(const uint8_t* bytes, const char* dev_str, int offset, int forecast_nibble, OregonReading* r) {
-    strcpy(r->device, dev_str);
-    strcpy(r->type, "pressure");
-    strcpy(r->units, "hPa");
-    r->current = (double)(bytes[8] + offset);
+// Extracts every field of a layout into the caller's readings. One loop for
+// all sensors: no allocation, no per-sensor code and no indirect calls.
+// Always inlined: with a constant layout the loops unroll and every nibble
+// index, weight and table folds away (see SPECIALISED DECODERS).
+// Returns the number of readings, or -1 if max_readings is too small.
+static inline __attribute__((always_inline)) int extract_fields(const SensorLayout* layout, uint32_t device, const uint8_t* bytes,
+                          OregonReading* readings, int max_readings) {
+    if (layout->num_fields > max_readings) {
+        return -1;
+    }
 
-    switch(forecast_nibble) {
-        case 0xc: strcpy(r->forecast, "sunny"); break;
-        case 0x6: strcpy(r->forecast, "partly"); break;
-        case 0x2: strcpy(r->forecast, "cloudy"); break;
-        case 0x3: strcpy(r->forecast, "rain"); break;
-        default:  strcpy(r->forecast, "unknown"); break;
+#pragma GCC unroll 8
+    for (int f = 0; f < layout->num_fields; f++) {
+        const FieldDesc* d = &layout->fields[f];
+        OregonReading* r = &readings[f];
+        r->device = device;
+        r->type = d->type;
+        r->unit = d->unit;
+        extract_field(d, bytes, &r->value, &r->state, &r->forecast);
     }
+    return layout->num_fields;
 }
 
 
 // ==========================================================================
-// CHECKSUM FUNCTIONS
+// SENSOR DEFINITIONS TABLE (Equivalent to the %types hash)
 // ==========================================================================
 
-static bool checksum1(const uint8_t* b) {
-    uint8_t c = HI_NIBBLE(b[6]) + (LO_NIBBLE(b[7]) << 4);
-    uint8_t s = (nibble_sum(b, 6.5) - 0xa) & 0xff;
-    return s == c;
-}
+typedef struct SensorType {
+    uint32_t key;
+    uint16_t index;         // Position in SENSOR_TYPES
+    const char* part_name;
+    const OregonChecksum* checksum;
+    const SensorLayout* layout;
+} SensorType;
 
-static bool checksum2(const uint8_t* b) {
-    uint8_t c = b[8];
-    uint8_t s = (nibble_sum(b, 8) - 0xa) & 0xff;
-    return s == c;
+// Device key from the sensor definition, rolling code and channel
+static inline uint32_t get_device_key(unsigned sensor, const uint8_t* bytes) {
+    return OREGON_DEVICE_KEY(sensor, bytes[3], HI_NIBBLE(bytes[2]));
 }
 
-static bool checksum4(const uint8_t* b) {
-    uint8_t c = b[9];
-    uint8_t s = (nibble_sum(b, 9) - 0xa) & 0xff;
-    return s == c;
+// Key is generated as: (type << 16) | bits
+// Example: type=0xfa28, bits=80 -> 0xfa280050
+#define SENSOR_KEY(type, bits) (((uint32_t)(type) << 16) | (uint32_t)(bits))
+
+// X(type, bits, part_name, checksum, layout); checksum names an
+// OREGON_CHECKSUMn descriptor from oregon_checksum.h, layout a LAYOUT_ above.
+// Append only: a sensor's position is part of its devices' keys, which
+// reading archives store. SENSOR_POSITIONS below fails the build if an
+// entry moves; reordering or removing one also needs a new ARCHIVE_VERSION.
+#define SENSOR_LIST(X) \
+    X(0xfa28, 80, THGR810,   CHECKSUM2, TEMPHYDRO) \
+    X(0xfab8, 80, WTGR800_T, CHECKSUM2, TEMPHYDRO) /* using common for simplicity */ \
+    X(0x1a99, 88, WTGR800_A, CHECKSUM4, ANEMOMETER) \
+    X(0x1a89, 88, WGR800,    CHECKSUM4, ANEMOMETER) \
+    X(0xea4c, 80, THWR288A,  CHECKSUM1, TEMP) \
+    X(0xea4c, 64, THN132N,   CHECKSUM1, TEMP) \
+    X(0x1a2d, 80, THGR228N,  CHECKSUM2, TEMPHYDRO) \
+    X(0x1a3d, 80, THGR918,   CHECKSUM2, TEMPHYDRO) \
+    X(0x5a6d, 88, BTHR918N,  CHECKSUM5, TEMPHYDROBARO) \
+    X(0xca2c, 80, THGR328N,  CHECKSUM2, TEMPHYDRO) \
+    X(0x5a5d, 88, BTHR918,   CHECKSUM5, TEMPHYDROBARO) \
+    X(0x0a4d, 80, THR128,    CHECKSUM2, TEMP) \
+    X(0x3a0d, 80, WGR918,    CHECKSUM4, ALT_WIND) \
+    X(0x2a1d, 84, RGR918,    CHECKSUM6, RAIN) \
+    X(0xda78, 72, UVN800,    CHECKSUM7, UV)
+
+// Position of each sensor in SENSOR_TYPES, e.g. SENSOR_IDX_THGR810
+enum {
+#define X(type, bits, name, checksum, layout) SENSOR_IDX_##name,
+    SENSOR_LIST(X)
+#undef X
+};
+
+// The positions device keys were first stored with. New sensors go at the
+// end of SENSOR_LIST and here.
+#define SENSOR_POSITIONS(X) \
+    X(THGR810, 0) X(WTGR800_T, 1) X(WTGR800_A, 2) X(WGR800, 3) X(THWR288A, 4) \
+    X(THN132N, 5) X(THGR228N, 6) X(THGR918, 7) X(BTHR918N, 8) X(THGR328N, 9) \
+    X(BTHR918, 10) X(THR128, 11) X(WGR918, 12) X(RGR918, 13) X(UVN800, 14)
+#define X(name, position) \
+    _Static_assert(SENSOR_IDX_##name == (position), "SENSOR_LIST is append only: " #name " moved");
+SENSOR_POSITIONS(X)
+#undef X
+
+static const SensorType SENSOR_TYPES[] = {
+#define X(type, bits, name, checksum, layout) \
+    {SENSOR_KEY(type, bits), SENSOR_IDX_##name, #name, &OREGON_##checksum, &LAYOUT_##layout},
+    SENSOR_LIST(X)
+#undef X
+};
+
+#define SENSOR_COUNT (sizeof(SENSOR_TYPES) / sizeof(SENSOR_TYPES[0]))
+
+// Sensor lookup is a direct-indexed table over a multiplicative hash of the
+// key, so its cost does not depend on the number of sensors. The hash is a
+// constant expression and the table is built by the compiler.
+#define SENSOR_SLOT_BITS 8
+#define SENSOR_SLOT(key) ((uint32_t)((key) * 0x9E3779B1u) >> (32 - SENSOR_SLOT_BITS))
+
+// SENSOR_TYPES index + 1 for each slot; 0 marks an empty slot
+static const uint8_t SENSOR_SLOTS[1 << SENSOR_SLOT_BITS] = {
+#define X(type, bits, name, checksum, layout) [SENSOR_SLOT(SENSOR_KEY(type, bits))] = SENSOR_IDX_##name + 1,
+    SENSOR_LIST(X)
+#undef X
+};
+
+// Never called. Fails to compile with "duplicate case value" if two sensor
+// keys share a slot; change the hash multiplier or SENSOR_SLOT_BITS then.
+static inline void sensor_slot_collision_check(uint32_t slot) {
+    switch (slot) {
+#define X(type, bits, name, checksum, layout) case SENSOR_SLOT(SENSOR_KEY(type, bits)):
+        SENSOR_LIST(X)
+#undef X
+        break;
+    }
 }
 
-static bool checksum5(const uint8_t* b) {
-    uint8_t c = b[10];
-    uint8_t s = (nibble_sum(b, 10) - 0xa) & 0xff;
-    return s == c;
+// Returns the sensor definition for a type id/bit length pair, or NULL.
+static inline const SensorType* find_sensor(uint32_t key) {
+    uint8_t idx = SENSOR_SLOTS[SENSOR_SLOT(key)];
+    if (idx && SENSOR_TYPES[idx - 1].key == key) {
+        return &SENSOR_TYPES[idx - 1];
+    }
+    return NULL;
 }
 
-// ... other checksum functions can be added here as needed ...
+// Matches a payload's type id against the table, trying the frame's bit
+// length and up to two nibbles less, like the Perl script.
+static inline const SensorType* match_sensor(uint16_t type_id, int bits) {
+    const SensorType* found = NULL;
+    for (int b = bits; !found && b >= bits - 8 && b > 0; b -= 4) {
+        found = find_sensor(SENSOR_KEY(type_id, b));
+    }
+    return found;
+}
 
 
 // ==========================================================================
-// SENSOR DECODING METHODS (The main parsers for each sensor type)
+// SPECIALISED DECODERS
 // ==========================================================================
 
-// Forward declarations for function pointers
-struct SensorType;
-typedef OregonReading* (*method_func_t)(const struct SensorType* sensor, const uint8_t* bytes, int* num_readings);
+static inline __attribute__((always_inline))
+OregonStatus decode_layout(const SensorLayout* layout, unsigned sensor, const uint8_t* payload,
+                           OregonReading* readings, int max_readings, int* num_readings) {
+    int count = extract_fields(layout, get_device_key(sensor, payload), payload, readings, max_readings);
+    if (count < 0) {
+        return OREGON_ERR_BUFFER_TOO_SMALL;
+    }
+    *num_readings = count;
+    return OREGON_OK;
+}
 
-typedef struct SensorType {
-    uint32_t key;
-    const char* part_name;
-    bool (*checksum_func)(const uint8_t* bytes);
-    method_func_t method_func;
-} SensorType;
+// One decoder per SENSOR_LIST entry, e.g. decode_THGR228N(). Checksum and
+// layout are compile-time constants here, so each becomes straight-line
+// code with no table reads. Returns OREGON_ERR_CHECKSUM before decoding.
+#define X(type, bits, name, checksum, layout) \
+    static OregonStatus decode_##name(const uint8_t* payload, OregonReading* readings, \
+                                      int max_readings, int* num_readings) { \
+        static const OregonChecksum cs = OREGON_##checksum##_DESC; \
+        if (!oregon_checksum_eval(&cs, payload)) { \
+            return OREGON_ERR_CHECKSUM; \
+        } \
+        return decode_layout(&LAYOUT_##layout, SENSOR_IDX_##name, payload, \
+                             readings, max_readings, num_readings); \
+    }
+SENSOR_LIST(X)
+#undef X
+
+// Dispatches on the sensor index; compiles to a jump table.
+static OregonStatus decode_specialised(const SensorType* sensor, const uint8_t* payload,
+                                       OregonReading* readings, int max_readings, int* num_readings) {
+    switch (sensor->index) {
+#define X(type, bits, name, checksum, layout) \
+        case SENSOR_IDX_##name: return decode_##name(payload, readings, max_readings, num_readings);
+        SENSOR_LIST(X)
+#undef X
+    }
+    return OREGON_ERR_NO_METHOD;
+}
 
-// Generic device string generator
-static void get_device_string(char* buf, size_t len, const char* part_name, const uint8_t* bytes) {
-    snprintf(buf, len, "%s_%02x", part_name, bytes[3]);
-    if (HI_NIBBLE(bytes[2]) > 0) {
-        char channel_buf[10];
-        snprintf(channel_buf, sizeof(channel_buf), "_%d", HI_NIBBLE(bytes[2]));
-        strncat(buf, channel_buf, len - strlen(buf) - 1);
+// The table-driven equivalent, which the specialised decoders must match.
+static OregonStatus decode_generic(const SensorType* sensor, const uint8_t* payload,
+                                   OregonReading* readings, int max_readings, int* num_readings) {
+    if (sensor->checksum && !oregon_checksum_verify(sensor->checksum, payload)) {
+        return OREGON_ERR_CHECKSUM;
+    }
+    if (!sensor->layout) {
+        return OREGON_ERR_NO_METHOD;
     }
+    return decode_layout(sensor->layout, sensor->index, payload, readings, max_readings, num_readings);
 }
 
-// Corresponds to OREGON_common_temphydro
-static OregonReading* method_common_temphydro(const SensorType* sensor, const uint8_t* bytes, int* num_readings) {
-    *num_readings = 3;
-    OregonReading* readings = calloc(*num_readings, sizeof(OregonReading));
-    if (!readings) {
-        *num_readings = 0;
+
+const char* oregon_sensor_name(unsigned sensor) {
+    if (sensor >= SENSOR_COUNT) {
         return NULL;
     }
+    return SENSOR_TYPES[sensor].part_name;
+}
 
-    char dev_str[50];
-    get_device_string(dev_str, sizeof(dev_str), sensor->part_name, bytes);
-    
-    decode_temperature(bytes, dev_str, &readings[0]);
-    decode_humidity(bytes, dev_str, &readings[1]);
-    decode_simple_battery(bytes, dev_str, &readings[2]);
-    
-    return readings;
+
+// ==========================================================================
+// ENCODING (the inverse of the decoders, for test traffic)
+// ==========================================================================
+
+// The low nibble of byte 2 lies between the type id and the channel and is
+// read by no field, so the encoder is free to use it for the checksum.
+#define SPARE_NIBBLE 5
+
+static inline void set_nibble(uint8_t* bytes, unsigned i, unsigned value) {
+    unsigned shift = (~i & 1) << 2;
+    bytes[i >> 1] = (uint8_t)((bytes[i >> 1] & ~(0x0F << shift)) | ((value & 0x0F) << shift));
 }
 
-// Corresponds to OREGON_alt_temphydrobaro
-static OregonReading* method_alt_temphydrobaro(const SensorType* sensor, const uint8_t* bytes, int* num_readings) {
-    *num_readings = 3; // Temp, humidity, pressure. Battery is separate.
-    OregonReading* readings = calloc(*num_readings, sizeof(OregonReading));
-    if (!readings) {
-        *num_readings = 0;
-        return NULL;
+// Index of the first entry of a 16-entry table equal to value, or -1.
+static int lut_index(const uint8_t* lut, uint8_t value) {
+    for (int i = 0; i < 16; i++) {
+        if (lut[i] == value) {
+            return i;
+        }
     }
+    return -1;
+}
 
-    char dev_str[50];
-    get_device_string(dev_str, sizeof(dev_str), sensor->part_name, bytes);
-    
-    decode_temperature(bytes, dev_str, &readings[0]);
-    decode_humidity(bytes, dev_str, &readings[1]);
-    // Note: The perl code for BTHR918N has a separate decode_percentage_battery,
-    // and passes specific offsets to pressure. This is a simplified version.
-    decode_pressure(bytes, dev_str, 856, HI_NIBBLE(bytes[9]), &readings[2]);
-    // For simplicity, we are not decoding percentage battery here.
-    
-    return readings;
+// Inverse of extract_field(). The value is rounded to the field's last digit
+// and split over the digits greedily, most significant first; a value out of
+// range saturates its digits. r may be NULL, which encodes 0 and the first
+// table entries.
+static void encode_field(const FieldDesc* d, const OregonReading* r, uint8_t* bytes) {
+    if (d->unit != OREGON_UNIT_NONE && d->num_digits > 0) {
+        int32_t value = r ? r->value : 0;
+        bool negative = value < 0 && d->sign_mask;
+        if (negative) {
+            value = -value;
+        }
+        int32_t rest = value - d->offset + d->digits[d->num_digits - 1].weight / 2;
+        bool nonzero = false;
+        for (int k = 0; k < d->num_digits; k++) {
+            int32_t digit = rest / d->digits[k].weight;
+            digit = digit < 0 ? 0 : digit > 15 ? 15 : digit;
+            rest -= digit * d->digits[k].weight;
+            set_nibble(bytes, d->digits[k].nibble, (unsigned)digit);
+            nonzero |= digit != 0;
+        }
+        // No sign on a value that rounded to zero, so that it reads back as 0
+        if (negative && nonzero) {
+            set_nibble(bytes, d->sign_nibble, NIB(bytes, d->sign_nibble) | d->sign_mask);
+        }
+    }
+
+    if (d->state_lut && !d->lut_from_value) {
+        int index = lut_index(d->state_lut, r ? r->state : d->state_lut[0]);
+        if (index >= 0) {
+            set_nibble(bytes, d->lut_nibble, (unsigned)index);
+        }
+    }
+    if (d->forecast_lut) {
+        int index = lut_index(d->forecast_lut, r ? r->forecast : d->forecast_lut[0]);
+        if (index >= 0) {
+            set_nibble(bytes, d->lut_nibble, (unsigned)index);
+        }
+    }
+}
+
+// Fills in the check nibbles of a payload. A nibble sum that covers one of
+// its own check nibbles (CHECKSUM1) cannot always be met by the check
+// nibbles alone; the spare nibble makes up the difference then.
+// Returns false if no assignment passes.
+static bool encode_checksum(const OregonChecksum* cs, uint8_t* bytes) {
+    set_nibble(bytes, cs->check_lo, 0);
+    set_nibble(bytes, cs->check_hi, 0);
+    bool lo_covered = cs->check_lo < cs->nibbles;
+    bool hi_covered = cs->check_hi < cs->nibbles;
+
+    // With both check nibbles 0 the sum is base; every covered check nibble
+    // then adds its own value to both sides of sum == lo | hi << 4.
+    unsigned spare = NIB(bytes, SPARE_NIBBLE);
+    unsigned base = oregon_nibble_sum(bytes, cs->nibbles) - spare - cs->offset;
+    for (unsigned s = 0; s < 16; s++) {
+        for (unsigned hi = 0; hi < 16; hi++) {
+            unsigned lo = (base + s + (hi_covered ? hi : 0) - 16 * hi) & 0xFF;
+            if (lo_covered ? lo != 0 : lo > 15) {
+                continue;
+            }
+            set_nibble(bytes, SPARE_NIBBLE, s);
+            set_nibble(bytes, cs->check_lo, lo);
+            set_nibble(bytes, cs->check_hi, hi);
+            return oregon_checksum_eval(cs, bytes);
+        }
+    }
+    return false;
 }
 
-// ... other method functions can be added here ...
+OregonStatus oregon_encode_frame(uint32_t device, const OregonReading* readings, int num_readings,
+                                 OregonFrame* frame) {
+    unsigned index = OREGON_DEVICE_SENSOR(device);
+    if (index >= SENSOR_COUNT) {
+        return OREGON_ERR_UNKNOWN_SENSOR;
+    }
+    const SensorType* sensor = &SENSOR_TYPES[index];
+
+    frame->bits = (uint16_t)(sensor->key & 0xFFFF);
+    frame->version = 2;
+    frame->rssi = 0;
+    memset(frame->data, 0, sizeof(frame->data));
+
+    uint8_t* bytes = frame->data;
+    bytes[0] = (uint8_t)(sensor->key >> 24);
+    bytes[1] = (uint8_t)(sensor->key >> 16);
+    set_nibble(bytes, 4, OREGON_DEVICE_CHANNEL(device));
+    bytes[3] = (uint8_t)OREGON_DEVICE_ROLLING_CODE(device);
+
+    const SensorLayout* layout = sensor->layout;
+    for (int f = 0; f < layout->num_fields; f++) {
+        const FieldDesc* d = &layout->fields[f];
+        const OregonReading* r = NULL;
+        for (int i = 0; i < num_readings && !r; i++) {
+            if (readings[i].type == d->type) {
+                r = &readings[i];
+            }
+        }
+        encode_field(d, r, bytes);
+    }
+
+    if (sensor->checksum && !encode_checksum(sensor->checksum, bytes)) {
+        return OREGON_ERR_CHECKSUM;
+    }
+    return OREGON_OK;
+}
 
 
 // ==========================================================================
-// SENSOR DEFINITIONS TABLE (Equivalent to the %types hash)
+// OUTPUT NAMES
 // ==========================================================================
 
-// Key is generated as: (type << 16) | bits
-// Example: type=0xfa28, bits=80 -> 0xfa280050
-static const SensorType SENSOR_TYPES[] = {
-    {0xfa280050, "THGR810",    checksum2, method_common_temphydro},
-    {0xfab80050, "WTGR800_T",  checksum2, method_common_temphydro}, // using common for simplicity
-    {0x1a990058, "WTGR800_A",  checksum4, NULL}, // Method not implemented
-    {0x1a890058, "WGR800",     checksum4, NULL}, // Method not implemented
-    {0xea4c0050, "THWR288A",   checksum1, NULL}, // Method not implemented
-    {0xea4c0040, "THN132N",    checksum1, NULL}, // Method not implemented
-    {0x1a2d0050, "THGR228N",   checksum2, method_common_temphydro},
-    {0x1a3d0050, "THGR918",    checksum2, method_common_temphydro},
-    {0x5a6d0058, "BTHR918N",   checksum5, method_alt_temphydrobaro},
-    {0xca2c0050, "THGR328N",   checksum2, method_common_temphydro},
+static const char* const READING_TYPE_NAMES[OREGON_READING_TYPE_COUNT] = {
+    [OREGON_READING_TEMPERATURE] = "temperature",
+    [OREGON_READING_HUMIDITY]    = "humidity",
+    [OREGON_READING_BATTERY]     = "battery_status",
+    [OREGON_READING_PRESSURE]    = "pressure",
+    [OREGON_READING_BATTERY_LEVEL]  = "battery_level",
+    [OREGON_READING_WIND_SPEED]     = "wind_speed",
+    [OREGON_READING_WIND_AVERAGE]   = "wind_average",
+    [OREGON_READING_WIND_DIRECTION] = "wind_direction",
+    [OREGON_READING_RAIN_RATE]      = "rain_rate",
+    [OREGON_READING_RAIN_TOTAL]     = "rain_total",
+    [OREGON_READING_UV]             = "uv",
 };
-static const int NUM_SENSOR_TYPES = sizeof(SENSOR_TYPES) / sizeof(SENSOR_TYPES[0]);
+
+static const char* const UNIT_NAMES[OREGON_UNIT_COUNT] = {
+    [OREGON_UNIT_NONE]    = "",
+    [OREGON_UNIT_CELSIUS] = "C",
+    [OREGON_UNIT_PERCENT] = "%",
+    [OREGON_UNIT_HPA]     = "hPa",
+    [OREGON_UNIT_MPS]     = "m/s",
+    [OREGON_UNIT_DEGREES] = "degrees",
+    [OREGON_UNIT_MM_PER_HOUR] = "mm/h",
+    [OREGON_UNIT_MM]      = "mm",
+    [OREGON_UNIT_UV_INDEX] = "UVI",
+};
+
+static const char* const STATE_NAMES[OREGON_STATE_COUNT] = {
+    [OREGON_STATE_NONE]        = "",
+    [OREGON_STATE_NORMAL]      = "normal",
+    [OREGON_STATE_COMFORTABLE] = "comfortable",
+    [OREGON_STATE_DRY]         = "dry",
+    [OREGON_STATE_WET]         = "wet",
+    [OREGON_STATE_BATTERY_OK]  = "ok",
+    [OREGON_STATE_BATTERY_LOW] = "low",
+    [OREGON_STATE_RISK_LOW]       = "low",
+    [OREGON_STATE_RISK_MEDIUM]    = "medium",
+    [OREGON_STATE_RISK_HIGH]      = "high",
+    [OREGON_STATE_RISK_VERY_HIGH] = "very_high",
+    [OREGON_STATE_RISK_DANGEROUS] = "dangerous",
+};
+
+static const char* const FORECAST_NAMES[OREGON_FORECAST_COUNT] = {
+    [OREGON_FORECAST_NONE]    = "",
+    [OREGON_FORECAST_SUNNY]   = "sunny",
+    [OREGON_FORECAST_PARTLY]  = "partly",
+    [OREGON_FORECAST_CLOUDY]  = "cloudy",
+    [OREGON_FORECAST_RAIN]    = "rain",
+    [OREGON_FORECAST_UNKNOWN] = "unknown",
+};
+
+const char* oregon_reading_type_str(OregonReadingType type) {
+    return (unsigned)type < OREGON_READING_TYPE_COUNT ? READING_TYPE_NAMES[type] : "unknown";
+}
+
+const char* oregon_unit_str(OregonUnit unit) {
+    return (unsigned)unit < OREGON_UNIT_COUNT ? UNIT_NAMES[unit] : "";
+}
+
+const char* oregon_state_str(OregonState state) {
+    return (unsigned)state < OREGON_STATE_COUNT ? STATE_NAMES[state] : "";
+}
+
+const char* oregon_forecast_str(OregonForecast forecast) {
+    return (unsigned)forecast < OREGON_FORECAST_COUNT ? FORECAST_NAMES[forecast] : "";
+}
+
+int oregon_device_name(uint32_t device, char* buf, size_t size) {
+    const char* name = oregon_sensor_name(OREGON_DEVICE_SENSOR(device));
+    unsigned channel = OREGON_DEVICE_CHANNEL(device);
+    if (channel > 0) {
+        return snprintf(buf, size, "%s_%02x_%u", name ? name : "unknown",
+                        OREGON_DEVICE_ROLLING_CODE(device), channel);
+    }
+    return snprintf(buf, size, "%s_%02x", name ? name : "unknown", OREGON_DEVICE_ROLLING_CODE(device));
+}
 
 
 // ==========================================================================
 // MAIN PARSING LOGIC (Equivalent to OREGON_Parse)
 // ==========================================================================
 
-void print_readings(const OregonReading* readings, int count) {
+const char* oregon_status_str(OregonStatus status) {
+    switch (status) {
+        case OREGON_OK:                   return "ok";
+        case OREGON_ERR_BAD_PREFIX:       return "bad_prefix";
+        case OREGON_ERR_BAD_HEX:          return "bad_hex";
+        case OREGON_ERR_NO_PREAMBLE:      return "no_preamble";
+        case OREGON_ERR_TOO_SHORT:        return "too_short";
+        case OREGON_ERR_UNKNOWN_SENSOR:   return "unknown_sensor";
+        case OREGON_ERR_CHECKSUM:         return "checksum";
+        case OREGON_ERR_NO_METHOD:        return "no_method";
+        case OREGON_ERR_BUFFER_TOO_SMALL: return "buffer_too_small";
+        case OREGON_STATUS_COUNT:         break;
+    }
+    return "unknown";
+}
+
+typedef OregonStatus (*decode_func_t)(const SensorType* sensor, const uint8_t* payload,
+                                      OregonReading* readings, int max_readings, int* num_readings);
+
+static inline __attribute__((always_inline))
+OregonStatus decode_frame_with(decode_func_t decode, const OregonFrame* frame, OregonMessageInfo* info,
+                               OregonReading* readings, int max_readings, int* num_readings) {
+    OregonMessageInfo local_info;
+    if (!info) {
+        info = &local_info;
+    }
+    memset(info, 0, sizeof(*info));
+    info->protocol = frame->version;
+    *num_readings = 0;
+
+    // The payload must at least hold the two sensor type id bytes.
+    if (frame->bits < 16) {
+        return OREGON_ERR_TOO_SHORT;
+    }
+
+    int bits = frame->bits;
+    const uint8_t* payload = frame->data;
+    
+    uint16_t type_id = (payload[0] << 8) | payload[1];
+    info->bits = bits;
+    info->type_id = type_id;
+    
+    const SensorType* found_sensor = match_sensor(type_id, bits);
+    if (!found_sensor) {
+        return OREGON_ERR_UNKNOWN_SENSOR;
+    }
+    info->sensor = found_sensor->part_name;
+
+    // Validate the checksum, then decode
+    OregonStatus status = decode(found_sensor, payload, readings, max_readings, num_readings);
+    info->checksum_checked = status != OREGON_ERR_CHECKSUM && found_sensor->checksum;
+    return status;
+}
+
+OregonStatus oregon_decode_frame(const OregonFrame* frame, OregonMessageInfo* info,
+                                 OregonReading* readings, int max_readings, int* num_readings) {
+    OREGON_STATS_BEGIN(start);
+    OregonStatus status = decode_frame_with(decode_specialised, frame, info, readings, max_readings,
+                                            num_readings);
+    OREGON_STATS_END(OREGON_STAGE_DECODE, status, start);
+    return status;
+}
+
+OregonStatus oregon_decode_frame_generic(const OregonFrame* frame, OregonMessageInfo* info,
+                                         OregonReading* readings, int max_readings, int* num_readings) {
+    OREGON_STATS_BEGIN(start);
+    OregonStatus status = decode_frame_with(decode_generic, frame, info, readings, max_readings,
+                                            num_readings);
+    OREGON_STATS_END(OREGON_STAGE_DECODE, status, start);
+    return status;
+}
+
+// Rebuilds a frame from its hex rendering. The first byte is the bit length.
+static OregonStatus hex_to_frame(const char* hex_msg, OregonFrame* frame) {
+    uint8_t msg_bytes[1 + OREGON_FRAME_MAX_BYTES];
+
+    int num_bytes_total = hex_to_bytes(hex_msg, msg_bytes, sizeof(msg_bytes));
+    if (num_bytes_total < 3) {
+        return OREGON_ERR_TOO_SHORT;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+    frame->bits = msg_bytes[0];
+    memcpy(frame->data, &msg_bytes[1], num_bytes_total - 1);
+    return OREGON_OK;
+}
+
+OregonStatus oregon_decode(const char* hex_msg, OregonMessageInfo* info,
+                           OregonReading* readings, int max_readings, int* num_readings) {
+    OregonFrame frame;
+
+    OregonStatus status = hex_to_frame(hex_msg, &frame);
+    if (status != OREGON_OK) {
+        if (info) {
+            memset(info, 0, sizeof(*info));
+        }
+        *num_readings = 0;
+        return status;
+    }
+    return oregon_decode_frame(&frame, info, readings, max_readings, num_readings);
+}
+
+OregonStatus oregon_decode_cul(const char* cul_msg, OregonMessageInfo* info,
+                               OregonReading* readings, int max_readings, int* num_readings) {
+    OregonFrame frame;
+
+    OregonStatus status = cul_preprocess_frame(cul_msg, &frame);
+    if (status != OREGON_OK) {
+        if (info) {
+            memset(info, 0, sizeof(*info));
+        }
+        *num_readings = 0;
+        return status;
+    }
+    return oregon_decode_frame(&frame, info, readings, max_readings, num_readings);
+}
+
+
+// ==========================================================================
+// PRINTING WRAPPERS
+// ==========================================================================
+
+void fprint_readings(FILE* out, const OregonReading* readings, int count) {
     if (count <= 0 || !readings) return;
     
-    printf("--- Decoded Sensor: %s ---\n", readings[0].device);
+    char device[64];
+    oregon_device_name(readings[0].device, device, sizeof(device));
+    fprint_device_readings(out, device, readings, count);
+}
+
+void fprint_device_readings(FILE* out, const char* device_name, const OregonReading* readings, int count) {
+    if (count <= 0 || !readings) return;
+
+    fprintf(out, "--- Decoded Sensor: %s ---\n", device_name);
     for(int i = 0; i < count; i++) {
         const OregonReading* r = &readings[i];
-        printf("  - Type: %s\n", r->type);
-        if (strlen(r->units) > 0) {
-            printf("    Value: %.2f %s\n", r->current, r->units);
+        fprintf(out, "  - Type: %s\n", oregon_reading_type_str(r->type));
+        if (r->unit != OREGON_UNIT_NONE) {
+            fprintf(out, "    Value: %.2f %s\n", (double)r->value / OREGON_VALUE_SCALE,
+                    oregon_unit_str(r->unit));
         }
-        if (strlen(r->string_val) > 0) {
-            printf("    State: %s\n", r->string_val);
+        if (r->state != OREGON_STATE_NONE) {
+            fprintf(out, "    State: %s\n", oregon_state_str(r->state));
         }
-        if (strlen(r->forecast) > 0) {
-            printf("    Forecast: %s\n", r->forecast);
+        if (r->forecast != OREGON_FORECAST_NONE) {
+            fprintf(out, "    Forecast: %s\n", oregon_forecast_str(r->forecast));
         }
     }
-    printf("---------------------------------------\n");
+    fprintf(out, "---------------------------------------\n");
 }
 
-void parse_oregon_message(const char* hex_msg) {
-    uint8_t msg_bytes[32]; // Buffer for raw bytes
-    
-    // The first byte of the message is the length in bits.
-    // The rest is the payload.
-    int num_bytes_total = hex_to_bytes(hex_msg, msg_bytes, sizeof(msg_bytes));
+void print_readings(const OregonReading* readings, int count) {
+    fprint_readings(stdout, readings, count);
+}
 
-    if (num_bytes_total < 3) {
+// Prints the outcome of a decode the way the command line tools show it.
+static void print_decode_result(const char* hex_msg, OregonStatus status, const OregonMessageInfo* info,
+                                const OregonReading* readings, int num_readings) {
+    if (status == OREGON_ERR_TOO_SHORT) {
         fprintf(stderr, "Error: Invalid or too short hex message.\n");
         return;
     }
 
-    int bits = msg_bytes[0];
-    const uint8_t* payload = &msg_bytes[1];
-    
-    uint16_t type_id = (payload[0] << 8) | payload[1];
-    
     printf("Received Message: %s\n", hex_msg);
-    printf("Parsing... Bits: %d, Sensor Type ID: 0x%04x\n", bits, type_id);
-    
-    const SensorType* found_sensor = NULL;
-    
-    // Search for the sensor type, trying different bit lengths like in the Perl script
-    for (int b = bits; b >= bits - 8 && b > 0; b -= 4) {
-        uint32_t key = ((uint32_t)type_id << 16) | b;
-        for (int i = 0; i < NUM_SENSOR_TYPES; i++) {
-            if (SENSOR_TYPES[i].key == key) {
-                found_sensor = &SENSOR_TYPES[i];
-                goto found;
-            }
-        }
-    }
-    
-found:
-    if (!found_sensor) {
+    printf("Parsing... Bits: %d, Sensor Type ID: 0x%04x\n", info->bits, info->type_id);
+
+    if (status == OREGON_ERR_UNKNOWN_SENSOR) {
         fprintf(stderr, "Error: Unknown sensor type/bit length combination.\n");
         return;
     }
 
-    printf("Found Sensor Definition: %s\n", found_sensor->part_name);
+    printf("Found Sensor Definition: %s\n", info->sensor);
 
-    // 2. Validate Checksum
-    if (found_sensor->checksum_func) {
-        if (!found_sensor->checksum_func(payload)) {
-            fprintf(stderr, "Error: Checksum validation failed!\n");
-            return;
-        }
+    if (status == OREGON_ERR_CHECKSUM) {
+        fprintf(stderr, "Error: Checksum validation failed!\n");
+        return;
+    }
+    if (info->checksum_checked) {
         printf("Checksum OK.\n");
     } else {
         printf("Warning: No checksum function defined for this sensor.\n");
     }
 
-    // 3. Decode message
-    if (found_sensor->method_func) {
-        int num_readings = 0;
-        OregonReading* readings = found_sensor->method_func(found_sensor, payload, &num_readings);
-        
-        if (readings) {
-            print_readings(readings, num_readings);
-            free(readings); // Free the memory allocated by the method function
-        }
-    } else {
-        printf("Notice: No decoding method implemented for '%s'.\n", found_sensor->part_name);
+    if (status == OREGON_ERR_NO_METHOD) {
+        printf("Notice: No decoding method implemented for '%s'.\n", info->sensor);
+        return;
+    }
+    if (status != OREGON_OK) {
+        fprintf(stderr, "Error: %s\n", oregon_status_str(status));
+        return;
     }
-}
\ No newline at end of file
+
+    print_readings(readings, num_readings);
+}
+
+void parse_oregon_frame(const OregonFrame* frame) {
+    OregonMessageInfo info;
+    OregonReading readings[OREGON_MAX_READINGS];
+    int num_readings = 0;
+    char hex_msg[CUL_HEX_OUTPUT_SIZE];
+
+    OregonStatus status = oregon_decode_frame(frame, &info, readings, OREGON_MAX_READINGS, &num_readings);
+    cul_frame_to_hex(frame, hex_msg, sizeof(hex_msg));
+    print_decode_result(hex_msg, status, &info, readings, num_readings);
+}
+
+void parse_oregon_message(const char* hex_msg) {
+    OregonMessageInfo info;
+    OregonReading readings[OREGON_MAX_READINGS];
+    int num_readings = 0;
+
+    OregonStatus status = oregon_decode(hex_msg, &info, readings, OREGON_MAX_READINGS, &num_readings);
+    print_decode_result(hex_msg, status, &info, readings, num_readings);
+}
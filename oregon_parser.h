@@ -1,21 +1,167 @@
 #ifndef OREGON_PARSER_H
 #define OREGON_PARSER_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "oregon_status.h"
+#include "cul_preprocessor.h"
 
-// Structure to hold a single decoded sensor reading
+// Largest number of readings a single message can decode into.
+#define OREGON_MAX_READINGS 8
+
+// What a reading measures.
+typedef enum {
+    OREGON_READING_TEMPERATURE,
+    OREGON_READING_HUMIDITY,
+    OREGON_READING_BATTERY,
+    OREGON_READING_PRESSURE,
+    OREGON_READING_BATTERY_LEVEL,
+    OREGON_READING_WIND_SPEED,      // Gust speed
+    OREGON_READING_WIND_AVERAGE,
+    OREGON_READING_WIND_DIRECTION,
+    OREGON_READING_RAIN_RATE,
+    OREGON_READING_RAIN_TOTAL,
+    OREGON_READING_UV,
+    OREGON_READING_TYPE_COUNT
+} OregonReadingType;
+
+// Unit of a reading's value; OREGON_UNIT_NONE if it has no value.
+typedef enum {
+    OREGON_UNIT_NONE,
+    OREGON_UNIT_CELSIUS,
+    OREGON_UNIT_PERCENT,
+    OREGON_UNIT_HPA,
+    OREGON_UNIT_MPS,
+    OREGON_UNIT_DEGREES,
+    OREGON_UNIT_MM_PER_HOUR,
+    OREGON_UNIT_MM,
+    OREGON_UNIT_UV_INDEX,
+    OREGON_UNIT_COUNT
+} OregonUnit;
+
+// Discrete state reported alongside or instead of a value.
+typedef enum {
+    OREGON_STATE_NONE,
+    OREGON_STATE_NORMAL,        // Humidity comfort levels
+    OREGON_STATE_COMFORTABLE,
+    OREGON_STATE_DRY,
+    OREGON_STATE_WET,
+    OREGON_STATE_BATTERY_OK,
+    OREGON_STATE_BATTERY_LOW,
+    OREGON_STATE_RISK_LOW,      // UV risk levels
+    OREGON_STATE_RISK_MEDIUM,
+    OREGON_STATE_RISK_HIGH,
+    OREGON_STATE_RISK_VERY_HIGH,
+    OREGON_STATE_RISK_DANGEROUS,
+    OREGON_STATE_COUNT
+} OregonState;
+
+typedef enum {
+    OREGON_FORECAST_NONE,
+    OREGON_FORECAST_SUNNY,
+    OREGON_FORECAST_PARTLY,
+    OREGON_FORECAST_CLOUDY,
+    OREGON_FORECAST_RAIN,
+    OREGON_FORECAST_UNKNOWN,
+    OREGON_FORECAST_COUNT
+} OregonForecast;
+
+// A device is identified by its sensor definition, rolling code and channel,
+// packed into one integer: sensor index << 16 | rolling code << 8 | channel.
+// The sensor index is the sensor's position in the decoder's sensor table,
+// which is append only because reading archives store these keys.
+#define OREGON_DEVICE_KEY(sensor, rolling_code, channel) \
+    (((uint32_t)(sensor) << 16) | ((uint32_t)(rolling_code) << 8) | (uint32_t)(channel))
+#define OREGON_DEVICE_SENSOR(key)       ((key) >> 16)
+#define OREGON_DEVICE_ROLLING_CODE(key) (((key) >> 8) & 0xFF)
+#define OREGON_DEVICE_CHANNEL(key)      ((key) & 0xFF)
+
+// Reading values are fixed point with this many units per unit (0.01 steps).
+#define OREGON_VALUE_SCALE 100
+
+// A single decoded sensor reading. Strings are only produced on output,
+// through the *_str() and oregon_device_name() lookups below.
 typedef struct {
-    char device[50];
-    char type[25];
-    double current;
-    double average;
-    char string_val[25];
-    char units[15];
-    char forecast[15];
-    char risk[15];
+    uint32_t device;     // OREGON_DEVICE_KEY()
+    int32_t value;       // Value * OREGON_VALUE_SCALE, 0 if unit is OREGON_UNIT_NONE
+    uint8_t type;        // OregonReadingType
+    uint8_t unit;        // OregonUnit
+    uint8_t state;       // OregonState
+    uint8_t forecast;    // OregonForecast
 } OregonReading;
 
+// Details about a message that are known even when decoding fails part way.
+typedef struct {
+    uint8_t protocol;       // Oregon protocol version of the frame, 0 if none was found
+    int bits;               // Bit length taken from the message header
+    uint16_t type_id;       // Sensor type id from the first two payload bytes
+    const char* sensor;     // Matched sensor part name, NULL if unknown
+    bool checksum_checked;  // False if the sensor defines no checksum function
+} OregonMessageInfo;
+
+// Decodes a frame from cul_preprocess_frame() into the caller's readings array.
+// Reentrant: uses no heap and no stdio. The only global state is the
+// per-thread statistics (oregon_stats.h), registered on a thread's first call.
+// info (optional) is filled as far as decoding got; *num_readings is set to
+// the number of readings written. Returns OREGON_OK or the failure reason.
+OregonStatus oregon_decode_frame(const OregonFrame* frame, OregonMessageInfo* info,
+                                 OregonReading* readings, int max_readings, int* num_readings);
+
+// oregon_decode_frame() goes through a decoder generated per sensor from the
+// sensor table. This is the same decode driven by the table at runtime; it
+// gives identical results and is kept as a reference for benchmarks.
+OregonStatus oregon_decode_frame_generic(const OregonFrame* frame, OregonMessageInfo* info,
+                                         OregonReading* readings, int max_readings, int* num_readings);
+
+// Same as oregon_decode_frame(), for a hex string (e.g., "fa28...") in the
+// format rendered by cul_frame_to_hex().
+OregonStatus oregon_decode(const char* hex_msg, OregonMessageInfo* info,
+                           OregonReading* readings, int max_readings, int* num_readings);
+
+// Runs both stages on a raw CUL message (e.g., "omAAAA...") with the same
+// guarantees and outputs as oregon_decode().
+OregonStatus oregon_decode_cul(const char* cul_msg, OregonMessageInfo* info,
+                               OregonReading* readings, int max_readings, int* num_readings);
+
+// Names used on output, e.g. "temperature", "C", "comfortable", "sunny".
+// Empty for the NONE values.
+const char* oregon_reading_type_str(OregonReadingType type);
+const char* oregon_unit_str(OregonUnit unit);
+const char* oregon_state_str(OregonState state);
+const char* oregon_forecast_str(OregonForecast forecast);
+
+// Part name of a sensor index from OREGON_DEVICE_SENSOR(), or NULL.
+const char* oregon_sensor_name(unsigned sensor);
+
+// Builds the frame a device would send for the given readings: the inverse
+// of oregon_decode_frame(), meant for generating test traffic. The device
+// key picks the sensor, rolling code and channel (0-15). Readings are
+// matched to the sensor's fields by type; a field without one encodes 0.
+// Values are rounded to what the payload holds and saturate out of range.
+// The checksum is filled in. frame->version is set to 2 and frame->rssi to
+// 0, for the caller to change before cul_encode_frame().
+// Returns OREGON_OK, or OREGON_ERR_UNKNOWN_SENSOR for a bad sensor index.
+OregonStatus oregon_encode_frame(uint32_t device, const OregonReading* readings, int num_readings,
+                                 OregonFrame* frame);
+
+// Writes the device name (e.g. "THGR810_a3_1": part name, rolling code and,
+// if not 0, channel) to buf. Returns the snprintf() result.
+int oregon_device_name(uint32_t device, char* buf, size_t size);
+
+// Prints a block of readings belonging to one device.
+void print_readings(const OregonReading* readings, int count);
+
+// Same as print_readings(), writing to the given stream.
+void fprint_readings(FILE* out, const OregonReading* readings, int count);
+
+// Same as fprint_readings(), with the device name already known, e.g. from
+// a device registry.
+void fprint_device_readings(FILE* out, const char* device_name, const OregonReading* readings, int count);
+
+// Parses a frame from cul_preprocess_frame() and prints the decoded data.
+void parse_oregon_frame(const OregonFrame* frame);
+
 // Main entry point for parsing a message
 // Takes a hex string (e.g., "fa28...") and prints the decoded data.
 void parse_oregon_message(const char* hex_msg);
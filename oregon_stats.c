@@ -0,0 +1,130 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "oregon_stats.h"
+
+static const char* const STAGE_NAMES[OREGON_STAGE_COUNT] = {
+    [OREGON_STAGE_PREPROCESS] = "preprocess",
+    [OREGON_STAGE_DECODE]     = "decode",
+    [OREGON_STAGE_CACHE_HIT]  = "cache_hit",
+};
+
+const char* oregon_stage_str(OregonStage stage) {
+    return (unsigned)stage < OREGON_STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+#ifdef OREGON_NO_STATS
+
+void oregon_stats_set_timers(bool enabled) {
+    (void)enabled;
+}
+
+void oregon_stats_snapshot(OregonStatsSnapshot* snap) {
+    memset(snap, 0, sizeof(*snap));
+}
+
+#else
+
+bool oregon_stats_timers = false;
+_Thread_local OregonStatsBlock* oregon_stats_local = NULL;
+
+// Each thread counts into a block in its own thread-local storage, so
+// attaching allocates nothing. Live threads' blocks are linked here; when a
+// thread exits, retire_block() folds its counts into `retired` and unlinks
+// the block before the storage goes away.
+static _Thread_local OregonStatsBlock thread_block;
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+static OregonStatsBlock* blocks = NULL;
+static OregonStageStats retired[OREGON_STAGE_COUNT];
+static unsigned retired_threads = 0;
+static pthread_key_t retire_key;
+static pthread_once_t retire_once = PTHREAD_ONCE_INIT;
+static bool retire_key_ok = false;
+
+static void add_block(OregonStageStats* stages, const OregonStatsBlock* b) {
+    for (int s = 0; s < OREGON_STAGE_COUNT; s++) {
+        OregonStageStats* st = &stages[s];
+        st->calls += atomic_load_explicit(&b->calls[s], memory_order_relaxed);
+        st->cycles += atomic_load_explicit(&b->cycles[s], memory_order_relaxed);
+        for (int k = 0; k < OREGON_STATUS_COUNT; k++) {
+            st->by_status[k] += atomic_load_explicit(&b->by_status[s][k], memory_order_relaxed);
+        }
+    }
+}
+
+// Thread exit: keeps the block's counts in the totals and forgets the block.
+static void retire_block(void* arg) {
+    OregonStatsBlock* b = arg;
+    pthread_mutex_lock(&blocks_lock);
+    for (OregonStatsBlock** p = &blocks; *p; p = &(*p)->next) {
+        if (*p == b) {
+            *p = b->next;
+            add_block(retired, b);
+            retired_threads++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&blocks_lock);
+    oregon_stats_local = NULL;
+}
+
+static void create_retire_key(void) {
+    retire_key_ok = pthread_key_create(&retire_key, retire_block) == 0;
+}
+
+void oregon_stats_set_timers(bool enabled) {
+    oregon_stats_timers = enabled;
+}
+
+OregonStatsBlock* oregon_stats_attach(void) {
+    OregonStatsBlock* b = &thread_block;
+    pthread_once(&retire_once, create_retire_key);
+    // Without the destructor the block would outlive its thread in the list;
+    // count into it anyway, unreported, rather than retry on every call.
+    if (retire_key_ok && pthread_setspecific(retire_key, b) == 0) {
+        pthread_mutex_lock(&blocks_lock);
+        b->next = blocks;
+        blocks = b;
+        pthread_mutex_unlock(&blocks_lock);
+    }
+    oregon_stats_local = b;
+    return b;
+}
+
+void oregon_stats_snapshot(OregonStatsSnapshot* snap) {
+    memset(snap, 0, sizeof(*snap));
+    snap->timers = oregon_stats_timers;
+
+    pthread_mutex_lock(&blocks_lock);
+    memcpy(snap->stages, retired, sizeof(retired));
+    snap->threads = retired_threads;
+    for (const OregonStatsBlock* b = blocks; b; b = b->next) {
+        snap->threads++;
+        add_block(snap->stages, b);
+    }
+    pthread_mutex_unlock(&blocks_lock);
+}
+
+#endif // OREGON_NO_STATS
+
+// {"time":...,"threads":2,"timers":false,"stages":{"preprocess":{"calls":4550,
+// "cycles":0,"status":{"ok":3687,"no_preamble":863}},...}}; zero counts are left out.
+void oregon_stats_write_json(FILE* out, const OregonStatsSnapshot* snap, uint64_t time_ms) {
+    fprintf(out, "{\"time\":%llu,\"threads\":%u,\"timers\":%s,\"stages\":{",
+            (unsigned long long)time_ms, snap->threads, snap->timers ? "true" : "false");
+    for (int s = 0; s < OREGON_STAGE_COUNT; s++) {
+        const OregonStageStats* st = &snap->stages[s];
+        fprintf(out, "%s\"%s\":{\"calls\":%llu,\"cycles\":%llu,\"status\":{", s ? "," : "",
+                STAGE_NAMES[s], (unsigned long long)st->calls, (unsigned long long)st->cycles);
+        bool first = true;
+        for (int k = 0; k < OREGON_STATUS_COUNT; k++) {
+            if (st->by_status[k]) {
+                fprintf(out, "%s\"%s\":%llu", first ? "" : ",", oregon_status_str((OregonStatus)k),
+                        (unsigned long long)st->by_status[k]);
+                first = false;
+            }
+        }
+        fprintf(out, "}}");
+    }
+    fprintf(out, "}}\n");
+}
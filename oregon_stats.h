@@ -0,0 +1,115 @@
+#ifndef OREGON_STATS_H
+#define OREGON_STATS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "oregon_status.h"
+
+// Counters of every decode stage and outcome, kept per thread and merged
+// on demand. Build with -DOREGON_NO_STATS to compile the instrumentation
+// out of the decoder entirely.
+
+typedef enum {
+    OREGON_STAGE_PREPROCESS,    // cul_preprocess_frame()
+    OREGON_STAGE_DECODE,        // oregon_decode_frame() and its generic twin
+    OREGON_STAGE_CACHE_HIT,     // Lines a DecodeCache answered without either stage
+    OREGON_STAGE_COUNT
+} OregonStage;
+
+typedef struct {
+    uint64_t calls;
+    uint64_t cycles;            // Only accumulated while timers are enabled
+    uint64_t by_status[OREGON_STATUS_COUNT];
+} OregonStageStats;
+
+// One thread's counters, on cache lines of their own. Written only by that
+// thread, with relaxed stores that compile to plain adds; readers may see a
+// slightly stale total but never a torn one.
+typedef struct OregonStatsBlock {
+    _Alignas(64) _Atomic uint64_t calls[OREGON_STAGE_COUNT];
+    _Atomic uint64_t cycles[OREGON_STAGE_COUNT];
+    _Atomic uint64_t by_status[OREGON_STAGE_COUNT][OREGON_STATUS_COUNT];
+    struct OregonStatsBlock* next;
+} OregonStatsBlock;
+
+typedef struct {
+    unsigned threads;           // Threads that recorded anything
+    bool timers;
+    OregonStageStats stages[OREGON_STAGE_COUNT];
+} OregonStatsSnapshot;
+
+// Enables the per-stage cycle timers (off by default). Set before decoding
+// starts; the counters themselves are always on unless compiled out.
+void oregon_stats_set_timers(bool enabled);
+
+// Sums every thread's counters, including those of threads that exited:
+// their counts are kept when they exit and their blocks are released.
+void oregon_stats_snapshot(OregonStatsSnapshot* snap);
+
+// Writes a snapshot as one line of JSON.
+void oregon_stats_write_json(FILE* out, const OregonStatsSnapshot* snap, uint64_t time_ms);
+
+const char* oregon_stage_str(OregonStage stage);
+
+// ==========================================================================
+// HOT PATH
+// ==========================================================================
+
+#ifdef OREGON_NO_STATS
+
+#define OREGON_STATS_BEGIN(start) ((void)0)
+#define OREGON_STATS_END(stage, status, start) ((void)0)
+
+#else
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t oregon_stats_cycles(void) {
+    return __rdtsc();
+}
+#else
+#include <time.h>
+static inline uint64_t oregon_stats_cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+extern bool oregon_stats_timers;
+extern _Thread_local OregonStatsBlock* oregon_stats_local;
+
+// Registers the calling thread's block, kept in its thread-local storage,
+// on first use. Takes a lock once per thread; nothing is allocated.
+OregonStatsBlock* oregon_stats_attach(void);
+
+static inline void oregon_stats_bump(_Atomic uint64_t* counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+static inline void oregon_stats_record(OregonStage stage, OregonStatus status, uint64_t start) {
+    OregonStatsBlock* b = oregon_stats_local;
+    if (__builtin_expect(!b, 0)) {
+        b = oregon_stats_attach();
+        if (!b) {
+            return;
+        }
+    }
+    oregon_stats_bump(&b->calls[stage], 1);
+    oregon_stats_bump(&b->by_status[stage][status], 1);
+    if (start) {
+        oregon_stats_bump(&b->cycles[stage], oregon_stats_cycles() - start);
+    }
+}
+
+// Declares `start` and reads the clock if timers are on.
+#define OREGON_STATS_BEGIN(start) \
+    uint64_t start = oregon_stats_timers ? oregon_stats_cycles() : 0
+#define OREGON_STATS_END(stage, status, start) oregon_stats_record((stage), (status), (start))
+
+#endif // OREGON_NO_STATS
+
+#endif // OREGON_STATS_H
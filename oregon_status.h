@@ -0,0 +1,22 @@
+#ifndef OREGON_STATUS_H
+#define OREGON_STATUS_H
+
+// Result of a decode call. Shared by the CUL pre-processor (stage 1) and
+// the Oregon parser (stage 2) so a caller can report why a message failed.
+typedef enum {
+    OREGON_OK = 0,
+    OREGON_ERR_BAD_PREFIX,       // CUL message does not start with "om" or is too short
+    OREGON_ERR_BAD_HEX,          // CUL payload has an invalid hex character or is too long
+    OREGON_ERR_NO_PREAMBLE,      // Neither an Oregon V2 nor a V3 preamble was found
+    OREGON_ERR_TOO_SHORT,        // Decoded message is malformed or too short to parse
+    OREGON_ERR_UNKNOWN_SENSOR,   // No sensor definition for this type/bit length combination
+    OREGON_ERR_CHECKSUM,         // Checksum validation failed
+    OREGON_ERR_NO_METHOD,        // Sensor is known but has no decoding method
+    OREGON_ERR_BUFFER_TOO_SMALL, // Caller-provided buffer cannot hold the result
+    OREGON_STATUS_COUNT          // Number of status codes, for per-status tallies
+} OregonStatus;
+
+// Returns a short, static description of a status code.
+const char* oregon_status_str(OregonStatus status);
+
+#endif // OREGON_STATUS_H
@@ -0,0 +1,520 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "output_sink.h"
+
+// Upper bound of the bytes one reading adds in any format, and of the
+// per-message framing. Device names are bounded by OUTPUT_NAME_MAX.
+#define OUTPUT_NAME_MAX    64
+#define OUTPUT_READING_MAX 192
+#define OUTPUT_MESSAGE_MAX 192
+#define OUTPUT_AGGREGATE_MAX 768
+
+_Static_assert(OREGON_VALUE_SCALE == 100, "put_value() prints exactly two decimals");
+
+static const char* const FORMAT_NAMES[OUTPUT_FORMAT_COUNT] = {
+    [OUTPUT_TEXT]   = "text",
+    [OUTPUT_JSON]   = "json",
+    [OUTPUT_CSV]    = "csv",
+    [OUTPUT_INFLUX] = "influx",
+};
+
+bool output_format_parse(const char* name, OutputFormat* format) {
+    for (int f = 0; f < OUTPUT_FORMAT_COUNT; f++) {
+        if (strcmp(name, FORMAT_NAMES[f]) == 0) {
+            *format = (OutputFormat)f;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* output_format_str(OutputFormat format) {
+    return (unsigned)format < OUTPUT_FORMAT_COUNT ? FORMAT_NAMES[format] : "unknown";
+}
+
+int output_sink_init(OutputSink* sink, OutputFormat format, int fd, size_t capacity) {
+    memset(sink, 0, sizeof(*sink));
+    sink->buf = malloc(capacity);
+    if (!sink->buf) {
+        return -1;
+    }
+    sink->format = format;
+    sink->fd = fd;
+    sink->cap = capacity;
+    return 0;
+}
+
+int output_sink_init_arena(OutputSink* sink, OutputFormat format, OregonArena* arena, size_t capacity) {
+    memset(sink, 0, sizeof(*sink));
+    sink->buf = oregon_arena_alloc(arena, capacity);
+    if (!sink->buf) {
+        return -1;
+    }
+    sink->format = format;
+    sink->fd = -1;
+    sink->cap = capacity;
+    sink->arena = arena;
+    return 0;
+}
+
+void output_sink_free(OutputSink* sink) {
+    output_sink_flush(sink);
+    if (!sink->arena) {
+        free(sink->buf);
+    }
+    memset(sink, 0, sizeof(*sink));
+}
+
+int output_sink_flush(OutputSink* sink) {
+    if (sink->fd < 0) {
+        return 0;
+    }
+    size_t done = 0;
+    while (done < sink->len) {
+        ssize_t n = write(sink->fd, sink->buf + done, sink->len - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            sink->failed = true;
+            sink->len = 0;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    sink->len = 0;
+    return 0;
+}
+
+// Makes room for `need` more bytes: flushes a sink with a descriptor,
+// grows one without. Returns false if neither worked.
+static bool reserve(OutputSink* sink, size_t need) {
+    if (sink->len + need <= sink->cap) {
+        return true;
+    }
+    if (sink->fd >= 0) {
+        output_sink_flush(sink);
+        if (need <= sink->cap) {
+            return true;
+        }
+    }
+    size_t cap = sink->cap ? sink->cap : need;
+    while (cap < sink->len + need) {
+        cap *= 2;
+    }
+    char* buf = sink->arena ? oregon_arena_grow(sink->arena, sink->buf, sink->len, cap)
+                            : realloc(sink->buf, cap);
+    if (!buf) {
+        sink->failed = true;
+        return false;
+    }
+    sink->buf = buf;
+    sink->cap = cap;
+    return true;
+}
+
+// ==========================================================================
+// FORMATTERS
+// ==========================================================================
+
+// Each returns the position after what it wrote. Room was reserved up front.
+
+static inline char* put_str(char* p, const char* s) {
+    while (*s) {
+        *p++ = *s++;
+    }
+    return p;
+}
+
+static inline char* put_strn(char* p, const char* s, size_t max) {
+    while (max-- && *s) {
+        *p++ = *s++;
+    }
+    return p;
+}
+
+static char* put_u64(char* p, uint64_t v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) {
+        *p++ = tmp[--n];
+    }
+    return p;
+}
+
+// A fixed-point reading value with two decimals, as printf("%.2f") would.
+static char* put_value(char* p, int32_t value) {
+    uint32_t mag = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    if (value < 0) {
+        *p++ = '-';
+    }
+    p = put_u64(p, mag / 100);
+    *p++ = '.';
+    *p++ = (char)('0' + mag / 10 % 10);
+    *p++ = (char)('0' + mag % 10);
+    return p;
+}
+
+static char* write_text(char* p, const char* device, const OregonReading* readings, int count) {
+    p = put_str(p, "--- Decoded Sensor: ");
+    p = put_strn(p, device, OUTPUT_NAME_MAX);
+    p = put_str(p, " ---\n");
+    for (int i = 0; i < count; i++) {
+        const OregonReading* r = &readings[i];
+        p = put_str(p, "  - Type: ");
+        p = put_str(p, oregon_reading_type_str(r->type));
+        *p++ = '\n';
+        if (r->unit != OREGON_UNIT_NONE) {
+            p = put_str(p, "    Value: ");
+            p = put_value(p, r->value);
+            *p++ = ' ';
+            p = put_str(p, oregon_unit_str(r->unit));
+            *p++ = '\n';
+        }
+        if (r->state != OREGON_STATE_NONE) {
+            p = put_str(p, "    State: ");
+            p = put_str(p, oregon_state_str(r->state));
+            *p++ = '\n';
+        }
+        if (r->forecast != OREGON_FORECAST_NONE) {
+            p = put_str(p, "    Forecast: ");
+            p = put_str(p, oregon_forecast_str(r->forecast));
+            *p++ = '\n';
+        }
+    }
+    return put_str(p, "---------------------------------------\n");
+}
+
+// {"time":1700000000000,"device":"THGR228N_33_1","readings":[{"type":"temperature",
+// "value":20.20,"unit":"C"},...]}. Names never contain characters that need escaping.
+static char* write_json(char* p, const char* device, uint64_t timestamp_ms, const OregonReading* readings,
+                        int count) {
+    *p++ = '{';
+    if (timestamp_ms) {
+        p = put_str(p, "\"time\":");
+        p = put_u64(p, timestamp_ms);
+        *p++ = ',';
+    }
+    p = put_str(p, "\"device\":\"");
+    p = put_strn(p, device, OUTPUT_NAME_MAX);
+    p = put_str(p, "\",\"readings\":[");
+    for (int i = 0; i < count; i++) {
+        const OregonReading* r = &readings[i];
+        if (i) {
+            *p++ = ',';
+        }
+        p = put_str(p, "{\"type\":\"");
+        p = put_str(p, oregon_reading_type_str(r->type));
+        *p++ = '"';
+        if (r->unit != OREGON_UNIT_NONE) {
+            p = put_str(p, ",\"value\":");
+            p = put_value(p, r->value);
+            p = put_str(p, ",\"unit\":\"");
+            p = put_str(p, oregon_unit_str(r->unit));
+            *p++ = '"';
+        }
+        if (r->state != OREGON_STATE_NONE) {
+            p = put_str(p, ",\"state\":\"");
+            p = put_str(p, oregon_state_str(r->state));
+            *p++ = '"';
+        }
+        if (r->forecast != OREGON_FORECAST_NONE) {
+            p = put_str(p, ",\"forecast\":\"");
+            p = put_str(p, oregon_forecast_str(r->forecast));
+            *p++ = '"';
+        }
+        *p++ = '}';
+    }
+    return put_str(p, "]}\n");
+}
+
+#define CSV_HEADER "time,device,type,value,unit,state,forecast\n"
+
+// time,device,type,value,unit,state,forecast; empty columns where not set.
+static char* write_csv(char* p, const char* device, uint64_t timestamp_ms, const OregonReading* readings,
+                       int count) {
+    for (int i = 0; i < count; i++) {
+        const OregonReading* r = &readings[i];
+        if (timestamp_ms) {
+            p = put_u64(p, timestamp_ms);
+        }
+        *p++ = ',';
+        p = put_strn(p, device, OUTPUT_NAME_MAX);
+        *p++ = ',';
+        p = put_str(p, oregon_reading_type_str(r->type));
+        *p++ = ',';
+        if (r->unit != OREGON_UNIT_NONE) {
+            p = put_value(p, r->value);
+            *p++ = ',';
+            p = put_str(p, oregon_unit_str(r->unit));
+        } else {
+            *p++ = ',';
+        }
+        *p++ = ',';
+        p = put_str(p, oregon_state_str(r->state));
+        *p++ = ',';
+        p = put_str(p, oregon_forecast_str(r->forecast));
+        *p++ = '\n';
+    }
+    return p;
+}
+
+// oregon,device=THGR228N_33_1 temperature=20.20,humidity=33.00,humidity_state="comfortable",
+// battery_status_state="ok" 1700000000000000000
+static char* write_influx(char* p, const char* device, uint64_t timestamp_ms, const OregonReading* readings,
+                          int count) {
+    p = put_str(p, "oregon,device=");
+    p = put_strn(p, device, OUTPUT_NAME_MAX);
+    char sep = ' ';
+    for (int i = 0; i < count; i++) {
+        const OregonReading* r = &readings[i];
+        const char* type = oregon_reading_type_str(r->type);
+        if (r->unit != OREGON_UNIT_NONE) {
+            *p++ = sep;
+            sep = ',';
+            p = put_str(p, type);
+            *p++ = '=';
+            p = put_value(p, r->value);
+        }
+        if (r->state != OREGON_STATE_NONE) {
+            *p++ = sep;
+            sep = ',';
+            p = put_str(p, type);
+            p = put_str(p, "_state=\"");
+            p = put_str(p, oregon_state_str(r->state));
+            *p++ = '"';
+        }
+        if (r->forecast != OREGON_FORECAST_NONE) {
+            *p++ = sep;
+            sep = ',';
+            p = put_str(p, type);
+            p = put_str(p, "_forecast=\"");
+            p = put_str(p, oregon_forecast_str(r->forecast));
+            *p++ = '"';
+        }
+    }
+    if (timestamp_ms) {
+        *p++ = ' ';
+        p = put_u64(p, timestamp_ms);
+        p = put_str(p, "000000");
+    }
+    *p++ = '\n';
+    return p;
+}
+
+// ==========================================================================
+// AGGREGATE FORMATTERS
+// ==========================================================================
+
+// The statistics of a record that are reading values, in output order.
+enum { STAT_MEAN, STAT_MIN, STAT_MAX, STAT_EWMA, STAT_COUNT };
+
+static const char* const STAT_NAMES[STAT_COUNT] = {
+    [STAT_MEAN] = "mean",
+    [STAT_MIN]  = "min",
+    [STAT_MAX]  = "max",
+    [STAT_EWMA] = "ewma",
+};
+
+static const char* const STAT_LABELS[STAT_COUNT] = {
+    [STAT_MEAN] = "Mean",
+    [STAT_MIN]  = "Min",
+    [STAT_MAX]  = "Max",
+    [STAT_EWMA] = "EWMA",
+};
+
+// Means are rounded to the readings' fixed-point resolution.
+static int32_t round_value(double v) {
+    return (int32_t)(v < 0 ? v - 0.5 : v + 0.5);
+}
+
+static void stat_values(const AggregateStats* st, int32_t* v) {
+    v[STAT_MEAN] = round_value(st->mean);
+    v[STAT_MIN] = st->min;
+    v[STAT_MAX] = st->max;
+    v[STAT_EWMA] = round_value(st->ewma);
+}
+
+static char* write_text_aggregates(char* p, const char* device, const AggregateStats* stats, int count) {
+    p = put_str(p, "--- Aggregates: ");
+    p = put_strn(p, device, OUTPUT_NAME_MAX);
+    p = put_str(p, " ---\n");
+    for (int i = 0; i < count; i++) {
+        const AggregateStats* st = &stats[i];
+        int32_t v[STAT_COUNT];
+        stat_values(st, v);
+        p = put_str(p, "  - Type: ");
+        p = put_str(p, oregon_reading_type_str(st->type));
+        p = put_str(p, "\n    Count: ");
+        p = put_u64(p, st->count);
+        *p++ = '\n';
+        for (int s = 0; s < STAT_COUNT; s++) {
+            p = put_str(p, "    ");
+            p = put_str(p, STAT_LABELS[s]);
+            p = put_str(p, ": ");
+            p = put_value(p, v[s]);
+            *p++ = ' ';
+            p = put_str(p, oregon_unit_str(st->unit));
+            *p++ = '\n';
+        }
+    }
+    return put_str(p, "---------------------------------------\n");
+}
+
+// {"time":1700000000000,"device":"THGR228N_33_1","aggregates":[{"type":"temperature",
+// "unit":"C","count":60,"mean":20.20,"min":19.80,"max":20.50,"ewma":20.21},...]}
+static char* write_json_aggregates(char* p, const char* device, uint64_t timestamp_ms,
+                                   const AggregateStats* stats, int count) {
+    *p++ = '{';
+    if (timestamp_ms) {
+        p = put_str(p, "\"time\":");
+        p = put_u64(p, timestamp_ms);
+        *p++ = ',';
+    }
+    p = put_str(p, "\"device\":\"");
+    p = put_strn(p, device, OUTPUT_NAME_MAX);
+    p = put_str(p, "\",\"aggregates\":[");
+    for (int i = 0; i < count; i++) {
+        const AggregateStats* st = &stats[i];
+        int32_t v[STAT_COUNT];
+        stat_values(st, v);
+        if (i) {
+            *p++ = ',';
+        }
+        p = put_str(p, "{\"type\":\"");
+        p = put_str(p, oregon_reading_type_str(st->type));
+        p = put_str(p, "\",\"unit\":\"");
+        p = put_str(p, oregon_unit_str(st->unit));
+        p = put_str(p, "\",\"count\":");
+        p = put_u64(p, st->count);
+        for (int s = 0; s < STAT_COUNT; s++) {
+            p = put_str(p, ",\"");
+            p = put_str(p, STAT_NAMES[s]);
+            p = put_str(p, "\":");
+            p = put_value(p, v[s]);
+        }
+        *p++ = '}';
+    }
+    return put_str(p, "]}\n");
+}
+
+// One row per statistic in the raw columns: the type column names the
+// statistic (temperature_mean), state and forecast stay empty.
+static char* write_csv_stat(char* p, const char* device, uint64_t timestamp_ms, const AggregateStats* st,
+                            const char* stat) {
+    if (timestamp_ms) {
+        p = put_u64(p, timestamp_ms);
+    }
+    *p++ = ',';
+    p = put_strn(p, device, OUTPUT_NAME_MAX);
+    *p++ = ',';
+    p = put_str(p, oregon_reading_type_str(st->type));
+    *p++ = '_';
+    p = put_str(p, stat);
+    *p++ = ',';
+    return p;
+}
+
+static char* write_csv_aggregates(char* p, const char* device, uint64_t timestamp_ms,
+                                  const AggregateStats* stats, int count) {
+    for (int i = 0; i < count; i++) {
+        const AggregateStats* st = &stats[i];
+        int32_t v[STAT_COUNT];
+        stat_values(st, v);
+        p = write_csv_stat(p, device, timestamp_ms, st, "count");
+        p = put_u64(p, st->count);
+        p = put_str(p, ",,,\n");
+        for (int s = 0; s < STAT_COUNT; s++) {
+            p = write_csv_stat(p, device, timestamp_ms, st, STAT_NAMES[s]);
+            p = put_value(p, v[s]);
+            *p++ = ',';
+            p = put_str(p, oregon_unit_str(st->unit));
+            p = put_str(p, ",,\n");
+        }
+    }
+    return p;
+}
+
+// oregon_aggregate,device=THGR228N_33_1 temperature_count=60i,temperature_mean=20.20,
+// temperature_min=19.80,temperature_max=20.50,temperature_ewma=20.21 1700000000000000000
+static char* write_influx_aggregates(char* p, const char* device, uint64_t timestamp_ms,
+                                     const AggregateStats* stats, int count) {
+    p = put_str(p, "oregon_aggregate,device=");
+    p = put_strn(p, device, OUTPUT_NAME_MAX);
+    for (int i = 0; i < count; i++) {
+        const AggregateStats* st = &stats[i];
+        const char* type = oregon_reading_type_str(st->type);
+        int32_t v[STAT_COUNT];
+        stat_values(st, v);
+        *p++ = i ? ',' : ' ';
+        p = put_str(p, type);
+        p = put_str(p, "_count=");
+        p = put_u64(p, st->count);
+        *p++ = 'i';
+        for (int s = 0; s < STAT_COUNT; s++) {
+            *p++ = ',';
+            p = put_str(p, type);
+            *p++ = '_';
+            p = put_str(p, STAT_NAMES[s]);
+            *p++ = '=';
+            p = put_value(p, v[s]);
+        }
+    }
+    if (timestamp_ms) {
+        *p++ = ' ';
+        p = put_u64(p, timestamp_ms);
+        p = put_str(p, "000000");
+    }
+    *p++ = '\n';
+    return p;
+}
+
+// ==========================================================================
+// SINK
+// ==========================================================================
+
+void output_sink_header(OutputSink* sink) {
+    if (sink->format == OUTPUT_CSV && reserve(sink, sizeof(CSV_HEADER))) {
+        sink->len = (size_t)(put_str(sink->buf + sink->len, CSV_HEADER) - sink->buf);
+    }
+}
+
+void output_sink_readings(OutputSink* sink, const char* device_name, uint64_t timestamp_ms,
+                          const OregonReading* readings, int count) {
+    if (count <= 0 || !reserve(sink, OUTPUT_MESSAGE_MAX + (size_t)count * OUTPUT_READING_MAX)) {
+        return;
+    }
+
+    char* p = sink->buf + sink->len;
+    switch (sink->format) {
+        case OUTPUT_TEXT:   p = write_text(p, device_name, readings, count); break;
+        case OUTPUT_JSON:   p = write_json(p, device_name, timestamp_ms, readings, count); break;
+        case OUTPUT_CSV:    p = write_csv(p, device_name, timestamp_ms, readings, count); break;
+        case OUTPUT_INFLUX: p = write_influx(p, device_name, timestamp_ms, readings, count); break;
+        case OUTPUT_FORMAT_COUNT: break;
+    }
+    sink->len = (size_t)(p - sink->buf);
+}
+
+void output_sink_aggregates(OutputSink* sink, const char* device_name, uint64_t timestamp_ms,
+                            const AggregateStats* stats, int count) {
+    if (count <= 0 || !reserve(sink, OUTPUT_MESSAGE_MAX + (size_t)count * OUTPUT_AGGREGATE_MAX)) {
+        return;
+    }
+
+    char* p = sink->buf + sink->len;
+    switch (sink->format) {
+        case OUTPUT_TEXT:   p = write_text_aggregates(p, device_name, stats, count); break;
+        case OUTPUT_JSON:   p = write_json_aggregates(p, device_name, timestamp_ms, stats, count); break;
+        case OUTPUT_CSV:    p = write_csv_aggregates(p, device_name, timestamp_ms, stats, count); break;
+        case OUTPUT_INFLUX: p = write_influx_aggregates(p, device_name, timestamp_ms, stats, count); break;
+        case OUTPUT_FORMAT_COUNT: break;
+    }
+    sink->len = (size_t)(p - sink->buf);
+}
@@ -0,0 +1,67 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "oregon_parser.h"
+#include "oregon_arena.h"
+#include "aggregate_store.h"
+
+typedef enum {
+    OUTPUT_TEXT,        // The human-readable blocks of fprint_device_readings()
+    OUTPUT_JSON,        // JSON Lines, one object per message
+    OUTPUT_CSV,         // One row per reading, with a header row
+    OUTPUT_INFLUX,      // InfluxDB line protocol, one point per message
+    OUTPUT_FORMAT_COUNT
+} OutputFormat;
+
+// Serialises decoded messages into one large buffer with hand-rolled
+// formatters (no stdio) and writes it out with write(2) in big batches.
+// With fd < 0 the sink only collects into the buffer, growing it as needed,
+// for callers that move the bytes themselves (e.g. batch mode chunks).
+// Not thread-safe; use one sink per thread.
+typedef struct {
+    OutputFormat format;
+    int fd;
+    char* buf;
+    size_t len;
+    size_t cap;
+    OregonArena* arena; // Owner of buf, or NULL if it came from malloc
+    bool failed;        // A write or allocation failed; output was lost
+} OutputSink;
+
+// Looks up a format by name ("text", "json", "csv", "influx").
+bool output_format_parse(const char* name, OutputFormat* format);
+const char* output_format_str(OutputFormat format);
+
+// Allocates a buffer of `capacity` bytes. Returns 0 on success, -1 if
+// allocation fails.
+int output_sink_init(OutputSink* sink, OutputFormat format, int fd, size_t capacity);
+// Collecting sink (no descriptor) whose buffer, and any growth of it, comes
+// from `arena`. The buffer stays valid until the arena is reset.
+int output_sink_init_arena(OutputSink* sink, OutputFormat format, OregonArena* arena, size_t capacity);
+// Flushes and frees the buffer.
+void output_sink_free(OutputSink* sink);
+
+// Writes the format's header, if it has one (the CSV column names).
+void output_sink_header(OutputSink* sink);
+
+// Appends one decoded message from the named device. timestamp_ms is
+// milliseconds since the epoch, or 0 if unknown; it is left out then.
+// Flushes first when the buffer could not hold the message.
+void output_sink_readings(OutputSink* sink, const char* device_name, uint64_t timestamp_ms,
+                          const OregonReading* readings, int count);
+
+// Appends one aggregate record: the rolling statistics of some of the named
+// device's reading types, as of timestamp_ms. In CSV and InfluxDB output
+// each statistic becomes its own value named after the type, e.g.
+// temperature_mean, so raw and aggregate records can share one stream.
+void output_sink_aggregates(OutputSink* sink, const char* device_name, uint64_t timestamp_ms,
+                            const AggregateStats* stats, int count);
+
+// Writes out everything buffered. Returns 0 on success, -1 on a write
+// error (errno set). No-op without a file descriptor.
+int output_sink_flush(OutputSink* sink);
+
+#endif // OUTPUT_SINK_H
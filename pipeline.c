@@ -0,0 +1,312 @@
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include "pipeline.h"
+
+typedef struct {
+    uint64_t time_ms;
+    uint16_t len;
+    char line[CUL_LINE_MAX + 1];
+} LineMsg;
+
+typedef struct {
+    uint64_t time_ms;
+    OregonFrame frame;
+} FrameMsg;
+
+typedef struct {
+    uint64_t time_ms;
+    int count;
+    int32_t id;                 // DeviceRegistry id, -1 if unknown
+    char name[DEVICE_NAME_MAX];
+    OregonReading readings[OREGON_MAX_READINGS];
+} ReadingsMsg;
+
+static const char* const QUEUE_NAMES[PIPELINE_QUEUE_COUNT] = {
+    [PIPELINE_LINES]    = "lines",
+    [PIPELINE_FRAMES]   = "frames",
+    [PIPELINE_READINGS] = "readings",
+};
+
+static uint64_t realtime_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+// Called while a stage has nothing to do or no room downstream: yields a
+// few times, then sleeps, longer once the stage has been idle for a while.
+static void idle_wait(unsigned* idle) {
+    if (++*idle < 16) {
+        sched_yield();
+        return;
+    }
+    struct timespec ts = {0, *idle < 256 ? 50000 : 1000000};
+    nanosleep(&ts, NULL);
+}
+
+// Next free slot of a queue, publishing what is pending and waiting while
+// it is full.
+static void* wait_slot(SpscRing* q) {
+    unsigned idle = 0;
+    void* slot;
+    while (!(slot = spsc_ring_slot(q))) {
+        spsc_ring_publish(q);
+        idle_wait(&idle);
+    }
+    return slot;
+}
+
+// ==========================================================================
+// STAGES
+// ==========================================================================
+
+static void* preprocess_stage(void* arg) {
+    Pipeline* p = arg;
+    SpscRing* in = &p->queues[PIPELINE_LINES];
+    SpscRing* out = &p->queues[PIPELINE_FRAMES];
+    unsigned idle = 0;
+
+    for (;;) {
+        size_t n = spsc_ring_available(in);
+        if (n == 0) {
+            spsc_ring_publish(out);
+            if (spsc_ring_finished(in)) {
+                break;
+            }
+            idle_wait(&idle);
+            continue;
+        }
+        idle = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            const LineMsg* m = spsc_ring_at(in, i);
+            FrameMsg* f = wait_slot(out);
+            OregonStatus status = cul_preprocess_frame(m->line, &f->frame);
+            if (status != OREGON_OK) {
+                p->preprocess_status[status]++;
+                if (p->config.verbose) {
+                    fprintf(stderr, "Dropped %s: %s\n", m->line, oregon_status_str(status));
+                }
+                continue;
+            }
+            f->time_ms = m->time_ms;
+            spsc_ring_produce(out);
+        }
+        spsc_ring_release(in, n);
+        spsc_ring_publish(out);
+    }
+    spsc_ring_close(out);
+    return NULL;
+}
+
+static void* parse_stage(void* arg) {
+    Pipeline* p = arg;
+    SpscRing* in = &p->queues[PIPELINE_FRAMES];
+    SpscRing* out = &p->queues[PIPELINE_READINGS];
+    DeviceRegistry* devices = p->config.devices;
+    unsigned idle = 0;
+
+    for (;;) {
+        size_t n = spsc_ring_available(in);
+        if (n == 0) {
+            spsc_ring_publish(out);
+            if (spsc_ring_finished(in)) {
+                break;
+            }
+            idle_wait(&idle);
+            continue;
+        }
+        idle = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            const FrameMsg* f = spsc_ring_at(in, i);
+            ReadingsMsg* r = wait_slot(out);
+            OregonMessageInfo info;
+            OregonStatus status = oregon_decode_frame(&f->frame, &info, r->readings, OREGON_MAX_READINGS,
+                                                      &r->count);
+            p->parse_status[status]++;
+            p->by_protocol[info.protocol]++;
+            if (status != OREGON_OK) {
+                if (p->config.verbose) {
+                    char hex[CUL_HEX_OUTPUT_SIZE];
+                    cul_frame_to_hex(&f->frame, hex, sizeof(hex));
+                    fprintf(stderr, "Dropped frame %s: %s\n", hex, oregon_status_str(status));
+                }
+                continue;
+            }
+
+            int32_t id = -1;
+            if (devices) {
+                uint32_t known = devices->num_devices;
+                id = device_registry_observe(devices, r->readings[0].device, f->time_ms);
+                if (id >= 0 && (uint32_t)id >= known && p->config.verbose) {
+                    fprintf(stderr, "New device %s\n", device_registry_get(devices, id)->name);
+                }
+            }
+            if (id >= 0) {
+                memcpy(r->name, device_registry_get(devices, id)->name, DEVICE_NAME_MAX);
+                if (p->config.aggregates) {
+                    aggregate_store_add(p->config.aggregates, id, r->readings, r->count);
+                }
+            } else {
+                oregon_device_name(r->readings[0].device, r->name, sizeof(r->name));
+            }
+            r->time_ms = f->time_ms;
+            r->id = id;
+            spsc_ring_produce(out);
+        }
+        spsc_ring_release(in, n);
+        spsc_ring_publish(out);
+    }
+    spsc_ring_close(out);
+    return NULL;
+}
+
+static void* sink_stage(void* arg) {
+    Pipeline* p = arg;
+    SpscRing* in = &p->queues[PIPELINE_READINGS];
+    OutputSink* out = p->config.out;
+    unsigned idle = 0;
+
+    for (;;) {
+        size_t n = spsc_ring_available(in);
+        if (n == 0) {
+            // Input went quiet: get everything so far out of the door
+            output_sink_flush(out);
+            if (spsc_ring_finished(in)) {
+                break;
+            }
+            idle_wait(&idle);
+            continue;
+        }
+        idle = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            const ReadingsMsg* r = spsc_ring_at(in, i);
+            if (p->config.archive) {
+                reading_archive_append(p->config.archive, r->time_ms, r->readings, r->count);
+            }
+            if (p->config.report) {
+                aggregate_report_add(p->config.report, r->id, r->name, r->time_ms, r->readings, r->count);
+            }
+            if (p->config.aggregates_only) {
+                continue;
+            }
+            if (p->config.filter) {
+                OregonReading changed[OREGON_MAX_READINGS];
+                int count = emission_filter_apply(p->config.filter, r->id, r->time_ms, r->readings, r->count,
+                                                  changed);
+                if (count > 0) {
+                    output_sink_readings(out, r->name, r->time_ms, changed, count);
+                }
+            } else {
+                output_sink_readings(out, r->name, r->time_ms, r->readings, r->count);
+            }
+        }
+        spsc_ring_release(in, n);
+    }
+    return NULL;
+}
+
+// ==========================================================================
+// CONTROL
+// ==========================================================================
+
+int pipeline_start(Pipeline* p, const PipelineConfig* config) {
+    static const size_t SLOT_SIZES[PIPELINE_QUEUE_COUNT] = {
+        [PIPELINE_LINES]    = sizeof(LineMsg),
+        [PIPELINE_FRAMES]   = sizeof(FrameMsg),
+        [PIPELINE_READINGS] = sizeof(ReadingsMsg),
+    };
+    static void* (*const STAGES[PIPELINE_QUEUE_COUNT])(void*) = {
+        preprocess_stage, parse_stage, sink_stage,
+    };
+
+    memset(p, 0, sizeof(*p));
+    p->config = *config;
+    for (int q = 0; q < PIPELINE_QUEUE_COUNT; q++) {
+        if (spsc_ring_init(&p->queues[q], config->depth, SLOT_SIZES[q]) != 0) {
+            while (q-- > 0) {
+                spsc_ring_free(&p->queues[q]);
+            }
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    // Stage threads inherit a full signal mask, so signals interrupt the
+    // reading thread's blocking read and are noticed at once
+    sigset_t all, saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    for (int s = 0; s < PIPELINE_QUEUE_COUNT; s++) {
+        int err = pthread_create(&p->threads[s], NULL, STAGES[s], p);
+        if (err != 0) {
+            pthread_sigmask(SIG_SETMASK, &saved, NULL);
+            pipeline_stop(p);
+            pipeline_free(p);
+            errno = err;
+            return -1;
+        }
+        p->started++;
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    return 0;
+}
+
+void pipeline_push_line(void* ctx, const char* line, size_t len) {
+    Pipeline* p = ctx;
+    SpscRing* q = &p->queues[PIPELINE_LINES];
+    LineMsg* m = spsc_ring_slot(q);
+    if (!m) {
+        // Nothing published can be consumed; hand over the batch and retry
+        spsc_ring_publish(q);
+        m = p->config.lossless ? wait_slot(q) : spsc_ring_slot(q);
+        if (!m) {
+            spsc_ring_drop(q);
+            return;
+        }
+    }
+    m->time_ms = realtime_ms();
+    m->len = (uint16_t)len;
+    memcpy(m->line, line, len + 1);
+    spsc_ring_produce(q);
+}
+
+void pipeline_publish(void* ctx) {
+    Pipeline* p = ctx;
+    spsc_ring_publish(&p->queues[PIPELINE_LINES]);
+}
+
+void pipeline_stop(Pipeline* p) {
+    // Closing the first queue lets every stage drain and close the next
+    spsc_ring_close(&p->queues[PIPELINE_LINES]);
+    for (int s = 0; s < p->started; s++) {
+        pthread_join(p->threads[s], NULL);
+    }
+    p->started = 0;
+}
+
+void pipeline_free(Pipeline* p) {
+    for (int q = 0; q < PIPELINE_QUEUE_COUNT; q++) {
+        spsc_ring_free(&p->queues[q]);
+    }
+}
+
+void pipeline_status_counts(const Pipeline* p, unsigned long* by_status) {
+    for (int s = 0; s < OREGON_STATUS_COUNT; s++) {
+        by_status[s] = p->preprocess_status[s] + p->parse_status[s];
+    }
+}
+
+void pipeline_print_stats(const Pipeline* p, FILE* out) {
+    fprintf(out, "Pipeline queues:\n");
+    for (int q = 0; q < PIPELINE_QUEUE_COUNT; q++) {
+        const SpscRing* r = &p->queues[q];
+        double mean = r->publishes ? (double)r->occupancy_sum / r->publishes : 0;
+        fprintf(out, "  %-10s depth %zu, %lu queued, %lu dropped, occupancy max %zu, mean %.1f\n",
+                QUEUE_NAMES[q], spsc_ring_capacity(r), r->pushed, r->dropped, r->max_occupancy, mean);
+    }
+}
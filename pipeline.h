@@ -0,0 +1,79 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "spsc_ring.h"
+#include "cul_preprocessor.h"
+#include "cul_stream.h"
+#include "device_registry.h"
+#include "aggregate_store.h"
+#include "aggregate_report.h"
+#include "output_sink.h"
+#include "reading_archive.h"
+#include "emission_filter.h"
+
+typedef enum {
+    PIPELINE_LINES,             // ingest -> preprocess
+    PIPELINE_FRAMES,            // preprocess -> parse
+    PIPELINE_READINGS,          // parse -> sink
+    PIPELINE_QUEUE_COUNT
+} PipelineQueue;
+
+typedef struct {
+    size_t depth;               // Slots per queue, rounded up to a power of two
+    bool lossless;              // Ingest waits for room instead of dropping
+    bool verbose;
+    OutputSink* out;            // Used by the sink stage only
+    DeviceRegistry* devices;    // Used by the parse stage only; may be NULL
+    AggregateStore* aggregates; // Used by the parse stage only; may be NULL
+    AggregateReport* report;    // Used by the sink stage only; may be NULL. It
+                                // feeds its own store; leave aggregates NULL then
+    bool aggregates_only;       // Write report's records instead of the readings
+    ReadingArchive* archive;    // Used by the sink stage only; may be NULL
+    EmissionFilter* filter;     // Used by the sink stage only; may be NULL
+} PipelineConfig;
+
+// Stream decoding split into four stages on their own threads:
+//   ingest (the caller) -> preprocess -> parse -> sink
+// joined by SpscRings. Ingest never blocks: when the line queue is full the
+// line is dropped and counted, unless the config asks for lossless mode
+// (for sources that cannot overrun, such as regular files). The later stages
+// wait for room downstream. Stages that run dry back off from spinning to
+// sleeping.
+typedef struct {
+    PipelineConfig config;
+    SpscRing queues[PIPELINE_QUEUE_COUNT];
+    pthread_t threads[PIPELINE_QUEUE_COUNT];
+    int started;
+    // Written by the stage that finishes each line; read after pipeline_stop()
+    unsigned long preprocess_status[OREGON_STATUS_COUNT];
+    unsigned long parse_status[OREGON_STATUS_COUNT];
+    unsigned long by_protocol[OREGON_VERSION_COUNT];
+} Pipeline;
+
+// Allocates the queues and starts the stage threads. Returns 0 on success,
+// -1 with errno set.
+int pipeline_start(Pipeline* p, const PipelineConfig* config);
+
+// Ingest side, on the caller's thread. pipeline_push_line() is a
+// cul_line_cb that queues one line; pipeline_publish() hands everything
+// queued since the last call to the next stage in one batch.
+void pipeline_push_line(void* ctx, const char* line, size_t len);
+void pipeline_publish(void* ctx);
+
+// Drains every stage and stops the threads. Statistics stay readable
+// until pipeline_free().
+void pipeline_stop(Pipeline* p);
+void pipeline_free(Pipeline* p);
+
+// Totals over both decoding stages, as by_status in stream mode.
+void pipeline_status_counts(const Pipeline* p, unsigned long* by_status);
+
+// Prints per-queue depth, traffic and occupancy.
+void pipeline_print_stats(const Pipeline* p, FILE* out);
+
+#endif // PIPELINE_H
@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "oregon_parser.h"
+#include "device_registry.h"
+#include "output_sink.h"
+#include "reading_archive.h"
+#include "aggregate_report.h"
+
+// Answers queries against an archive written by oregon_parser --archive:
+// the readings of one or every device in a time range, optionally of one
+// reading type, in any of the parser's output formats. With --window the
+// readings are replaced by the same rolling aggregates stream mode writes.
+
+#define QUERY_OUTPUT_SIZE (64 * 1024)
+#define DEFAULT_EWMA_ALPHA 0.1
+
+typedef struct {
+    OutputSink* out;
+    AggregateReport* report;    // NULL to print the readings themselves
+    int32_t id;                 // Directory index of the device, the report's device id
+    char name[DEVICE_NAME_MAX];
+} QueryOutput;
+
+static bool print_group(void* ctx, uint32_t device, int64_t time_ms, const OregonReading* readings, int count) {
+    (void)device;
+    QueryOutput* q = ctx;
+    if (q->report) {
+        aggregate_report_add(q->report, q->id, q->name, (uint64_t)time_ms, readings, count);
+    } else {
+        output_sink_readings(q->out, q->name, (uint64_t)time_ms, readings, count);
+    }
+    return !q->out->failed;
+}
+
+static uint64_t clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void format_time(int64_t ms, char* buf, size_t size) {
+    time_t t = (time_t)(ms / 1000);
+    struct tm tm;
+    strftime(buf, size, "%Y-%m-%d %H:%M:%S", localtime_r(&t, &tm));
+}
+
+// Milliseconds since the epoch, as in the parser's output, or a local date
+// and time such as "2026-10-16", "2026-10-16 14:30" or "2026-10-16T14:30:05".
+static bool parse_time(const char* s, int64_t* ms) {
+    if (*s && strspn(s, "0123456789") == strlen(s)) {
+        *ms = strtoll(s, NULL, 10);
+        return true;
+    }
+    static const char* const FORMATS[] = {
+        "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M", "%Y-%m-%d %H:%M", "%Y-%m-%d",
+    };
+    for (size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); i++) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        const char* end = strptime(s, FORMATS[i], &tm);
+        if (end && *end == '\0') {
+            tm.tm_isdst = -1;
+            *ms = (int64_t)mktime(&tm) * 1000;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_type(const char* s, int* type) {
+    for (int t = 0; t < OREGON_READING_TYPE_COUNT; t++) {
+        if (strcmp(s, oregon_reading_type_str((OregonReadingType)t)) == 0) {
+            *type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Finds a device in the archive by name (e.g. "THGR810_a3_1") or by key.
+static bool find_device(const ReadingArchiveView* view, const char* s, uint32_t* device) {
+    const ArchiveSuperblock* sb = (const ArchiveSuperblock*)view->map;
+    for (uint32_t i = 0; i < view->num_devices; i++) {
+        char name[DEVICE_NAME_MAX];
+        oregon_device_name(sb->devices[i].device, name, sizeof(name));
+        if (strcasecmp(name, s) == 0) {
+            *device = sb->devices[i].device;
+            return true;
+        }
+    }
+    char* end;
+    unsigned long key = strtoul(s, &end, 0);
+    if (end != s && *end == '\0') {
+        for (uint32_t i = 0; i < view->num_devices; i++) {
+            if (sb->devices[i].device == key) {
+                *device = (uint32_t)key;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void list_devices(const ReadingArchiveView* view) {
+    printf("%-20s %10s  %-19s  %-19s\n", "device", "readings", "first", "last");
+    for (uint32_t i = 0; i < view->num_devices; i++) {
+        ArchiveDeviceInfo info;
+        if (!reading_archive_device(view, i, &info)) {
+            continue;
+        }
+        char name[DEVICE_NAME_MAX], first[32], last[32];
+        oregon_device_name(info.device, name, sizeof(name));
+        format_time(info.first_time, first, sizeof(first));
+        format_time(info.last_time, last, sizeof(last));
+        printf("%-20s %10llu  %-19s  %-19s\n", name, (unsigned long long)info.records, first, last);
+    }
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--device NAME] [--type TYPE] [--from TIME] [--to TIME]\n"
+                    "          [--window N [--ewma-alpha A] [--every S]] [--output FORMAT] <archive>\n", prog);
+    fprintf(stderr, "       %s --list <archive>\n", prog);
+    fprintf(stderr, "Example: %s --device THGR810_a3_1 --type temperature --from 2026-10-16 readings.arc\n",
+            prog);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -d, --device NAME  Device name as printed by oregon_parser, or its key\n");
+    fprintf(stderr, "                   (default: every device, one after the other)\n");
+    fprintf(stderr, "  -t, --type TYPE  Only readings of this type, e.g. temperature or humidity\n");
+    fprintf(stderr, "  -f, --from TIME  Start of the range, inclusive: milliseconds since the epoch\n");
+    fprintf(stderr, "                   or a local time such as \"2026-10-16 14:30\" (default: the first)\n");
+    fprintf(stderr, "  -u, --to TIME    End of the range, inclusive (default: the last)\n");
+    fprintf(stderr, "  -w, --window N   Print rolling mean/min/max over the last N readings of each\n");
+    fprintf(stderr, "                   type instead of the readings, once per N readings\n");
+    fprintf(stderr, "  -a, --ewma-alpha A  Weight of a new reading in the moving average (default: %.1f)\n",
+            DEFAULT_EWMA_ALPHA);
+    fprintf(stderr, "  -e, --every S    With --window, print them every S seconds of archive time instead\n");
+    fprintf(stderr, "  -o, --output FORMAT  csv (default), json, influx or text\n");
+    fprintf(stderr, "  -l, --list       List the devices in the archive with their time spans\n");
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option options[] = {
+        {"device", required_argument, NULL, 'd'},
+        {"type",   required_argument, NULL, 't'},
+        {"from",   required_argument, NULL, 'f'},
+        {"to",     required_argument, NULL, 'u'},
+        {"window", required_argument, NULL, 'w'},
+        {"ewma-alpha", required_argument, NULL, 'a'},
+        {"every",  required_argument, NULL, 'e'},
+        {"output", required_argument, NULL, 'o'},
+        {"list",   no_argument,       NULL, 'l'},
+        {"help",   no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    const char* device_arg = NULL;
+    int type = -1;
+    int64_t t0 = INT64_MIN, t1 = INT64_MAX;
+    OutputFormat format = OUTPUT_CSV;
+    bool list = false;
+    long window = 0;
+    long every = 0;
+    double alpha = DEFAULT_EWMA_ALPHA;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "d:t:f:u:w:a:e:o:lh", options, NULL)) != -1) {
+        switch (c) {
+            case 'd': device_arg = optarg; break;
+            case 't':
+                if (!parse_type(optarg, &type)) {
+                    fprintf(stderr, "Error: Unknown reading type %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f':
+            case 'u':
+                if (!parse_time(optarg, c == 'f' ? &t0 : &t1)) {
+                    fprintf(stderr, "Error: Cannot read time %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'w': window = atol(optarg); break;
+            case 'a': alpha = atof(optarg); break;
+            case 'e': every = atol(optarg); break;
+            case 'o':
+                if (!output_format_parse(optarg, &format)) {
+                    fprintf(stderr, "Error: Unknown output format %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'l': list = true; break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char* path = argv[optind];
+    ReadingArchiveView view;
+    if (reading_archive_map(&view, path) != 0) {
+        fprintf(stderr, "Error: Could not open archive %s: %s\n", path,
+                errno == EINVAL ? "not an archive" : strerror(errno));
+        return 1;
+    }
+    if (list) {
+        list_devices(&view);
+        reading_archive_unmap(&view);
+        return 0;
+    }
+
+    uint32_t device = 0;
+    if (device_arg && !find_device(&view, device_arg, &device)) {
+        fprintf(stderr, "Error: No device %s in %s\n", device_arg, path);
+        reading_archive_unmap(&view);
+        return 1;
+    }
+
+    OutputSink out;
+    if (output_sink_init(&out, format, STDOUT_FILENO, QUERY_OUTPUT_SIZE) != 0) {
+        fprintf(stderr, "Error: Could not allocate the output buffer\n");
+        reading_archive_unmap(&view);
+        return 1;
+    }
+    output_sink_header(&out);
+
+    // Every device gets its own series, so they need no reset in between
+    AggregateStore aggregates;
+    AggregateReport report;
+    QueryOutput q = {.out = &out};
+    if (window > 0) {
+        uint32_t max_devices = view.num_devices > 0 ? view.num_devices : 1;
+        if (aggregate_store_init(&aggregates, (uint32_t)window, alpha, max_devices,
+                                 max_devices * OREGON_READING_TYPE_COUNT) != 0 ||
+            aggregate_report_init(&report, &aggregates, &out, every > 0 ? (uint64_t)every * 1000u : 0) != 0) {
+            fprintf(stderr, "Error: Could not set up aggregation over %ld readings\n", window);
+            aggregate_store_free(&aggregates);
+            output_sink_free(&out);
+            reading_archive_unmap(&view);
+            return 1;
+        }
+        q.report = &report;
+    }
+    uint64_t readings = 0;
+    uint32_t devices = 0;
+    uint64_t start = clock_us();
+    const ArchiveSuperblock* sb = (const ArchiveSuperblock*)view.map;
+    for (uint32_t i = 0; i < view.num_devices && !out.failed; i++) {
+        uint32_t d = sb->devices[i].device;
+        if (device_arg && d != device) {
+            continue;
+        }
+        oregon_device_name(d, q.name, sizeof(q.name));
+        q.id = (int32_t)i;
+        uint64_t n = reading_archive_query(&view, d, t0, t1, type, print_group, &q);
+        if (q.report) {
+            aggregate_report_flush(q.report, q.id);
+        }
+        readings += n;
+        devices += n > 0;
+    }
+    uint64_t elapsed = clock_us() - start;
+
+    if (q.report) {
+        aggregate_report_free(&report);
+        aggregate_store_free(&aggregates);
+    }
+    output_sink_flush(&out);
+    bool failed = out.failed;
+    int err = errno;
+    output_sink_free(&out);
+    reading_archive_unmap(&view);
+    fprintf(stderr, "Readings: %llu from %u devices in %.3f ms\n", (unsigned long long)readings, devices,
+            elapsed / 1000.0);
+    if (failed) {
+        fprintf(stderr, "Error: Could not write the output: %s\n", strerror(err));
+        return 1;
+    }
+    return 0;
+}
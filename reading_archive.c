@@ -0,0 +1,600 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "reading_archive.h"
+
+// The file grows by a quarter of its size at a time, at least this much.
+#define ARCHIVE_MIN_GROWTH (1u << 20)
+
+#define BLOCK_AT(map, b) ((map) + (size_t)(b) * ARCHIVE_BLOCK_SIZE)
+
+// Checks the superblock of a mapping of `size` bytes.
+static bool superblock_valid(const uint8_t* map, size_t size) {
+    const ArchiveSuperblock* sb = (const ArchiveSuperblock*)map;
+    return size >= ARCHIVE_BLOCK_SIZE && size % ARCHIVE_BLOCK_SIZE == 0 &&
+           memcmp(sb->magic, ARCHIVE_MAGIC, sizeof(sb->magic)) == 0 && sb->version == ARCHIVE_VERSION &&
+           sb->block_size == ARCHIVE_BLOCK_SIZE;
+}
+
+// Returns the header of block b if it is in use and of the given kind and
+// device, otherwise NULL. Everything read from the file is checked like this
+// before it is followed, so a torn file never leads out of bounds.
+static const ArchiveBlockHeader* block_header(const uint8_t* map, uint32_t num_blocks, uint32_t b,
+                                              uint32_t kind, uint32_t device) {
+    if (b == 0 || b >= num_blocks) {
+        return NULL;
+    }
+    const ArchiveBlockHeader* h = (const ArchiveBlockHeader*)BLOCK_AT(map, b);
+    return h->kind == kind && h->device == device ? h : NULL;
+}
+
+static uint32_t block_count(const ArchiveBlockHeader* h, uint32_t capacity) {
+    uint32_t n = atomic_load_explicit(&h->count, memory_order_acquire);
+    return n < capacity ? n : capacity;
+}
+
+// ==========================================================================
+// WRITER
+// ==========================================================================
+
+static inline ArchiveSuperblock* superblock(const ReadingArchive* ar) {
+    return (ArchiveSuperblock*)ar->map;
+}
+
+static inline uint32_t slot_of(uint32_t device) {
+    return (device * 0x9E3779B1u) >> (32 - __builtin_ctz(ARCHIVE_DEVICE_SLOTS));
+}
+
+// Returns the slot holding the device, or the empty slot where it belongs.
+static uint32_t probe(const ReadingArchive* ar, uint32_t device) {
+    const ArchiveSuperblock* sb = superblock(ar);
+    uint32_t s = slot_of(device);
+    while (ar->slots[s] && sb->devices[ar->slots[s] - 1].device != device) {
+        s = (s + 1) & (ARCHIVE_DEVICE_SLOTS - 1);
+    }
+    return s;
+}
+
+// Extends the file and the mapping by at least one block.
+static int grow(ReadingArchive* ar) {
+    size_t growth = ar->map_size / 4 / ARCHIVE_BLOCK_SIZE * ARCHIVE_BLOCK_SIZE;
+    if (growth < ARCHIVE_MIN_GROWTH) {
+        growth = ARCHIVE_MIN_GROWTH;
+    }
+    size_t size = ar->map_size + growth;
+    // Reserve the space up front: a write to a sparse page of a full disk
+    // would arrive as SIGBUS instead of an error
+    int err = posix_fallocate(ar->fd, (off_t)ar->map_size, (off_t)growth);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    void* map = mremap(ar->map, ar->map_size, size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    ar->map = map;
+    ar->map_size = size;
+    return 0;
+}
+
+// Takes the next unused block. The mapping may move.
+static uint32_t alloc_block(ReadingArchive* ar) {
+    uint32_t b = atomic_load_explicit(&superblock(ar)->num_blocks, memory_order_relaxed);
+    if ((size_t)(b + 1) * ARCHIVE_BLOCK_SIZE > ar->map_size && grow(ar) != 0) {
+        return 0;
+    }
+    atomic_store_explicit(&superblock(ar)->num_blocks, b + 1, memory_order_release);
+    return b;
+}
+
+// Readers only reach a block through a count stored with release after
+// this, so the header needs no ordering of its own.
+static void init_block(ReadingArchive* ar, uint32_t b, uint32_t kind, uint32_t device, uint32_t prev) {
+    ArchiveBlockHeader* h = (ArchiveBlockHeader*)BLOCK_AT(ar->map, b);
+    h->kind = kind;
+    h->device = device;
+    h->prev = prev;
+    atomic_store_explicit(&h->count, 0, memory_order_relaxed);
+}
+
+// Starts a new data block for directory entry e whose first record is at
+// time t, and enters it in the device's index.
+static int start_data_block(ReadingArchive* ar, uint32_t e, int64_t t) {
+    ArchiveCursor* c = &ar->cursors[e];
+    uint32_t device = superblock(ar)->devices[e].device;
+
+    uint32_t data = alloc_block(ar);
+    if (data == 0) {
+        return -1;
+    }
+    init_block(ar, data, ARCHIVE_BLOCK_DATA, device, 0);
+
+    const ArchiveIndexBlock* x = (const ArchiveIndexBlock*)BLOCK_AT(ar->map, c->index);
+    if (c->index == 0 || block_count(&x->header, ARCHIVE_INDEX_ENTRIES) == ARCHIVE_INDEX_ENTRIES) {
+        uint32_t index = alloc_block(ar);
+        if (index == 0) {
+            return -1;
+        }
+        init_block(ar, index, ARCHIVE_BLOCK_INDEX, device, c->index);
+        // The directory entry is the only way to the index chain, so the new
+        // head must be on disk before anything on disk points at it
+        if (msync(BLOCK_AT(ar->map, index), ARCHIVE_BLOCK_SIZE, MS_SYNC) != 0) {
+            return -1;
+        }
+        atomic_store_explicit(&superblock(ar)->devices[e].last_index, index, memory_order_release);
+        c->index = index;
+    }
+
+    ArchiveIndexBlock* index = (ArchiveIndexBlock*)BLOCK_AT(ar->map, c->index);
+    uint32_t n = atomic_load_explicit(&index->header.count, memory_order_relaxed);
+    index->entries[n] = (ArchiveIndexEntry){data, 0, t};
+    atomic_store_explicit(&index->header.count, n + 1, memory_order_release);
+    atomic_fetch_add_explicit(&superblock(ar)->devices[e].data_blocks, 1, memory_order_release);
+    c->data = data;
+    return 0;
+}
+
+// Picks up where the last writer of directory entry e stopped. A chain head
+// or data block that does not check out (it was lost with a power failure)
+// makes the next append start a new one rather than write over it.
+static void recover_cursor(ReadingArchive* ar, uint32_t e) {
+    ArchiveSuperblock* sb = superblock(ar);
+    uint32_t num_blocks = atomic_load_explicit(&sb->num_blocks, memory_order_relaxed);
+    uint32_t device = sb->devices[e].device;
+    ArchiveCursor* c = &ar->cursors[e];
+    memset(c, 0, sizeof(*c));
+
+    uint32_t last = atomic_load_explicit(&sb->devices[e].last_index, memory_order_relaxed);
+    const ArchiveBlockHeader* h = block_header(ar->map, num_blocks, last, ARCHIVE_BLOCK_INDEX, device);
+    if (!h) {
+        return;
+    }
+    c->index = last;
+    uint32_t n = block_count(h, ARCHIVE_INDEX_ENTRIES);
+    if (n == 0) {
+        return;
+    }
+    const ArchiveIndexEntry* entry = &((const ArchiveIndexBlock*)h)->entries[n - 1];
+    c->last_time = entry->first_time;
+    h = block_header(ar->map, num_blocks, entry->block, ARCHIVE_BLOCK_DATA, device);
+    if (!h) {
+        return;
+    }
+    c->data = entry->block;
+    n = block_count(h, ARCHIVE_BLOCK_RECORDS);
+    if (n > 0) {
+        c->last_time = ((const ArchiveDataBlock*)h)->records[n - 1].time_ms;
+    }
+}
+
+// Sets up the mapping of a new or existing file.
+static int map_for_append(ReadingArchive* ar) {
+    struct stat st;
+    if (fstat(ar->fd, &st) != 0) {
+        return -1;
+    }
+    bool created = st.st_size == 0;
+    if (created) {
+        int err = posix_fallocate(ar->fd, 0, ARCHIVE_MIN_GROWTH);
+        if (err != 0) {
+            errno = err;
+            return -1;
+        }
+        st.st_size = ARCHIVE_MIN_GROWTH;
+    }
+    ar->map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, ar->fd, 0);
+    if (ar->map == MAP_FAILED) {
+        ar->map = NULL;
+        return -1;
+    }
+    ar->map_size = (size_t)st.st_size;
+
+    ArchiveSuperblock* sb = superblock(ar);
+    if (created) {
+        sb->version = ARCHIVE_VERSION;
+        sb->block_size = ARCHIVE_BLOCK_SIZE;
+        atomic_store_explicit(&sb->num_blocks, 1, memory_order_relaxed);
+        // The magic goes last and on its own, so a file cut short by a crash
+        // here is not taken for an archive
+        memcpy(sb->magic, ARCHIVE_MAGIC, sizeof(sb->magic));
+        if (msync(ar->map, ARCHIVE_BLOCK_SIZE, MS_SYNC) != 0) {
+            return -1;
+        }
+    }
+    if (!superblock_valid(ar->map, ar->map_size)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int reading_archive_open(ReadingArchive* ar, const char* path, uint64_t sync_interval_ms) {
+    memset(ar, 0, sizeof(*ar));
+    ar->sync_interval_ms = sync_interval_ms;
+    ar->last_sync = -1;
+    ar->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (ar->fd < 0) {
+        return -1;
+    }
+    if (flock(ar->fd, LOCK_EX | LOCK_NB) != 0 || map_for_append(ar) != 0) {
+        // Leave the file as it was: no sync, no truncation
+        int err = errno;
+        if (ar->map) {
+            munmap(ar->map, ar->map_size);
+        }
+        close(ar->fd);
+        memset(ar, 0, sizeof(*ar));
+        ar->fd = -1;
+        errno = err;
+        return -1;
+    }
+
+    ArchiveSuperblock* sb = superblock(ar);
+    uint32_t blocks = (uint32_t)(ar->map_size / ARCHIVE_BLOCK_SIZE);
+    uint32_t used = atomic_load_explicit(&sb->num_blocks, memory_order_relaxed);
+    if (used == 0 || used > blocks) {
+        used = used == 0 ? 1 : blocks;
+    }
+    // Blocks written after the last superblock update that reached the disk
+    // must not be handed out again
+    for (uint32_t b = used; b < blocks; b++) {
+        if (((const ArchiveBlockHeader*)BLOCK_AT(ar->map, b))->kind != ARCHIVE_BLOCK_FREE) {
+            used = b + 1;
+        }
+    }
+    atomic_store_explicit(&sb->num_blocks, used, memory_order_relaxed);
+
+    uint32_t num_devices = atomic_load_explicit(&sb->num_devices, memory_order_relaxed);
+    if (num_devices > ARCHIVE_MAX_DEVICES) {
+        num_devices = ARCHIVE_MAX_DEVICES;
+        atomic_store_explicit(&sb->num_devices, num_devices, memory_order_relaxed);
+    }
+    for (uint32_t e = 0; e < num_devices; e++) {
+        uint32_t s = probe(ar, sb->devices[e].device);
+        if (!ar->slots[s]) {
+            ar->slots[s] = (uint16_t)(e + 1);
+        }
+        recover_cursor(ar, e);
+    }
+    return 0;
+}
+
+// Returns the directory entry of a device, adding it if there is room, or -1.
+static int32_t device_entry(ReadingArchive* ar, uint32_t device) {
+    uint32_t s = probe(ar, device);
+    if (ar->slots[s]) {
+        return ar->slots[s] - 1;
+    }
+    ArchiveSuperblock* sb = superblock(ar);
+    uint32_t e = atomic_load_explicit(&sb->num_devices, memory_order_relaxed);
+    if (e == ARCHIVE_MAX_DEVICES) {
+        return -1;
+    }
+    ArchiveDirEntry* entry = &sb->devices[e];
+    entry->device = device;
+    atomic_store_explicit(&entry->last_index, 0, memory_order_relaxed);
+    atomic_store_explicit(&entry->data_blocks, 0, memory_order_relaxed);
+    atomic_store_explicit(&sb->num_devices, e + 1, memory_order_release);
+    memset(&ar->cursors[e], 0, sizeof(ar->cursors[e]));
+    ar->slots[s] = (uint16_t)(e + 1);
+    return (int32_t)e;
+}
+
+int reading_archive_append(ReadingArchive* ar, uint64_t time_ms, const OregonReading* readings, int count) {
+    if (ar->failed || count <= 0) {
+        return ar->failed ? -1 : 0;
+    }
+    int32_t e = device_entry(ar, readings[0].device);
+    if (e < 0) {
+        ar->dropped += (unsigned long)count;
+        return 0;
+    }
+
+    ArchiveCursor* c = &ar->cursors[e];
+    int64_t t = (int64_t)time_ms;
+    if (t < c->last_time) {
+        t = c->last_time;
+        ar->reordered += (unsigned long)count;
+    }
+    for (int i = 0; i < count; i++) {
+        ArchiveDataBlock* d = (ArchiveDataBlock*)BLOCK_AT(ar->map, c->data);
+        if (c->data == 0 || atomic_load_explicit(&d->header.count, memory_order_relaxed) == ARCHIVE_BLOCK_RECORDS) {
+            if (start_data_block(ar, (uint32_t)e, t) != 0) {
+                ar->failed = true;
+                return -1;
+            }
+            d = (ArchiveDataBlock*)BLOCK_AT(ar->map, c->data);
+        }
+        uint32_t n = atomic_load_explicit(&d->header.count, memory_order_relaxed);
+        const OregonReading* r = &readings[i];
+        d->records[n] = (ArchiveRecord){t, r->value, r->type, r->unit, r->state, r->forecast};
+        atomic_store_explicit(&d->header.count, n + 1, memory_order_release);
+    }
+    c->last_time = t;
+    ar->appended += (unsigned long)count;
+
+    if (ar->sync_interval_ms > 0) {
+        if (ar->last_sync < 0) {
+            ar->last_sync = t;
+        } else if (t - ar->last_sync >= (int64_t)ar->sync_interval_ms) {
+            ar->last_sync = t;
+            if (reading_archive_sync(ar) != 0) {
+                ar->failed = true;
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int reading_archive_sync(ReadingArchive* ar) {
+    if (!ar->map) {
+        return 0;
+    }
+    // Blocks before the superblock, so that the directory on disk never
+    // points ahead of the chains it leads to
+    size_t used = (size_t)atomic_load_explicit(&superblock(ar)->num_blocks, memory_order_relaxed) *
+                  ARCHIVE_BLOCK_SIZE;
+    if (used > ARCHIVE_BLOCK_SIZE && msync(ar->map + ARCHIVE_BLOCK_SIZE, used - ARCHIVE_BLOCK_SIZE, MS_SYNC) != 0) {
+        return -1;
+    }
+    return msync(ar->map, ARCHIVE_BLOCK_SIZE, MS_SYNC);
+}
+
+int reading_archive_close(ReadingArchive* ar) {
+    int rc = 0;
+    if (ar->map) {
+        rc = reading_archive_sync(ar);
+        // Give back the space reserved for growth
+        off_t used = (off_t)atomic_load_explicit(&superblock(ar)->num_blocks, memory_order_relaxed) *
+                     ARCHIVE_BLOCK_SIZE;
+        munmap(ar->map, ar->map_size);
+        if (rc == 0 && ftruncate(ar->fd, used) != 0) {
+            rc = -1;
+        }
+    }
+    if (ar->fd >= 0) {
+        close(ar->fd);
+    }
+    ar->map = NULL;
+    ar->fd = -1;
+    return rc;
+}
+
+// ==========================================================================
+// READER
+// ==========================================================================
+
+int reading_archive_map(ReadingArchiveView* view, const char* path) {
+    memset(view, 0, sizeof(*view));
+    view->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (view->fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(view->fd, &st) != 0) {
+        reading_archive_unmap(view);
+        return -1;
+    }
+    if (st.st_size < ARCHIVE_BLOCK_SIZE) {
+        reading_archive_unmap(view);
+        errno = EINVAL;
+        return -1;
+    }
+    // A writer may be growing the file; only whole blocks are mapped
+    view->map_size = (size_t)st.st_size / ARCHIVE_BLOCK_SIZE * ARCHIVE_BLOCK_SIZE;
+    void* map = mmap(NULL, view->map_size, PROT_READ, MAP_SHARED, view->fd, 0);
+    if (map == MAP_FAILED) {
+        view->map_size = 0;
+        reading_archive_unmap(view);
+        return -1;
+    }
+    view->map = map;
+    if (!superblock_valid(view->map, view->map_size)) {
+        reading_archive_unmap(view);
+        errno = EINVAL;
+        return -1;
+    }
+    // Queries jump between a few blocks; read-ahead would only waste I/O
+    madvise(map, view->map_size, MADV_RANDOM);
+
+    ArchiveSuperblock* sb = (ArchiveSuperblock*)map;
+    uint32_t blocks = (uint32_t)(view->map_size / ARCHIVE_BLOCK_SIZE);
+    view->num_blocks = atomic_load_explicit(&sb->num_blocks, memory_order_acquire);
+    view->num_blocks = view->num_blocks < blocks ? view->num_blocks : blocks;
+    view->num_devices = atomic_load_explicit(&sb->num_devices, memory_order_acquire);
+    view->num_devices = view->num_devices < ARCHIVE_MAX_DEVICES ? view->num_devices : ARCHIVE_MAX_DEVICES;
+    return 0;
+}
+
+void reading_archive_unmap(ReadingArchiveView* view) {
+    if (view->map) {
+        munmap((void*)view->map, view->map_size);
+    }
+    if (view->fd >= 0) {
+        close(view->fd);
+    }
+    memset(view, 0, sizeof(*view));
+    view->fd = -1;
+}
+
+static const ArchiveIndexBlock* view_index(const ReadingArchiveView* view, uint32_t b, uint32_t device) {
+    return (const ArchiveIndexBlock*)block_header(view->map, view->num_blocks, b, ARCHIVE_BLOCK_INDEX, device);
+}
+
+static const ArchiveDataBlock* view_data(const ReadingArchiveView* view, uint32_t b, uint32_t device) {
+    return (const ArchiveDataBlock*)block_header(view->map, view->num_blocks, b, ARCHIVE_BLOCK_DATA, device);
+}
+
+// Walks a device's index chain from the newest block back, at most
+// num_blocks steps so that a corrupt chain cannot loop.
+#define FOR_EACH_INDEX(view, dir, x)                                                                     \
+    for (uint32_t x##_b = atomic_load_explicit(&(dir)->last_index, memory_order_acquire),                \
+                  x##_steps = 0;                                                                         \
+         x##_steps < (view)->num_blocks && ((x) = view_index((view), x##_b, (dir)->device)) != NULL;     \
+         x##_b = (x)->header.prev, x##_steps++)
+
+bool reading_archive_device(const ReadingArchiveView* view, uint32_t i, ArchiveDeviceInfo* info) {
+    const ArchiveDirEntry* dir = &((const ArchiveSuperblock*)view->map)->devices[i];
+    memset(info, 0, sizeof(*info));
+    info->device = dir->device;
+
+    bool newest = true;
+    const ArchiveIndexBlock* x;
+    FOR_EACH_INDEX(view, dir, x) {
+        uint32_t entries = block_count(&x->header, ARCHIVE_INDEX_ENTRIES);
+        for (uint32_t j = entries; j-- > 0;) {
+            const ArchiveDataBlock* d = view_data(view, x->entries[j].block, dir->device);
+            uint32_t n = d ? block_count(&d->header, ARCHIVE_BLOCK_RECORDS) : 0;
+            if (n == 0) {
+                continue;
+            }
+            if (newest) {
+                info->last_time = d->records[n - 1].time_ms;
+                newest = false;
+            }
+            info->first_time = d->records[0].time_ms;
+            info->records += n;
+        }
+    }
+    return info->records > 0;
+}
+
+// First index of a sorted run of n times (stride bytes apart) that is >= t.
+static uint32_t lower_bound(const uint8_t* first, size_t stride, uint32_t n, int64_t t) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int64_t v;
+        memcpy(&v, first + (size_t)mid * stride, sizeof(v));
+        if (v < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+typedef struct {
+    archive_query_cb cb;
+    void* ctx;
+    uint32_t device;
+    int64_t time;
+    OregonReading readings[OREGON_MAX_READINGS];
+    int count;
+    unsigned seen_types;        // Bit per OregonReadingType in the group
+    uint64_t visited;
+    bool stopped;
+} QueryGroup;
+
+static void group_flush(QueryGroup* g) {
+    if (g->count > 0 && !g->stopped) {
+        g->stopped = !g->cb(g->ctx, g->device, g->time, g->readings, g->count);
+        g->visited += (uint64_t)g->count;
+    }
+    g->count = 0;
+    g->seen_types = 0;
+}
+
+// Records of one message share a timestamp and never repeat a type; a
+// repeat starts the next message even within the same millisecond.
+static void group_add(QueryGroup* g, const ArchiveRecord* rec) {
+    unsigned bit = 1u << (rec->type & 31);
+    if (g->count > 0 && (rec->time_ms != g->time || (g->seen_types & bit) || g->count == OREGON_MAX_READINGS)) {
+        group_flush(g);
+    }
+    g->time = rec->time_ms;
+    g->seen_types |= bit;
+    g->readings[g->count++] = (OregonReading){g->device, rec->value, rec->type, rec->unit, rec->state,
+                                              rec->forecast};
+}
+
+uint64_t reading_archive_query(const ReadingArchiveView* view, uint32_t device, int64_t t0, int64_t t1,
+                               int type, archive_query_cb cb, void* ctx) {
+    const ArchiveSuperblock* sb = (const ArchiveSuperblock*)view->map;
+    const ArchiveDirEntry* dir = NULL;
+    for (uint32_t i = 0; i < view->num_devices && !dir; i++) {
+        if (sb->devices[i].device == device) {
+            dir = &sb->devices[i];
+        }
+    }
+    if (!dir || t0 > t1) {
+        return 0;
+    }
+
+    // Index blocks that may overlap the range, newest first. The walk stops
+    // at the first block that starts before t0: readings at exactly t0 may
+    // continue from the block before one that starts at t0.
+    uint32_t* chain = NULL;
+    size_t chain_len = 0, chain_cap = 0;
+    const ArchiveIndexBlock* x;
+    FOR_EACH_INDEX(view, dir, x) {
+        if (block_count(&x->header, ARCHIVE_INDEX_ENTRIES) == 0) {
+            continue;
+        }
+        int64_t first = x->entries[0].first_time;
+        if (first <= t1) {
+            if (chain_len == chain_cap) {
+                size_t cap = chain_cap ? chain_cap * 2 : 16;
+                uint32_t* grown = realloc(chain, cap * sizeof(*chain));
+                if (!grown) {
+                    break;
+                }
+                chain = grown;
+                chain_cap = cap;
+            }
+            chain[chain_len++] = x_b;
+        }
+        if (first < t0) {
+            break;
+        }
+    }
+
+    QueryGroup g = {.cb = cb, .ctx = ctx, .device = device};
+    bool first_block = true;
+    bool done = false;
+    for (size_t k = chain_len; k-- > 0 && !done && !g.stopped;) {
+        x = (const ArchiveIndexBlock*)BLOCK_AT(view->map, chain[k]);
+        uint32_t entries = block_count(&x->header, ARCHIVE_INDEX_ENTRIES);
+        // Start at the last data block that begins before t0, as a message
+        // split across blocks leaves readings at t0 in that block too
+        uint32_t j = lower_bound((const uint8_t*)&x->entries[0].first_time, sizeof(ArchiveIndexEntry),
+                                 entries, t0);
+        j = j > 0 ? j - 1 : 0;
+        for (; j < entries && !done && !g.stopped; j++) {
+            if (x->entries[j].first_time > t1) {
+                done = true;
+                break;
+            }
+            const ArchiveDataBlock* d = view_data(view, x->entries[j].block, device);
+            if (!d) {
+                continue;
+            }
+            uint32_t n = block_count(&d->header, ARCHIVE_BLOCK_RECORDS);
+            uint32_t r = first_block ? lower_bound((const uint8_t*)&d->records[0].time_ms,
+                                                   sizeof(ArchiveRecord), n, t0) : 0;
+            first_block = false;
+            for (; r < n && !g.stopped; r++) {
+                const ArchiveRecord* rec = &d->records[r];
+                if (rec->time_ms > t1) {
+                    done = true;
+                    break;
+                }
+                if (rec->time_ms >= t0 && (type < 0 || rec->type == type)) {
+                    group_add(&g, rec);
+                }
+            }
+        }
+    }
+    group_flush(&g);
+    free(chain);
+    return g.visited;
+}
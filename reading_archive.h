@@ -0,0 +1,184 @@
+#ifndef READING_ARCHIVE_H
+#define READING_ARCHIVE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "oregon_parser.h"
+
+// Append-only archive of decoded readings, made of fixed-size blocks:
+//   block 0      superblock: format, block count and a device directory
+//   DATA blocks  timestamped records of one device, in time order
+//   INDEX blocks per device: the first time of each of its data blocks;
+//                a device's index blocks are chained from its directory entry
+// A query for one device and time range binary-searches the index and reads
+// only the data blocks that overlap the range. Fields are in host byte
+// order; a file from a host of the other byte order fails to open.
+
+#define ARCHIVE_MAGIC         "OREGARC1"
+// Device keys embed the decoder's sensor positions (OREGON_DEVICE_KEY()):
+// bump the version if SENSOR_LIST in oregon_parser.c is ever reordered.
+#define ARCHIVE_VERSION       1
+#define ARCHIVE_BLOCK_SIZE    4096
+#define ARCHIVE_MAX_DEVICES   254     // Directory entries that fit in block 0
+#define ARCHIVE_BLOCK_RECORDS 255     // Records per data block
+#define ARCHIVE_INDEX_ENTRIES 255     // Entries per index block
+#define ARCHIVE_DEVICE_SLOTS  512     // Writer's device hash table, a power of two
+
+enum {
+    ARCHIVE_BLOCK_FREE,     // Allocated by growing the file, never written
+    ARCHIVE_BLOCK_DATA,
+    ARCHIVE_BLOCK_INDEX,
+};
+
+// One reading. The device is in the block header.
+typedef struct {
+    int64_t time_ms;        // Milliseconds since the epoch
+    int32_t value;          // As OregonReading
+    uint8_t type;
+    uint8_t unit;
+    uint8_t state;
+    uint8_t forecast;
+} ArchiveRecord;
+
+typedef struct {
+    uint32_t device;            // OREGON_DEVICE_KEY()
+    _Atomic uint32_t last_index;    // Newest index block, 0 until the first record
+    _Atomic uint32_t data_blocks;   // Data blocks written for the device
+    uint32_t reserved;
+} ArchiveDirEntry;
+
+typedef struct {
+    char magic[8];              // ARCHIVE_MAGIC
+    uint32_t version;
+    uint32_t block_size;
+    _Atomic uint32_t num_blocks;    // Blocks in use, including this one
+    _Atomic uint32_t num_devices;   // Directory entries in use
+    uint32_t reserved[2];
+    ArchiveDirEntry devices[ARCHIVE_MAX_DEVICES];
+} ArchiveSuperblock;
+
+typedef struct {
+    uint32_t kind;              // ARCHIVE_BLOCK_*
+    uint32_t device;
+    _Atomic uint32_t count;     // Records or index entries in use
+    uint32_t prev;              // Index blocks: the previous one, 0 for the first
+} ArchiveBlockHeader;
+
+typedef struct {
+    uint32_t block;
+    uint32_t reserved;
+    int64_t first_time;         // Time of the block's first record
+} ArchiveIndexEntry;
+
+typedef struct {
+    ArchiveBlockHeader header;
+    ArchiveRecord records[ARCHIVE_BLOCK_RECORDS];
+} ArchiveDataBlock;
+
+typedef struct {
+    ArchiveBlockHeader header;
+    ArchiveIndexEntry entries[ARCHIVE_INDEX_ENTRIES];
+} ArchiveIndexBlock;
+
+_Static_assert(sizeof(ArchiveSuperblock) == ARCHIVE_BLOCK_SIZE, "superblock must fill a block");
+_Static_assert(sizeof(ArchiveDataBlock) == ARCHIVE_BLOCK_SIZE, "data block must fill a block");
+_Static_assert(sizeof(ArchiveIndexBlock) == ARCHIVE_BLOCK_SIZE, "index block must fill a block");
+
+// ==========================================================================
+// WRITER
+// ==========================================================================
+
+// Where the writer appends for one device.
+typedef struct {
+    uint32_t data;              // Current data block
+    uint32_t index;             // Current index block
+    int64_t last_time;
+} ArchiveCursor;
+
+// Appends to an archive through a shared writable mapping. Every append
+// fills in a record first and then publishes it with a release store of the
+// block's count; new blocks are written before the index entry that points
+// at them, and index blocks before the directory entry. A crash of the
+// process at any point therefore leaves a consistent file holding every
+// reading appended before it, and readers may map the file while it grows.
+// The mapping is flushed to disk by reading_archive_sync(), at most every
+// sync interval during appends, and on close; after a power loss the
+// readers' checks skip whatever did not reach the disk.
+// One writer per file (enforced with flock); not thread-safe.
+typedef struct {
+    int fd;
+    uint8_t* map;
+    size_t map_size;            // Bytes mapped, the file size
+    ArchiveCursor cursors[ARCHIVE_MAX_DEVICES];   // By directory entry
+    uint16_t slots[ARCHIVE_DEVICE_SLOTS];         // Entry + 1 by device hash, 0 if empty
+    uint64_t sync_interval_ms;  // 0 syncs only on request and on close
+    int64_t last_sync;
+    unsigned long appended;     // Records written since open
+    unsigned long dropped;      // Readings of devices beyond ARCHIVE_MAX_DEVICES
+    unsigned long reordered;    // Readings timestamped before their device's last one
+    bool failed;                // Growing or syncing the file failed; appends stopped
+} ReadingArchive;
+
+// Opens an archive for appending, creating it if needed, and picks up after
+// the last record of each device. Returns 0 on success, or -1 with errno
+// set; EINVAL if the file is not an archive, EWOULDBLOCK if another process
+// is writing it.
+int reading_archive_open(ReadingArchive* ar, const char* path, uint64_t sync_interval_ms);
+
+// Appends the readings of one message, timestamped time_ms. A device's
+// records must be in time order for the index; an earlier time than its
+// last record is raised to that and counted in `reordered`. Returns 0, or
+// -1 if the file could not be grown (the archive then stops taking records).
+int reading_archive_append(ReadingArchive* ar, uint64_t time_ms, const OregonReading* readings, int count);
+
+// Flushes every appended record to disk. Returns 0 or -1 with errno set.
+int reading_archive_sync(ReadingArchive* ar);
+
+// Syncs, unmaps and closes. Returns the result of the final sync.
+int reading_archive_close(ReadingArchive* ar);
+
+// ==========================================================================
+// READER
+// ==========================================================================
+
+// Read-only mapping of an archive. It covers the file as it was when
+// mapped; records a writer appends later are not seen.
+typedef struct {
+    int fd;
+    const uint8_t* map;
+    size_t map_size;
+    uint32_t num_blocks;        // Blocks that are both in use and mapped
+    uint32_t num_devices;
+} ReadingArchiveView;
+
+// Summary of one device's records.
+typedef struct {
+    uint32_t device;
+    uint64_t records;
+    int64_t first_time;
+    int64_t last_time;
+} ArchiveDeviceInfo;
+
+// Maps an archive for queries. Returns 0, or -1 with errno set (EINVAL if
+// the file is not an archive).
+int reading_archive_map(ReadingArchiveView* view, const char* path);
+void reading_archive_unmap(ReadingArchiveView* view);
+
+// Fills info for directory entry i < view->num_devices. Returns false if
+// the entry holds no records yet.
+bool reading_archive_device(const ReadingArchiveView* view, uint32_t i, ArchiveDeviceInfo* info);
+
+// Called with each group of consecutive records that share a timestamp (the
+// readings of one message, as far as they match). Return false to stop.
+typedef bool (*archive_query_cb)(void* ctx, uint32_t device, int64_t time_ms, const OregonReading* readings,
+                                 int count);
+
+// Visits a device's records with t0 <= time <= t1, in time order, limited to
+// one reading type unless type is negative. Only the data blocks that
+// overlap the range are touched. Returns the number of readings visited.
+uint64_t reading_archive_query(const ReadingArchiveView* view, uint32_t device, int64_t t0, int64_t t1,
+                               int type, archive_query_cb cb, void* ctx);
+
+#endif // READING_ARCHIVE_H
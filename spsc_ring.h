@@ -0,0 +1,146 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPSC_CACHE_LINE 64
+
+// Bounded lock-free queue of fixed-size slots between exactly one producer
+// thread and one consumer thread.
+// Each side works on slots in place and publishes a whole batch with one
+// release store, so the shared indices are touched once per batch rather
+// than once per message. Each side keeps a cached copy of the other's index
+// and only re-reads the shared one when the cache says full/empty, and the
+// producer once per publish for its occupancy statistics. Fields
+// written by different threads live on separate cache lines.
+typedef struct {
+    // Shared: written by the consumer, read by the producer
+    _Alignas(SPSC_CACHE_LINE) _Atomic size_t head;
+    // Shared: written by the producer, read by the consumer
+    _Alignas(SPSC_CACHE_LINE) _Atomic size_t tail;
+    _Atomic bool closed;
+
+    // Producer only
+    _Alignas(SPSC_CACHE_LINE) size_t prod_tail;     // Next slot to fill, not yet published
+    size_t prod_head_cache;
+    unsigned long pushed;
+    unsigned long dropped;       // Counted by the producer via spsc_ring_drop()
+    size_t max_occupancy;        // Slots in flight just after a publish
+    uint64_t occupancy_sum;      // Over every publish, for the mean
+    unsigned long publishes;
+
+    // Consumer only
+    _Alignas(SPSC_CACHE_LINE) size_t cons_head;     // Next slot to read, not yet released
+    size_t cons_tail_cache;
+
+    // Read-only after init
+    _Alignas(SPSC_CACHE_LINE) unsigned char* slots;
+    size_t mask;
+    size_t slot_size;
+} SpscRing;
+
+// Capacity is rounded up to a power of two. Returns 0 on success, -1 if
+// allocation fails.
+static inline int spsc_ring_init(SpscRing* r, size_t capacity, size_t slot_size) {
+    memset(r, 0, sizeof(*r));
+    size_t cap = 2;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+    slot_size = (slot_size + 15) & ~(size_t)15;
+    r->slots = aligned_alloc(SPSC_CACHE_LINE, (cap * slot_size + SPSC_CACHE_LINE - 1) & ~(size_t)(SPSC_CACHE_LINE - 1));
+    if (!r->slots) {
+        return -1;
+    }
+    r->mask = cap - 1;
+    r->slot_size = slot_size;
+    return 0;
+}
+
+static inline void spsc_ring_free(SpscRing* r) {
+    free(r->slots);
+    r->slots = NULL;
+}
+
+static inline size_t spsc_ring_capacity(const SpscRing* r) {
+    return r->mask + 1;
+}
+
+// ---- Producer ----
+
+// Next free slot to fill, or NULL if the ring is full.
+static inline void* spsc_ring_slot(SpscRing* r) {
+    if (r->prod_tail - r->prod_head_cache > r->mask) {
+        r->prod_head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (r->prod_tail - r->prod_head_cache > r->mask) {
+            return NULL;
+        }
+    }
+    return r->slots + (r->prod_tail & r->mask) * r->slot_size;
+}
+
+// Marks the slot from spsc_ring_slot() as filled; visible after publish.
+static inline void spsc_ring_produce(SpscRing* r) {
+    r->prod_tail++;
+    r->pushed++;
+}
+
+static inline void spsc_ring_drop(SpscRing* r) {
+    r->dropped++;
+}
+
+// Hands every produced slot to the consumer at once. The occupancy is
+// measured against a fresh read of the consumer's index, which also
+// refreshes the cached copy; the cache alone can lag by a whole ring and
+// would overstate it.
+static inline void spsc_ring_publish(SpscRing* r) {
+    if (r->prod_tail == atomic_load_explicit(&r->tail, memory_order_relaxed)) {
+        return;
+    }
+    atomic_store_explicit(&r->tail, r->prod_tail, memory_order_release);
+    r->prod_head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+    size_t occupancy = r->prod_tail - r->prod_head_cache;
+    if (occupancy > r->max_occupancy) {
+        r->max_occupancy = occupancy;
+    }
+    r->occupancy_sum += occupancy;
+    r->publishes++;
+}
+
+// Publishes and tells the consumer no more slots will follow.
+static inline void spsc_ring_close(SpscRing* r) {
+    spsc_ring_publish(r);
+    atomic_store_explicit(&r->closed, true, memory_order_release);
+}
+
+// ---- Consumer ----
+
+// Number of published slots ready to read, starting at spsc_ring_at(r, 0).
+static inline size_t spsc_ring_available(SpscRing* r) {
+    if (r->cons_tail_cache == r->cons_head) {
+        r->cons_tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+    }
+    return r->cons_tail_cache - r->cons_head;
+}
+
+static inline void* spsc_ring_at(SpscRing* r, size_t i) {
+    return r->slots + ((r->cons_head + i) & r->mask) * r->slot_size;
+}
+
+// Returns n read slots to the producer with one store.
+static inline void spsc_ring_release(SpscRing* r, size_t n) {
+    r->cons_head += n;
+    atomic_store_explicit(&r->head, r->cons_head, memory_order_release);
+}
+
+// True once the producer closed the ring and every slot has been read.
+static inline bool spsc_ring_finished(SpscRing* r) {
+    return atomic_load_explicit(&r->closed, memory_order_acquire) && spsc_ring_available(r) == 0;
+}
+
+#endif // SPSC_RING_H
@@ -1,9 +1,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
+#include "aggregate_report.h"
+#include "batch_decode.h"
+#include "cul_mux.h"
 #include "cul_preprocessor.h"
+#include "cul_stream.h"
+#include "decode_cache.h"
+#include "emission_filter.h"
+#include "hex_pack.h"
+#include "oregon_arena.h"
+#include "oregon_checksum.h"
 #include "oregon_parser.h"
+#include "oregon_stats.h"
+#include "output_sink.h"
+#include "reading_archive.h"
+#include "spsc_ring.h"
 
 // Define the filename for test data and maximum line length
 #define TEST_DATA_FILE "test_data.txt"
@@ -38,20 +60,21 @@ void run_tests() {
 
         // --- Stage 1: Pre-processing ---
         printf("--- Stage 1: Pre-processing CUL Message ---\n");
-        char* oregon_hex_string = preprocess_cul_message(line);
+        OregonFrame frame;
+        OregonStatus status = cul_preprocess_frame(line, &frame);
 
-        if (!oregon_hex_string) {
+        if (status != OREGON_OK) {
+            print_preprocess_error(status);
             printf("Result: PREPROCESS FAILED. Not a recognized Oregon V2/V3 protocol.\n");
         } else {
+            char oregon_hex_string[CUL_HEX_OUTPUT_SIZE];
+            cul_frame_to_hex(&frame, oregon_hex_string, sizeof(oregon_hex_string));
             printf("Preprocessor Output: %s\n", oregon_hex_string);
             printf("Result: PREPROCESS SUCCEEDED.\n\n");
             
             // --- Stage 2: Parsing ---
             printf("--- Stage 2: Parsing Oregon Data ---\n");
-            parse_oregon_message(oregon_hex_string);
-            
-            // Free the memory allocated by the pre-processor
-            free(oregon_hex_string);
+            parse_oregon_frame(&frame);
         }
         
         printf("================== END TEST CASE %d ==================\n\n", test_num);
@@ -62,7 +85,1197 @@ void run_tests() {
     printf("Test suite finished.\n");
 }
 
+// ==========================================================================
+// UNIT CHECKS
+// ==========================================================================
+
+static int checks_run;
+static int checks_failed;
+
+// Counts a check and reports it if it failed, without stopping the suite.
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+static void check(int ok, const char* what, const char* file, int line) {
+    checks_run++;
+    if (!ok) {
+        checks_failed++;
+        printf("CHECK FAILED: %s (%s:%d)\n", what, file, line);
+    }
+}
+
+#define HEX_CHECK_MAX 100
+
+/**
+ * @brief The SIMD kernel hex_pack() dispatches to agrees with the scalar one
+ * on every length, with and without a bad character at every position.
+ */
+static void check_hex_pack(void) {
+#ifdef __x86_64__
+    CHECK(strcmp(hex_pack_impl(), "scalar") != 0);
+#endif
+    static const char DIGITS[] = "0123456789abcdefABCDEF";
+    static const char BAD[] = "gG/:@`\x80 ";
+    char hex[HEX_CHECK_MAX];
+    uint8_t simd[HEX_CHECK_MAX / 2], scalar[HEX_CHECK_MAX / 2];
+    unsigned seed = 1;
+    int mismatches = 0;
+    for (size_t len = 0; len < HEX_CHECK_MAX; len++) {
+        for (size_t bad = 0; bad <= len; bad++) {
+            for (size_t i = 0; i < len; i++) {
+                seed = seed * 1103515245u + 12345u;
+                hex[i] = DIGITS[(seed >> 16) % (sizeof(DIGITS) - 1)];
+            }
+            if (bad < len) {
+                hex[bad] = BAD[bad % (sizeof(BAD) - 1)];
+            }
+            size_t n = hex_pack(hex, len, simd);
+            mismatches += n != hex_pack_scalar(hex, len, scalar) ||
+                          (n == len && memcmp(simd, scalar, (len + 1) / 2) != 0);
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+// The per-sensor checksum functions the descriptors replaced, as in the
+// FHEM module: a byte-wise nibble sum minus 0xa against the check byte.
+static unsigned reference_nibble_sum(const uint8_t* b, int bytes, bool half) {
+    unsigned sum = 0;
+    for (int i = 0; i < bytes; i++) {
+        sum += (b[i] >> 4) + (b[i] & 0x0F);
+    }
+    return half ? sum + (b[bytes] >> 4) : sum;
+}
+
+static bool reference_checksum(int which, const uint8_t* b) {
+    switch (which) {
+        case 1: return (uint8_t)(reference_nibble_sum(b, 6, true) - 0xa) == ((b[6] >> 4) | (b[7] & 0x0F) << 4);
+        case 2: return (uint8_t)(reference_nibble_sum(b, 8, false) - 0xa) == b[8];
+        case 3: return (uint8_t)(reference_nibble_sum(b, 11, false) - 0xa) == b[11];
+        case 4: return (uint8_t)(reference_nibble_sum(b, 9, false) - 0xa) == b[9];
+        case 5: return (uint8_t)(reference_nibble_sum(b, 10, false) - 0xa) == b[10];
+        case 6: return (uint8_t)(reference_nibble_sum(b, 8, false) - 0xa) == ((b[8] >> 4) | (b[9] & 0x0F) << 4);
+        case 7: return (uint8_t)(reference_nibble_sum(b, 7, false) - 0xa) == b[7];
+    }
+    return false;
+}
+
+#define CHECKSUM_PAYLOADS 200
+
+/**
+ * @brief oregon_checksum_verify() agrees with the per-sensor functions it
+ * replaced on random payloads, for every value of the check nibbles,
+ * including CHECKSUM1 whose sum covers one of its own split check nibbles.
+ */
+static void check_checksums(void) {
+    const OregonChecksum* descs[] = {
+        NULL, &OREGON_CHECKSUM1, &OREGON_CHECKSUM2, &OREGON_CHECKSUM3, &OREGON_CHECKSUM4,
+        &OREGON_CHECKSUM5, &OREGON_CHECKSUM6, &OREGON_CHECKSUM7,
+    };
+    unsigned seed = 7;
+    for (int which = 1; which <= 7; which++) {
+        const OregonChecksum* cs = descs[which];
+        int mismatches = 0, passed = 0;
+        for (int n = 0; n < CHECKSUM_PAYLOADS; n++) {
+            uint8_t payload[OREGON_CHECKSUM_MAX_NIBBLES / 2];
+            for (size_t i = 0; i < sizeof(payload); i++) {
+                seed = seed * 1103515245u + 12345u;
+                payload[i] = (uint8_t)(seed >> 16);
+            }
+            for (unsigned v = 0; v < 256; v++) {
+                int lo = cs->check_lo, hi = cs->check_hi;
+                payload[lo / 2] = (uint8_t)((lo & 1) ? (payload[lo / 2] & 0xF0) | (v & 0x0F)
+                                                     : (payload[lo / 2] & 0x0F) | (v & 0x0F) << 4);
+                payload[hi / 2] = (uint8_t)((hi & 1) ? (payload[hi / 2] & 0xF0) | (v >> 4)
+                                                     : (payload[hi / 2] & 0x0F) | (v >> 4) << 4);
+                bool ok = oregon_checksum_verify(cs, payload);
+                mismatches += ok != reference_checksum(which, payload);
+                passed += ok;
+            }
+        }
+        CHECK(mismatches == 0);
+        CHECK(passed > 0);
+    }
+}
+
+// A frame in cul_frame_to_hex() form and the readings it must decode to.
+// Built by hand from the FHEM field definitions each layout cites, with the
+// checksum computed as by reference_checksum(); the device key's sensor is
+// the entry's position in SENSOR_LIST.
+typedef struct {
+    const char* hex;
+    uint8_t rolling_code;
+    uint8_t channel;
+    int count;
+    OregonReading readings[OREGON_MAX_READINGS];
+} KnownFrame;
+
+#define KNOWN(type, value, unit, state, forecast) \
+    {0, (value), OREGON_READING_##type, OREGON_UNIT_##unit, OREGON_STATE_##state, OREGON_FORECAST_##forecast}
+
+static const KnownFrame KNOWN_FRAMES[] = {
+    {"50FA2810A3301258444200", 0xa3, 1, 3, {       // THGR810: -12.3 C, 45 %
+        KNOWN(TEMPERATURE, -1230, CELSIUS, NONE, NONE), KNOWN(HUMIDITY, 4500, PERCENT, COMFORTABLE, NONE),
+        KNOWN(BATTERY, 0, NONE, BATTERY_OK, NONE)}},
+    {"50FAB82011742180834700", 0x11, 2, 3, {       // WTGR800_T: 21.7 C, 38 %, low battery
+        KNOWN(TEMPERATURE, 2170, CELSIUS, NONE, NONE), KNOWN(HUMIDITY, 3800, PERCENT, DRY, NONE),
+        KNOWN(BATTERY, 0, NONE, BATTERY_LOW, NONE)}},
+    {"581A99105C62002451084100", 0x5c, 1, 4, {     // WTGR800_A: gust 12.4, average 8.5 m/s, SE
+        KNOWN(WIND_SPEED, 1240, MPS, NONE, NONE), KNOWN(WIND_AVERAGE, 850, MPS, NONE, NONE),
+        KNOWN(WIND_DIRECTION, 13500, DEGREES, NONE, NONE), KNOWN(BATTERY_LEVEL, 8000, PERCENT, NONE, NONE)}},
+    {"581A890007F0003070013300", 0x07, 0, 4, {     // WGR800: gust 3.0, average 1.7 m/s, NNW
+        KNOWN(WIND_SPEED, 300, MPS, NONE, NONE), KNOWN(WIND_AVERAGE, 170, MPS, NONE, NONE),
+        KNOWN(WIND_DIRECTION, 33750, DEGREES, NONE, NONE), KNOWN(BATTERY_LEVEL, 10000, PERCENT, NONE, NONE)}},
+    {"50EA4C3442000500030000", 0x42, 3, 2, {       // THWR288A: 5.0 C
+        KNOWN(TEMPERATURE, 500, CELSIUS, NONE, NONE), KNOWN(BATTERY, 0, NONE, BATTERY_OK, NONE)}},
+    {"40EA4C16E154030804", 0xe1, 1, 2, {           // THN132N: -3.5 C, low battery
+        KNOWN(TEMPERATURE, -350, CELSIUS, NONE, NONE), KNOWN(BATTERY, 0, NONE, BATTERY_LOW, NONE)}},
+    {"501A2D2033901900063100", 0x33, 2, 3, {       // THGR228N: 19.9 C, 60 %
+        KNOWN(TEMPERATURE, 1990, CELSIUS, NONE, NONE), KNOWN(HUMIDITY, 6000, PERCENT, NORMAL, NONE),
+        KNOWN(BATTERY, 0, NONE, BATTERY_OK, NONE)}},
+    {"501A3D1090400820C73C00", 0x90, 1, 3, {       // THGR918: 8.4 C, 72 %
+        KNOWN(TEMPERATURE, 840, CELSIUS, NONE, NONE), KNOWN(HUMIDITY, 7200, PERCENT, WET, NONE),
+        KNOWN(BATTERY, 0, NONE, BATTERY_OK, NONE)}},
+    {"585A6D0021502210459DC050", 0x21, 0, 3, {     // BTHR918N: 22.5 C, 51 %, 1013 hPa
+        KNOWN(TEMPERATURE, 2250, CELSIUS, NONE, NONE), KNOWN(HUMIDITY, 5100, PERCENT, COMFORTABLE, NONE),
+        KNOWN(PRESSURE, 101300, HPA, NONE, SUNNY)}},
+    {"50CA2C406B540008895100", 0x6b, 4, 3, {       // THGR328N: -0.5 C, 90 %, low battery
+        KNOWN(TEMPERATURE, -50, CELSIUS, NONE, NONE), KNOWN(HUMIDITY, 9000, PERCENT, DRY, NONE),
+        KNOWN(BATTERY, 0, NONE, BATTERY_LOW, NONE)}},
+    {"585A5D000200150004806031", 0x02, 0, 3, {     // BTHR918: 15.0 C, 40 %, 984 hPa
+        KNOWN(TEMPERATURE, 1500, CELSIUS, NONE, NONE), KNOWN(HUMIDITY, 4000, PERCENT, NORMAL, NONE),
+        KNOWN(PRESSURE, 98400, HPA, NONE, PARTLY)}},
+    {"500A4D20D4103000002800", 0xd4, 2, 2, {       // THR128: 30.1 C
+        KNOWN(TEMPERATURE, 3010, CELSIUS, NONE, NONE), KNOWN(BATTERY, 0, NONE, BATTERY_OK, NONE)}},
+    {"503A0D0088742475200443", 0x88, 0, 4, {       // WGR918: gust 7.5, average 4.2 m/s, 247 degrees
+        KNOWN(WIND_SPEED, 750, MPS, NONE, NONE), KNOWN(WIND_AVERAGE, 420, MPS, NONE, NONE),
+        KNOWN(WIND_DIRECTION, 24700, DEGREES, NONE, NONE), KNOWN(BATTERY, 0, NONE, BATTERY_LOW, NONE)}},
+    {"542A1D005520016045C302", 0x55, 0, 3, {       // RGR918: 12 mm/h, 3456 mm
+        KNOWN(RAIN_RATE, 1200, MM_PER_HOUR, NONE, NONE), KNOWN(RAIN_TOTAL, 345600, MM, NONE, NONE),
+        KNOWN(BATTERY, 0, NONE, BATTERY_OK, NONE)}},
+    {"48DA78003C7400003600", 0x3c, 0, 2, {         // UVN800: UV index 7, low battery
+        KNOWN(UV, 700, UV_INDEX, RISK_HIGH, NONE), KNOWN(BATTERY, 0, NONE, BATTERY_LOW, NONE)}},
+};
+
+#define NUM_KNOWN_FRAMES (sizeof(KNOWN_FRAMES) / sizeof(KNOWN_FRAMES[0]))
+
+/**
+ * @brief One hand-built frame per SENSOR_LIST entry decodes to the values,
+ * units, states and forecasts its field definitions give.
+ */
+static void check_known_frames(void) {
+    CHECK(oregon_sensor_name(NUM_KNOWN_FRAMES) == NULL);    // One per sensor
+    for (unsigned sensor = 0; sensor < NUM_KNOWN_FRAMES; sensor++) {
+        const KnownFrame* k = &KNOWN_FRAMES[sensor];
+        uint32_t device = OREGON_DEVICE_KEY(sensor, k->rolling_code, k->channel);
+        OregonReading readings[OREGON_MAX_READINGS];
+        int count;
+        OregonMessageInfo info;
+        OregonStatus status = oregon_decode(k->hex, &info, readings, OREGON_MAX_READINGS, &count);
+        int wrong = status != OREGON_OK || count != k->count || !info.checksum_checked ||
+                    strcmp(info.sensor, oregon_sensor_name(sensor)) != 0;
+        for (int i = 0; !wrong && i < count; i++) {
+            OregonReading expected = k->readings[i];
+            expected.device = device;
+            wrong = memcmp(&readings[i], &expected, sizeof(expected)) != 0;
+        }
+        if (wrong) {
+            printf("Known frame of %s decoded wrongly\n", oregon_sensor_name(sensor));
+        }
+        CHECK(!wrong);
+    }
+}
+
+// Decodes a frame through both oregon_decode_frame() and
+// oregon_decode_frame_generic(). Returns true if they agree on the status,
+// the message info and the readings.
+static bool decoders_agree(const OregonFrame* frame) {
+    OregonReading specialised[OREGON_MAX_READINGS], generic[OREGON_MAX_READINGS];
+    OregonMessageInfo specialised_info, generic_info;
+    int specialised_count, generic_count;
+    OregonStatus s = oregon_decode_frame(frame, &specialised_info, specialised, OREGON_MAX_READINGS,
+                                         &specialised_count);
+    OregonStatus g = oregon_decode_frame_generic(frame, &generic_info, generic, OREGON_MAX_READINGS,
+                                                 &generic_count);
+    return s == g && specialised_count == generic_count &&
+           specialised_info.type_id == generic_info.type_id && specialised_info.sensor == generic_info.sensor &&
+           specialised_info.checksum_checked == generic_info.checksum_checked &&
+           memcmp(specialised, generic, generic_count * sizeof(OregonReading)) == 0;
+}
+
+/**
+ * @brief The decoder generated for each SENSOR_LIST entry matches the
+ * table-driven one on that sensor's known frame, on every copy of it with
+ * one nibble after the type id changed, and with a bit length no sensor
+ * uses.
+ */
+static void check_specialised_decoders(void) {
+    int disagreements = 0;
+    for (unsigned sensor = 0; sensor < NUM_KNOWN_FRAMES; sensor++) {
+        const char* hex = KNOWN_FRAMES[sensor].hex;
+        uint8_t bytes[1 + OREGON_FRAME_MAX_BYTES];
+        size_t len = strlen(hex);
+        CHECK(hex_pack(hex, len, bytes) == len);
+        OregonFrame frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.bits = bytes[0];
+        memcpy(frame.data, bytes + 1, len / 2 - 1);
+
+        disagreements += !decoders_agree(&frame);
+        for (unsigned nibble = 4; nibble < frame.bits / 4; nibble++) {
+            OregonFrame changed = frame;
+            changed.data[nibble / 2] ^= (nibble & 1) ? 0x05 : 0x50;
+            disagreements += !decoders_agree(&changed);
+        }
+        frame.bits -= 4;
+        disagreements += !decoders_agree(&frame);
+    }
+    CHECK(disagreements == 0);
+}
+
+/**
+ * @brief Every sensor's frames survive encoding to a CUL line and decoding
+ * again, over both protocol versions: the decoded readings re-encode to
+ * the same payload.
+ */
+static void check_encode_round_trip(void) {
+    // One reading of every type; each sensor encodes the ones it has
+    OregonReading readings[OREGON_READING_TYPE_COUNT];
+    for (int t = 0; t < OREGON_READING_TYPE_COUNT; t++) {
+        readings[t] = (OregonReading){.value = 1230 + 100 * t, .type = (uint8_t)t, .state = OREGON_STATE_BATTERY_OK};
+    }
+    readings[OREGON_READING_TEMPERATURE].value = -1230;
+
+    int failed = 0, lines = 0;
+    for (unsigned sensor = 0; oregon_sensor_name(sensor); sensor++) {
+        uint32_t device = OREGON_DEVICE_KEY(sensor, 0xa3, 2);
+        OregonFrame frame;
+        CHECK(oregon_encode_frame(device, readings, OREGON_READING_TYPE_COUNT, &frame) == OREGON_OK);
+        for (uint8_t version = 2; version <= 3; version++) {
+            frame.version = version;
+            frame.rssi = 0x4a;
+            char line[CUL_HEX_OUTPUT_SIZE + 2];
+            if (cul_encode_frame(&frame, line, sizeof(line)) != OREGON_OK) {
+                continue;   // A V3 payload that contains the V2 preamble
+            }
+            lines++;
+
+            OregonReading decoded[OREGON_MAX_READINGS];
+            int count;
+            OregonFrame again;
+            OregonStatus status = oregon_decode_cul(line, NULL, decoded, OREGON_MAX_READINGS, &count);
+            failed += status != OREGON_OK || count == 0 || decoded[0].device != device ||
+                      oregon_encode_frame(device, decoded, count, &again) != OREGON_OK ||
+                      memcmp(again.data, frame.data, frame.bits / 8) != 0;
+        }
+    }
+    CHECK(lines > 0 && failed == 0);
+}
+
+// Decodes a line through the cache and checks the answer matches a direct
+// decode. Returns the status.
+static OregonStatus cached_decode(DecodeCache* cache, const char* line, uint64_t now_ms) {
+    OregonReading cached[OREGON_MAX_READINGS], direct[OREGON_MAX_READINGS];
+    int cached_count, direct_count;
+    OregonStatus status = decode_cache_decode_cul(cache, line, now_ms, NULL, cached, OREGON_MAX_READINGS,
+                                                  &cached_count);
+    OregonStatus expected = oregon_decode_cul(line, NULL, direct, OREGON_MAX_READINGS, &direct_count);
+    CHECK(status == expected && cached_count == direct_count &&
+          memcmp(cached, direct, direct_count * sizeof(OregonReading)) == 0);
+    return status;
+}
+
+/**
+ * @brief Successes are shared across RSSIs, failures are not, entries
+ * expire after the TTL and the oldest entry of a full set is evicted.
+ * Hits are counted in the decoder statistics with their cached outcome,
+ * and decode_cache_clear() empties the cache.
+ */
+static void check_decode_cache(void) {
+    // Lines are these plus two RSSI hex chars
+    const char* good = "omACCB532CD55352D2D55334D4D554B53534ACD54AB0";
+    const char* bad = "omAAAAAAAB32D4CB3554D4B4B554CD353555554";
+    char line[64];
+#ifndef OREGON_NO_STATS
+    OregonStatsSnapshot before, after;
+    oregon_stats_snapshot(&before);
+#endif
+
+    DecodeCache cache;
+    CHECK(decode_cache_init(&cache, DECODE_CACHE_WAYS, 100) == 0);   // A single set
+    snprintf(line, sizeof(line), "%s36", good);
+    CHECK(cached_decode(&cache, line, 0) == OREGON_OK);
+    snprintf(line, sizeof(line), "%sFF", good);
+    cached_decode(&cache, line, 10);                // Hit: another RSSI
+    snprintf(line, sizeof(line), "%s38", bad);
+    CHECK(cached_decode(&cache, line, 20) != OREGON_OK);
+    cached_decode(&cache, line, 30);                // Hit: the same line
+    snprintf(line, sizeof(line), "%s00", bad);
+    cached_decode(&cache, line, 40);                // Miss: a failure with another RSSI
+    CHECK(cache.stats.hits == 2 && cache.stats.misses == 3);
+#ifndef OREGON_NO_STATS
+    oregon_stats_snapshot(&after);
+    const OregonStageStats* hit = &after.stages[OREGON_STAGE_CACHE_HIT];
+    const OregonStageStats* hit0 = &before.stages[OREGON_STAGE_CACHE_HIT];
+    CHECK(hit->calls == hit0->calls + 2);
+    CHECK(hit->by_status[OREGON_OK] == hit0->by_status[OREGON_OK] + 1);
+#endif
+
+    snprintf(line, sizeof(line), "%s36", good);
+    cached_decode(&cache, line, 200);               // Expired, refreshed in place
+    CHECK(cache.stats.expired == 1 && cache.stats.misses == 4 && cache.stats.evictions == 0);
+    snprintf(line, sizeof(line), "%s01", bad);
+    cached_decode(&cache, line, 210);               // Fills the set
+    snprintf(line, sizeof(line), "%s02", bad);
+    cached_decode(&cache, line, 220);               // Evicts the "38" failure, the oldest
+    CHECK(cache.stats.evictions == 1);
+    snprintf(line, sizeof(line), "%s38", bad);
+    cached_decode(&cache, line, 230);
+    CHECK(cache.stats.misses == 7 && cache.stats.evictions == 2);
+    decode_cache_clear(&cache);
+    cached_decode(&cache, line, 240);               // Miss: the cache was emptied
+    CHECK(cache.stats.misses == 8 && cache.stats.hits == 2);
+    decode_cache_free(&cache);
+}
+
+// Collects the lines a CulLineReader hands out, one per row.
+typedef struct {
+    char text[2 * CUL_LINE_MAX];
+    size_t len;
+} LineLog;
+
+static void log_line(void* ctx, const char* line, size_t len) {
+    LineLog* log = ctx;
+    if (log->len + len + 1 < sizeof(log->text) && strlen(line) == len) {
+        memcpy(log->text + log->len, line, len);
+        log->text[log->len + len] = '|';
+        log->len += len + 1;
+        log->text[log->len] = '\0';
+    }
+}
+
+/**
+ * @brief Lines written to a pipe and read back in chunks of every size from
+ * 1 to 16 bytes come out whole: CRs stripped, empty lines skipped, lines
+ * longer than CUL_LINE_MAX dropped whole and a trailing unterminated line
+ * handed out by cul_line_reader_finish().
+ */
+static void check_line_reader(void) {
+    static char input[4 * CUL_LINE_MAX];
+    size_t n = 0;
+    n += sprintf(input + n, "omAAAA\r\n\n\r\nomBB");
+    n += sprintf(input + n, "BB\r\n");
+    memset(input + n, 'x', CUL_LINE_MAX + 1);               // Dropped
+    n += CUL_LINE_MAX + 1;
+    n += sprintf(input + n, "\r\n");
+    memset(input + n, 'y', CUL_LINE_MAX);                   // Kept: exactly the limit
+    n += CUL_LINE_MAX;
+    n += sprintf(input + n, "\nomCC\rCC\nomDD");
+
+    static char expected[2 * CUL_LINE_MAX];
+    char longest[CUL_LINE_MAX + 1];
+    memset(longest, 'y', CUL_LINE_MAX);
+    longest[CUL_LINE_MAX] = '\0';
+    snprintf(expected, sizeof(expected), "omAAAA|omBBBB|%s|omCC\rCC|omDD|", longest);
+
+    int failed = 0;
+    for (size_t chunk = 1; chunk <= 16; chunk++) {
+        int fds[2];
+        CHECK(pipe(fds) == 0);
+        CHECK(write(fds[1], input, n) == (ssize_t)n);       // Fits in the pipe buffer
+        close(fds[1]);
+
+        CulLineReader reader;
+        cul_line_reader_init(&reader);
+        static LineLog log;
+        log.len = 0;
+        log.text[0] = '\0';
+        char buf[16];
+        ssize_t got;
+        while ((got = read(fds[0], buf, chunk)) > 0) {
+            cul_line_reader_feed(&reader, buf, (size_t)got, log_line, &log);
+        }
+        cul_line_reader_finish(&reader, log_line, &log);
+        close(fds[0]);
+        failed += strcmp(log.text, expected) != 0 || reader.lines != 5 || reader.overlong != 1;
+    }
+    CHECK(failed == 0);
+}
+
+// Runs ./oregon_parser with the given arguments, its stdin read from
+// in_path, its stdout going to out_path and its stderr discarded.
+// Returns the child's pid, or -1.
+static pid_t spawn_parser(char* const argv[], const char* in_path, const char* out_path) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int in = open(in_path, O_RDONLY);
+        int out = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        int null = open("/dev/null", O_WRONLY);
+        if (in < 0 || out < 0 || null < 0 || dup2(in, STDIN_FILENO) < 0 || dup2(out, STDOUT_FILENO) < 0 ||
+            dup2(null, STDERR_FILENO) < 0) {
+            _exit(127);
+        }
+        execv("./oregon_parser", argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+static bool same_file(const char* a, const char* b) {
+    FILE* fa = fopen(a, "r");
+    FILE* fb = fopen(b, "r");
+    bool same = fa && fb;
+    while (same) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        same = ca == cb;
+        if (ca == EOF) {
+            break;
+        }
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return same;
+}
+
+// Opens a FIFO for writing once the reader pid is opening it, giving up
+// after about five seconds or if the reader exits. Returns the blocking
+// descriptor, or -1.
+static int open_fifo_writer(const char* path, pid_t reader) {
+    for (int tries = 0; tries < 500; tries++) {
+        int fd = open(path, O_WRONLY | O_NONBLOCK);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+            return fd;
+        }
+        if (errno != ENXIO || waitpid(reader, NULL, WNOHANG) != 0) {
+            return -1;
+        }
+        nanosleep(&(struct timespec){0, 10000000}, NULL);
+    }
+    return -1;
+}
+
+/**
+ * @brief --stream reading test_data.txt from a FIFO on stdin, written in
+ * chunks that split lines anywhere, prints exactly what it prints reading
+ * the file directly. (A FIFO named as a source is reopened at end of file,
+ * so only stdin lets the stream end.)
+ */
+static void check_stream_fifo(void) {
+    if (access("./oregon_parser", X_OK) != 0) {
+        printf("Skipping the --stream FIFO check: ./oregon_parser is not built\n");
+        return;
+    }
+    char fifo[64], direct[64], piped[64];
+    snprintf(fifo, sizeof(fifo), "/tmp/oregon_test_%d.fifo", (int)getpid());
+    snprintf(direct, sizeof(direct), "/tmp/oregon_test_%d_direct.txt", (int)getpid());
+    snprintf(piped, sizeof(piped), "/tmp/oregon_test_%d_fifo.txt", (int)getpid());
+    unlink(fifo);
+    CHECK(mkfifo(fifo, 0600) == 0);
+
+    int status = -1;
+    pid_t pid = spawn_parser((char* []){"oregon_parser", "--stream", TEST_DATA_FILE, NULL}, "/dev/null",
+                             direct);
+    CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    FILE* data = fopen(TEST_DATA_FILE, "r");
+    pid = spawn_parser((char* []){"oregon_parser", "--stream", NULL}, fifo, piped);
+    int fd = pid > 0 && data ? open_fifo_writer(fifo, pid) : -1;
+    CHECK(fd >= 0);
+    if (fd >= 0) {
+        // Chunks of 1 to 97 bytes, so lines and CR/LF pairs straddle writes
+        char buf[97];
+        size_t chunk = 1, got;
+        signal(SIGPIPE, SIG_IGN);
+        while ((got = fread(buf, 1, chunk, data)) > 0 && write(fd, buf, got) == (ssize_t)got) {
+            chunk = chunk % sizeof(buf) + 1;
+        }
+        close(fd);
+    } else if (pid > 0) {
+        kill(pid, SIGTERM);
+    }
+    if (data) {
+        fclose(data);
+    }
+    status = -1;
+    CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK(same_file(direct, piped));
+    unlink(fifo);
+    unlink(direct);
+    unlink(piped);
+}
+
+// Appends a CUL line whose sensor, rolling code and temperature follow seq,
+// so that neighbouring lines decode to different output. Returns its length.
+static size_t append_capture_line(char* buf, unsigned seq, const char* eol) {
+    static unsigned num_sensors;
+    while (oregon_sensor_name(num_sensors)) {
+        num_sensors++;
+    }
+    OregonReading r[2] = {
+        {.value = (int32_t)(seq % 1999) * 10 - 9990, .type = OREGON_READING_TEMPERATURE},
+        {.value = 5000, .type = OREGON_READING_HUMIDITY},
+    };
+    OregonFrame frame;
+    oregon_encode_frame(OREGON_DEVICE_KEY(seq % num_sensors, seq & 0xff, 1), r, 2, &frame);
+    if (cul_encode_frame(&frame, buf, CUL_HEX_OUTPUT_SIZE + 2) != OREGON_OK) {
+        frame.version = 3;
+        cul_encode_frame(&frame, buf, CUL_HEX_OUTPUT_SIZE + 2);
+    }
+    size_t len = strlen(buf);
+    strcpy(buf + len, eol);
+    return len + strlen(eol);
+}
+
+// Appends decodable lines, then one undecodable filler line, so that the
+// capture ends exactly at `offset`.
+static size_t fill_capture(char* buf, size_t n, size_t offset, unsigned* seq) {
+    while (n + 2 * CUL_HEX_OUTPUT_SIZE < offset) {
+        n += append_capture_line(buf + n, *seq, *seq % 3 ? "\n" : "\r\n");
+        (*seq)++;
+    }
+    memset(buf + n, '#', offset - n - 1);
+    buf[offset - 1] = '\n';
+    return offset;
+}
+
+#define BATCH_CAPTURE_CHUNKS 4
+
+// True if p is aligned to OREGON_ARENA_ALIGN and holds `size` copies of c.
+static bool arena_holds(const unsigned char* p, unsigned char c, size_t size) {
+    if (!p || (uintptr_t)p % OREGON_ARENA_ALIGN != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (p[i] != c) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief oregon_arena_grow() extends the latest allocation in place while its
+ * block has room and moves it, contents intact, otherwise; after a reset the
+ * same allocations reuse the kept blocks without calling malloc.
+ */
+static void check_arena(void) {
+    OregonArena arena;
+    CHECK(oregon_arena_init(&arena, 256) == 0);
+    unsigned char* first[2];
+    unsigned long blocks[2];
+
+    for (int pass = 0; pass < 2; pass++) {
+        // The latest allocation grows in place up to the end of its block
+        unsigned char* a = oregon_arena_alloc(&arena, 40);
+        CHECK(a == arena.first->data);
+        memset(a, 'a', 40);
+        CHECK(oregon_arena_grow(&arena, a, 40, 100) == a);
+        memset(a + 40, 'a', 60);
+        CHECK(oregon_arena_grow(&arena, a, 100, 256) == a && arena.used == 256);
+
+        // Past it, the allocation moves to a new block that fits it
+        unsigned char* moved = oregon_arena_grow(&arena, a, 100, 300);
+        CHECK(moved != a && arena_holds(moved, 'a', 100));
+        CHECK(arena.current != arena.first && arena.current->size >= 300);
+
+        // An allocation that is no longer the latest always moves
+        unsigned char* b = oregon_arena_alloc(&arena, 16);
+        unsigned char* c = oregon_arena_alloc(&arena, 16);
+        memset(b, 'b', 16);
+        memset(c, 'c', 16);
+        unsigned char* b2 = oregon_arena_grow(&arena, b, 16, 32);
+        CHECK(b2 != b && b2 != c && arena_holds(b2, 'b', 16) && arena_holds(c, 'c', 16));
+        CHECK(arena_holds(moved, 'a', 100));
+
+        // Shrinking the latest allocation gives the space back
+        CHECK(oregon_arena_grow(&arena, b2, 32, 8) == b2);
+        CHECK(oregon_arena_alloc(&arena, 16) == b2 + OREGON_ARENA_ALIGN);
+
+        first[pass] = moved;
+        blocks[pass] = arena.blocks;
+        oregon_arena_reset(&arena);
+        CHECK(arena.current == arena.first && arena.used == 0);
+    }
+    // The second pass took the same blocks in the same order
+    CHECK(first[1] == first[0] && blocks[0] == 3 && blocks[1] == 3);
+    oregon_arena_free(&arena);
+}
+
+/**
+ * @brief The device registry doubles its slot table exactly when a new device
+ * would take the load past one half, and ids, counts and interned names
+ * survive every growth of the slots and entries.
+ */
+static void check_device_registry(void) {
+    DeviceRegistry reg;
+    CHECK(device_registry_init(&reg, 8) == 0);
+    CHECK(reg.num_slots == 16 && reg.cap_devices == 8);
+
+    uint32_t devices[600];
+    int bad_growth = 0, bad_ids = 0;
+    for (uint32_t i = 0; i < 600; i++) {
+        devices[i] = OREGON_DEVICE_KEY(i % 15, i / 15, 1);
+        uint32_t slots = reg.num_slots;
+        bool grows = (reg.num_devices + 1) * 2 > slots;
+        bad_ids += device_registry_observe(&reg, devices[i], 1000 + i) != (int32_t)i;
+        bad_growth += reg.num_slots != (grows ? slots * 2 : slots) || reg.num_devices * 2 > reg.num_slots;
+        // A known device keeps its id and does not count towards the load
+        bad_ids += device_registry_observe(&reg, devices[i / 2], 5000) != (int32_t)(i / 2);
+    }
+    CHECK(bad_growth == 0 && bad_ids == 0);
+    CHECK(reg.num_devices == 600 && reg.num_slots == 2048 && reg.cap_devices >= 600);
+
+    int bad_entries = 0;
+    for (uint32_t i = 0; i < 600; i++) {
+        char name[DEVICE_NAME_MAX];
+        oregon_device_name(devices[i], name, sizeof(name));
+        const DeviceEntry* e = device_registry_get(&reg, device_registry_find(&reg, devices[i]));
+        unsigned long messages = i < 300 ? 3 : 1;
+        bad_entries += e->device != devices[i] || strcmp(e->name, name) != 0 || e->first_seen != 1000 + i ||
+                       e->messages != messages;
+    }
+    CHECK(bad_entries == 0);
+    CHECK(device_registry_find(&reg, OREGON_DEVICE_KEY(0, 0xff, 15)) == -1);
+    device_registry_free(&reg);
+}
+
+/**
+ * @brief --batch output is the readings in input order, byte for byte the
+ * same whatever the number of jobs, across chunk boundaries that a line
+ * straddles, that split a CR/LF pair, or that a line starts exactly on.
+ */
+static void check_batch_order(void) {
+    char* capture = malloc(BATCH_CAPTURE_CHUNKS * BATCH_CHUNK_SIZE);
+    char path[64], out_path[64];
+    snprintf(path, sizeof(path), "/tmp/oregon_test_%d.cul", (int)getpid());
+    snprintf(out_path, sizeof(out_path), "/tmp/oregon_test_%d_batch.json", (int)getpid());
+    CHECK(capture != NULL);
+    if (!capture) {
+        return;
+    }
+
+    unsigned seq = 0;
+    size_t n = fill_capture(capture, 0, BATCH_CHUNK_SIZE - 10, &seq);
+    n += append_capture_line(capture + n, seq++, "\n");         // Straddles the first boundary
+    char split[CUL_HEX_OUTPUT_SIZE + 2];
+    size_t split_len = append_capture_line(split, seq++, "\r\n");
+    n = fill_capture(capture, n, 2 * BATCH_CHUNK_SIZE + 1 - split_len, &seq);
+    memcpy(capture + n, split, split_len);                     // \r ends the second chunk
+    n += split_len;
+    CHECK(capture[2 * BATCH_CHUNK_SIZE - 1] == '\r' && capture[2 * BATCH_CHUNK_SIZE] == '\n');
+    n = fill_capture(capture, n, 3 * BATCH_CHUNK_SIZE, &seq);
+    n += append_capture_line(capture + n, seq++, "\n");         // Starts the fourth chunk
+    n = fill_capture(capture, n, 3 * BATCH_CHUNK_SIZE + BATCH_CHUNK_SIZE / 2, &seq);
+    n += append_capture_line(capture + n, seq++, "");            // No final newline
+    FILE* f = fopen(path, "w");
+    CHECK(f && fwrite(capture, 1, n, f) == n);
+    if (f) {
+        fclose(f);
+    }
+
+    // The expected output: every line decoded in order on this thread
+    OutputSink expected;
+    CHECK(output_sink_init(&expected, OUTPUT_JSON, -1, 1 << 20) == 0);
+    size_t decoded = 0;
+    for (size_t p = 0; p < n;) {
+        char* nl = memchr(capture + p, '\n', n - p);
+        size_t end = nl ? (size_t)(nl - capture) : n;
+        size_t line_len = end - p - (end > p && capture[end - 1] == '\r');
+        char line[CUL_LINE_MAX + 1];
+        memcpy(line, capture + p, line_len);
+        line[line_len] = '\0';
+        OregonReading readings[OREGON_MAX_READINGS];
+        int count;
+        if (oregon_decode_cul(line, NULL, readings, OREGON_MAX_READINGS, &count) == OREGON_OK) {
+            char name[DEVICE_NAME_MAX];
+            oregon_device_name(readings[0].device, name, sizeof(name));
+            output_sink_readings(&expected, name, 0, readings, count);
+            decoded++;
+        }
+        p = end + 1;
+    }
+    CHECK(decoded == seq);
+
+    static const int JOBS[] = {1, 2, 3, 4};
+    for (size_t j = 0; j < sizeof(JOBS) / sizeof(JOBS[0]); j++) {
+        int fd = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        BatchStats stats;
+        CHECK(fd >= 0 && batch_decode_file(path, JOBS[j], OUTPUT_JSON, fd, &stats) == 0);
+        CHECK(stats.by_status[OREGON_OK] == seq && stats.overlong == 0);
+
+        char* got = malloc(expected.len + 1);
+        ssize_t got_len = got && fd >= 0 ? pread(fd, got, expected.len + 1, 0) : -1;
+        CHECK(got_len == (ssize_t)expected.len && memcmp(got, expected.buf, expected.len) == 0);
+        free(got);
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    output_sink_free(&expected);
+    free(capture);
+    unlink(path);
+    unlink(out_path);
+}
+
+#define RING_ITEMS 200000
+
+/**
+ * @brief A ring of four slots goes round many times in one thread: it
+ * reports full at exactly its capacity, keeps order across the wrap and
+ * measures occupancy against what the consumer actually released.
+ */
+static void check_ring_wraparound(void) {
+    SpscRing r;
+    CHECK(spsc_ring_init(&r, 3, sizeof(uint64_t)) == 0);
+    CHECK(spsc_ring_capacity(&r) == 4);
+    uint64_t next_in = 0, next_out = 0;
+    int bad_order = 0, bad_full = 0;
+    for (int round = 0; round < 1000; round++) {
+        // Produce up to the capacity, in batches of one to three
+        size_t batch = 1 + round % 3;
+        uint64_t* slot;
+        while ((slot = spsc_ring_slot(&r))) {
+            *slot = next_in++;
+            spsc_ring_produce(&r);
+            if ((next_in - next_out) % batch == 0) {
+                spsc_ring_publish(&r);
+            }
+        }
+        spsc_ring_publish(&r);
+        bad_full += next_in - next_out != 4;
+
+        // Consume all but round % 4 of them
+        for (size_t left = 4 - round % 4; left > 0;) {
+            size_t n = spsc_ring_available(&r);
+            size_t take = n < left ? n : left;
+            for (size_t i = 0; i < take; i++) {
+                bad_order += *(uint64_t*)spsc_ring_at(&r, i) != next_out++;
+            }
+            spsc_ring_release(&r, take);
+            left -= take;
+        }
+    }
+    CHECK(bad_order == 0 && bad_full == 0);
+    CHECK(r.max_occupancy == 4);
+    spsc_ring_free(&r);
+
+    // After a drain, a publish must not count the released slots, even
+    // while the ring never filled up and so never re-read the index
+    CHECK(spsc_ring_init(&r, 4, sizeof(uint64_t)) == 0);
+    for (int i = 0; i < 2; i++) {
+        spsc_ring_slot(&r);
+        spsc_ring_produce(&r);
+    }
+    spsc_ring_publish(&r);
+    spsc_ring_release(&r, spsc_ring_available(&r));
+    r.max_occupancy = 0;
+    spsc_ring_slot(&r);
+    spsc_ring_produce(&r);
+    spsc_ring_publish(&r);
+    CHECK(r.max_occupancy == 1);
+    spsc_ring_free(&r);
+}
+
+static void* ring_consume(void* arg) {
+    SpscRing* r = arg;
+    uint64_t expected = 0;
+    bool ok = true;
+    while (!spsc_ring_finished(r)) {
+        size_t n = spsc_ring_available(r);
+        for (size_t i = 0; i < n; i++) {
+            ok &= *(uint64_t*)spsc_ring_at(r, i) == expected++;
+        }
+        spsc_ring_release(r, n);
+        if (n == 0) {
+            sched_yield();
+        }
+    }
+    return (void*)(uintptr_t)(ok && expected == RING_ITEMS);
+}
+
+/**
+ * @brief A producer and a consumer thread pass a sequence through a small
+ * ring without losing or reordering anything.
+ */
+static void check_ring_threads(void) {
+    SpscRing r;
+    CHECK(spsc_ring_init(&r, 16, sizeof(uint64_t)) == 0);
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, ring_consume, &r);
+    for (uint64_t i = 0; i < RING_ITEMS; i++) {
+        uint64_t* slot;
+        while (!(slot = spsc_ring_slot(&r))) {
+            spsc_ring_publish(&r);
+            sched_yield();
+        }
+        *slot = i;
+        spsc_ring_produce(&r);
+        if (i % 5 == 0) {
+            spsc_ring_publish(&r);
+        }
+    }
+    spsc_ring_close(&r);
+    void* ok;
+    pthread_join(consumer, &ok);
+    CHECK(ok != NULL);
+    CHECK(r.max_occupancy <= spsc_ring_capacity(&r));
+    spsc_ring_free(&r);
+}
+
+// Lines a mux passed on, joined with spaces.
+typedef struct {
+    char text[256];
+} MuxOutput;
+
+static void collect_line(void* ctx, const char* line, size_t len) {
+    MuxOutput* out = ctx;
+    size_t used = strlen(out->text);
+    snprintf(out->text + used, sizeof(out->text) - used, "%s%.*s", used ? " " : "", (int)len, line);
+}
+
+// Writes text to a fresh file under /tmp and stores its name in path.
+static void write_source(char* path, size_t size, const char* name, const char* text) {
+    snprintf(path, size, "/tmp/oregon_test_%d_%s", (int)getpid(), name);
+    FILE* f = fopen(path, "w");
+    if (f) {
+        fputs(text, f);
+        fclose(f);
+    }
+}
+
+// Runs two sources through a mux and returns what it passed on.
+static void run_mux(const char* const* paths, uint64_t window_ms, CulMux* mux, MuxOutput* out) {
+    memset(out, 0, sizeof(*out));
+    if (cul_mux_open(mux, paths, 2, 0, window_ms, collect_line, out) != 0) {
+        return;
+    }
+    while (cul_mux_poll(mux) > 0) {
+    }
+    cul_mux_close(mux);
+}
+
+/**
+ * @brief Two sticks hearing the same frame within the window yield its
+ * best-RSSI copy once; repeats from one stick and lines outside the
+ * window all pass.
+ */
+static void check_mux_dedupe(void) {
+    char a[64], b[64];
+    write_source(a, sizeof(a), "a", "omAAAA10\nomBBBB20\n");
+    write_source(b, sizeof(b), "b", "omAAAA30\nomBBBB05\nomBBBB40\n");
+    const char* const paths[] = {a, b};
+    CulMux mux;
+    MuxOutput out;
+
+    run_mux(paths, 1000, &mux, &out);
+    CHECK(strcmp(out.text, "omAAAA30 omBBBB20 omBBBB40") == 0);
+    CHECK(mux.sources[0].stats.kept == 1 && mux.sources[0].stats.duplicates == 1);
+    CHECK(mux.sources[1].stats.kept == 2 && mux.sources[1].stats.duplicates == 1);
+
+    // Without a window every line is passed on as it arrives
+    run_mux(paths, 0, &mux, &out);
+    CHECK(strcmp(out.text, "omAAAA10 omBBBB20 omAAAA30 omBBBB05 omBBBB40") == 0);
+    unlink(a);
+    unlink(b);
+}
+
+/**
+ * @brief A reading passes when it first appears, when it moves by at least
+ * its deadband from the last one passed, when its state changes and once
+ * the heartbeat interval is up; otherwise it is suppressed.
+ */
+static void check_emission_filter(void) {
+    EmissionFilter filter;
+    CHECK(emission_filter_init(&filter, 4, 1000) == 0);
+    CHECK(emission_filter_parse_deadbands("temperature=0.5,humidity=2", filter.deadband));
+    CHECK(filter.deadband[OREGON_READING_TEMPERATURE] == 50 && filter.deadband[OREGON_READING_HUMIDITY] == 200);
+    CHECK(!emission_filter_parse_deadbands("temperature=-1", filter.deadband));
+    CHECK(!emission_filter_parse_deadbands("nonsense=1", filter.deadband));
+    CHECK(filter.deadband[OREGON_READING_TEMPERATURE] == 50);
+
+    // Temperature of device 1 over time: {time, value, expected to pass}
+    static const struct {
+        uint64_t time;
+        int32_t value;
+        bool pass;
+    } STEPS[] = {
+        {0, 2000, true},        // First reading
+        {100, 2049, false},     // Within the deadband
+        {200, 2050, true},      // Exactly the deadband away
+        {300, 2010, false},     // 0.40 from the last one passed, not from the last one seen
+        {400, 2000, true},      // 0.50 from 20.50
+        {1300, 2000, false},    // Unchanged, heartbeat not yet due
+        {1400, 2000, true},     // Heartbeat: 1000 ms since the last one passed
+    };
+    int wrong = 0;
+    OregonReading out[1];
+    for (size_t i = 0; i < sizeof(STEPS) / sizeof(STEPS[0]); i++) {
+        OregonReading r = {0, STEPS[i].value, OREGON_READING_TEMPERATURE, OREGON_UNIT_CELSIUS, 0, 0};
+        wrong += emission_filter_apply(&filter, 1, STEPS[i].time, &r, 1, out) != (STEPS[i].pass ? 1 : 0);
+    }
+    CHECK(wrong == 0);
+    CHECK(filter.heartbeats == 1 && filter.suppressed == 3);
+
+    // A state change passes whatever the deadband; other devices and types
+    // are tracked on their own; ids past the table always pass
+    OregonReading battery = {0, 0, OREGON_READING_BATTERY, OREGON_UNIT_NONE, OREGON_STATE_BATTERY_OK, 0};
+    CHECK(emission_filter_apply(&filter, 1, 1500, &battery, 1, out) == 1);
+    CHECK(emission_filter_apply(&filter, 1, 1600, &battery, 1, out) == 0);
+    battery.state = OREGON_STATE_BATTERY_LOW;
+    CHECK(emission_filter_apply(&filter, 1, 1700, &battery, 1, out) == 1);
+    OregonReading temp = {0, 2000, OREGON_READING_TEMPERATURE, OREGON_UNIT_CELSIUS, 0, 0};
+    CHECK(emission_filter_apply(&filter, 2, 1700, &temp, 1, out) == 1);
+    CHECK(emission_filter_apply(&filter, 4, 1700, &temp, 1, out) == 1);
+    CHECK(emission_filter_apply(&filter, 4, 1800, &temp, 1, out) == 1 && filter.untracked == 2);
+    emission_filter_free(&filter);
+}
+
+// Formats the readings as one message in the given format and compares the
+// result with the expected text.
+static bool formats_as(OutputFormat format, uint64_t timestamp_ms, const OregonReading* readings, int count,
+                       const char* expected) {
+    OutputSink sink;
+    if (output_sink_init(&sink, format, -1, 16) != 0) {
+        return false;
+    }
+    output_sink_readings(&sink, "BTHR918N_5a_2", timestamp_ms, readings, count);
+    bool same = !sink.failed && sink.len == strlen(expected) && memcmp(sink.buf, expected, sink.len) == 0;
+    if (!same) {
+        printf("Got %s output: %.*s", output_format_str(format), (int)sink.len, sink.buf);
+    }
+    output_sink_free(&sink);
+    return same;
+}
+
+/**
+ * @brief Every output format writes a message exactly as documented: negative
+ * values, state-only readings with empty CSV value and unit columns, and
+ * InfluxDB timestamps in nanoseconds.
+ */
+static void check_output_formats(void) {
+    static const OregonReading READINGS[] = {
+        {0, -507, OREGON_READING_TEMPERATURE, OREGON_UNIT_CELSIUS, OREGON_STATE_NONE, OREGON_FORECAST_NONE},
+        {0, 4500, OREGON_READING_HUMIDITY, OREGON_UNIT_PERCENT, OREGON_STATE_COMFORTABLE, OREGON_FORECAST_NONE},
+        {0, 0, OREGON_READING_BATTERY, OREGON_UNIT_NONE, OREGON_STATE_BATTERY_OK, OREGON_FORECAST_NONE},
+        {0, 101300, OREGON_READING_PRESSURE, OREGON_UNIT_HPA, OREGON_STATE_NONE, OREGON_FORECAST_SUNNY},
+        {0, -5, OREGON_READING_TEMPERATURE, OREGON_UNIT_CELSIUS, OREGON_STATE_NONE, OREGON_FORECAST_NONE},
+    };
+    const int count = (int)(sizeof(READINGS) / sizeof(READINGS[0]));
+    const uint64_t time_ms = 1700000000123ull;
+
+    CHECK(formats_as(OUTPUT_TEXT, time_ms, READINGS, count,
+                     "--- Decoded Sensor: BTHR918N_5a_2 ---\n"
+                     "  - Type: temperature\n"
+                     "    Value: -5.07 C\n"
+                     "  - Type: humidity\n"
+                     "    Value: 45.00 %\n"
+                     "    State: comfortable\n"
+                     "  - Type: battery_status\n"
+                     "    State: ok\n"
+                     "  - Type: pressure\n"
+                     "    Value: 1013.00 hPa\n"
+                     "    Forecast: sunny\n"
+                     "  - Type: temperature\n"
+                     "    Value: -0.05 C\n"
+                     "---------------------------------------\n"));
+    CHECK(formats_as(OUTPUT_JSON, time_ms, READINGS, count,
+                     "{\"time\":1700000000123,\"device\":\"BTHR918N_5a_2\",\"readings\":["
+                     "{\"type\":\"temperature\",\"value\":-5.07,\"unit\":\"C\"},"
+                     "{\"type\":\"humidity\",\"value\":45.00,\"unit\":\"%\",\"state\":\"comfortable\"},"
+                     "{\"type\":\"battery_status\",\"state\":\"ok\"},"
+                     "{\"type\":\"pressure\",\"value\":1013.00,\"unit\":\"hPa\",\"forecast\":\"sunny\"},"
+                     "{\"type\":\"temperature\",\"value\":-0.05,\"unit\":\"C\"}]}\n"));
+    CHECK(formats_as(OUTPUT_JSON, 0, READINGS, 1,
+                     "{\"device\":\"BTHR918N_5a_2\",\"readings\":["
+                     "{\"type\":\"temperature\",\"value\":-5.07,\"unit\":\"C\"}]}\n"));
+    CHECK(formats_as(OUTPUT_CSV, time_ms, READINGS, count,
+                     "1700000000123,BTHR918N_5a_2,temperature,-5.07,C,,\n"
+                     "1700000000123,BTHR918N_5a_2,humidity,45.00,%,comfortable,\n"
+                     "1700000000123,BTHR918N_5a_2,battery_status,,,ok,\n"
+                     "1700000000123,BTHR918N_5a_2,pressure,1013.00,hPa,,sunny\n"
+                     "1700000000123,BTHR918N_5a_2,temperature,-0.05,C,,\n"));
+    CHECK(formats_as(OUTPUT_CSV, 0, READINGS + 2, 1, ",BTHR918N_5a_2,battery_status,,,ok,\n"));
+    CHECK(formats_as(OUTPUT_INFLUX, time_ms, READINGS, count - 1,
+                     "oregon,device=BTHR918N_5a_2 temperature=-5.07,humidity=45.00,"
+                     "humidity_state=\"comfortable\",battery_status_state=\"ok\",pressure=1013.00,"
+                     "pressure_forecast=\"sunny\" 1700000000123000000\n"));
+    CHECK(formats_as(OUTPUT_INFLUX, 0, READINGS + 2, 1, "oregon,device=BTHR918N_5a_2 battery_status_state=\"ok\"\n"));
+
+    // The CSV header comes once, before any record
+    OutputSink sink;
+    CHECK(output_sink_init(&sink, OUTPUT_CSV, -1, 16) == 0);
+    output_sink_header(&sink);
+    CHECK(sink.len == strlen("time,device,type,value,unit,state,forecast\n") &&
+          memcmp(sink.buf, "time,device,type,value,unit,state,forecast\n", sink.len) == 0);
+    output_sink_free(&sink);
+}
+
+/**
+ * @brief Aggregate records reach the output once per window, or per device
+ * at the first message of each interval, with the rest flushed at the end.
+ */
+static void check_aggregate_report(void) {
+    AggregateStore store;
+    AggregateReport report;
+    OutputSink out;
+    CHECK(aggregate_store_init(&store, 2, 0.5, 4, 8) == 0);
+    CHECK(output_sink_init(&out, OUTPUT_JSON, -1, 256) == 0);
+
+    // Once per window: records after the second and fourth value only
+    CHECK(aggregate_report_init(&report, &store, &out, 0) == 0);
+    unsigned long after[4];
+    for (int i = 0; i < 4; i++) {
+        OregonReading r = {0, 2000 + 100 * i, OREGON_READING_TEMPERATURE, OREGON_UNIT_CELSIUS, 0, 0};
+        aggregate_report_add(&report, 1, "THN132N_c8_1", 1000 + i, &r, 1);
+        after[i] = report.records;
+    }
+    CHECK(after[0] == 0 && after[1] == 1 && after[2] == 1 && after[3] == 2);
+    out.buf[out.len] = '\0';
+    CHECK(strstr(out.buf, "\"time\":1003,\"device\":\"THN132N_c8_1\",\"aggregates\":[{\"type\":"
+                          "\"temperature\",\"unit\":\"C\",\"count\":2,\"mean\":22.50,\"min\":22.00,"
+                          "\"max\":23.00,\"ewma\":22.13}]}") != NULL);
+    aggregate_report_flush(&report, -1);
+    CHECK(report.records == 2);
+    aggregate_report_free(&report);
+
+    // Every 1000 ms of message time: the first message starts the interval
+    out.len = 0;
+    CHECK(aggregate_report_init(&report, &store, &out, 1000) == 0);
+    static const uint64_t TIMES[] = {1500, 1900, 2000, 2500};
+    for (size_t i = 0; i < sizeof(TIMES) / sizeof(TIMES[0]); i++) {
+        OregonReading r = {0, 2000, OREGON_READING_TEMPERATURE, OREGON_UNIT_CELSIUS, 0, 0};
+        aggregate_report_add(&report, 2, "THN132N_c8_2", TIMES[i], &r, 1);
+    }
+    CHECK(report.records == 1);
+    aggregate_report_flush(&report, 3);
+    CHECK(report.records == 1);
+    aggregate_report_flush(&report, -1);
+    out.buf[out.len] = '\0';
+    CHECK(report.records == 2 && strstr(out.buf, "\"time\":2000,") && strstr(out.buf, "\"time\":2500,"));
+
+    aggregate_report_free(&report);
+    output_sink_free(&out);
+    aggregate_store_free(&store);
+}
+
+#define STATS_THREADS 4
+#define STATS_CALLS   1000
+
+static void* preprocess_some(void* arg) {
+    OregonFrame frame;
+    for (int i = 0; i < STATS_CALLS; i++) {
+        cul_preprocess_frame((const char*)arg, &frame);
+    }
+    return NULL;
+}
+
+/**
+ * @brief The counts of threads that exited stay in the statistics.
+ */
+static void check_stats_retired_threads(void) {
+#ifndef OREGON_NO_STATS
+    OregonStatsSnapshot before, after;
+    oregon_stats_snapshot(&before);
+    pthread_t threads[STATS_THREADS];
+    for (int t = 0; t < STATS_THREADS; t++) {
+        pthread_create(&threads[t], NULL, preprocess_some, "om0000");
+    }
+    for (int t = 0; t < STATS_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    oregon_stats_snapshot(&after);
+    CHECK(after.threads == before.threads + STATS_THREADS);
+    CHECK(after.stages[OREGON_STAGE_PREPROCESS].calls ==
+          before.stages[OREGON_STAGE_PREPROCESS].calls + STATS_THREADS * STATS_CALLS);
+#endif
+}
+
+static bool count_readings(void* ctx, uint32_t device, int64_t time_ms, const OregonReading* readings,
+                           int count) {
+    (void)device;
+    (void)time_ms;
+    (void)readings;
+    *(int*)ctx += count;
+    return true;
+}
+
+static int archive_count(const ReadingArchiveView* view, uint32_t device, int64_t t0, int64_t t1) {
+    int n = 0;
+    reading_archive_query(view, device, t0, t1, -1, count_readings, &n);
+    return n;
+}
+
+/**
+ * @brief Queries starting exactly at a message whose readings are split across
+ * a data block, and across an index block, still return all of them.
+ */
+static void check_archive_boundaries(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/oregon_test_%d.arc", (int)getpid());
+    unlink(path);
+
+    // Two readings per message: with an odd number of records per block,
+    // every other data block ends half way through a message, and so does
+    // the last data block of the first index block.
+    const uint32_t device = OREGON_DEVICE_KEY(1, 0xa3, 1);
+    const int messages = ARCHIVE_BLOCK_RECORDS * ARCHIVE_INDEX_ENTRIES / 2 + 100;
+    ReadingArchive ar;
+    CHECK(reading_archive_open(&ar, path, 0) == 0);
+    for (int i = 0; i < messages; i++) {
+        OregonReading r[2] = {
+            {device, i, OREGON_READING_TEMPERATURE, OREGON_UNIT_CELSIUS, 0, 0},
+            {device, 50, OREGON_READING_HUMIDITY, OREGON_UNIT_PERCENT, 0, 0},
+        };
+        reading_archive_append(&ar, 1000 + (uint64_t)i * 10, r, 2);
+    }
+    CHECK(reading_archive_close(&ar) == 0);
+
+    ReadingArchiveView view;
+    CHECK(reading_archive_map(&view, path) == 0);
+    int missed = 0;
+    for (int i = 0; i < messages; i++) {
+        int64_t t = 1000 + (int64_t)i * 10;
+        missed += archive_count(&view, device, t, t) != 2;
+        missed += archive_count(&view, device, t, t + 10) != (i + 1 < messages ? 4 : 2);
+    }
+    CHECK(missed == 0);
+    // The split message at the end of the first index block
+    int64_t split = 1000 + (int64_t)(ARCHIVE_BLOCK_RECORDS * ARCHIVE_INDEX_ENTRIES / 2) * 10;
+    CHECK(archive_count(&view, device, split, split) == 2);
+    CHECK(archive_count(&view, device, INT64_MIN, INT64_MAX) == messages * 2);
+    reading_archive_unmap(&view);
+    unlink(path);
+}
+
+/**
+ * @brief Runs the checks of individual modules and prints a summary.
+ */
+static void run_unit_checks(void) {
+    printf("\nRunning unit checks...\n");
+    check_hex_pack();
+    check_checksums();
+    check_known_frames();
+    check_specialised_decoders();
+    check_encode_round_trip();
+    check_archive_boundaries();
+    check_decode_cache();
+    check_line_reader();
+    check_stream_fifo();
+    check_arena();
+    check_device_registry();
+    check_batch_order();
+    check_ring_wraparound();
+    check_ring_threads();
+    check_mux_dedupe();
+    check_emission_filter();
+    check_output_formats();
+    check_aggregate_report();
+    check_stats_retired_threads();
+    printf("Unit checks: %d run, %d failed.\n", checks_run, checks_failed);
+}
+
 int main(int argc, char* argv[]) {
     run_tests();
-    return 0;
+    run_unit_checks();
+    return checks_failed ? 1 : 0;
 }